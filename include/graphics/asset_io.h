@@ -0,0 +1,38 @@
+#ifndef GRAPHICS_ASSET_IO_H
+#define GRAPHICS_ASSET_IO_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "graphics/pack.h"
+#include "graphics/thread_pool.h"
+
+namespace graphics {
+
+struct AssetReadStats {
+  std::size_t file_count;
+  std::size_t pack_count;
+  bool io_uring;
+};
+
+typedef std::function<void(std::size_t index, const unsigned char *data,
+                           std::size_t size)>
+    AssetCallback;
+
+// Reads whole files as one batch. Files found in pack are served straight
+// from its mapping, compressed ones decompressed a block per task; the rest
+// go into a single io_uring submission on Linux, or become one read task per
+// file on pool when io_uring is unavailable. on_read runs on a pool worker
+// exactly once per file as soon as that file completes, with data only valid
+// during the call, or nullptr if the file could not be read. Returns once
+// every read has been issued; pool.Wait() joins the callbacks and rethrows
+// their errors.
+AssetReadStats ReadAssets(const std::vector<std::string> &paths,
+                          ThreadPool &pool, AssetCallback on_read,
+                          Pack *pack = nullptr);
+
+};  // namespace graphics
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef GRAPHICS_CULL_H
+#define GRAPHICS_CULL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "graphics/mesh.h"
+
+namespace graphics {
+
+// Boxes are tested kCullWidth at a time: 8 with AVX, 4 with SSE and 4,
+// one by one, elsewhere. Configure with GRAPHICS_AVX to build for AVX.
+#if defined(__AVX__)
+const unsigned kCullWidth{8};
+#else
+const unsigned kCullWidth{4};
+#endif
+
+struct Aabb {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+Aabb MeshBounds(const MeshData &mesh);
+// The box around box transformed by matrix, an affine transform.
+Aabb TransformAabb(const Aabb &box, const glm::mat4 &matrix);
+
+// Planes with normals pointing in: left, right, bottom, top, near, far.
+// A point p is inside when dot(plane, vec4(p, 1)) >= 0 for every plane.
+struct Frustum {
+  glm::vec4 plane[6];
+};
+
+// The frustum of clip space pulled back through view_projection (Gribb
+// and Hartmann), in the space view_projection maps from: world space for
+// projection * view, object space for projection * view * model.
+Frustum ExtractFrustum(const glm::mat4 &view_projection);
+// Conservative: false only if box lies wholly outside one of the planes.
+bool Intersects(const Frustum &frustum, const Aabb &box);
+
+// Boxes as centers and half extents, one array per axis, the layout the
+// wide tests load. The arrays run kCullWidth floats past size_ so a batch
+// never reads out of bounds.
+class BoxSet {
+ public:
+  BoxSet();
+  void Clear();
+  void Add(const Aabb &box);
+  std::size_t size_;
+  std::vector<float> center_[3];
+  std::vector<float> extent_[3];
+};
+
+// Appends the index of each box in set that Intersects frustum to visible.
+void CullBoxes(const Frustum &frustum, const BoxSet &set,
+               std::vector<unsigned> &visible);
+
+const unsigned kBvhLeafSize{8};
+
+// A bounding volume hierarchy over static objects with four children a
+// node, so one SSE test covers a node's children. Subtrees wholly inside
+// the frustum are accepted without testing their objects; leaves of up to
+// kBvhLeafSize objects are tested kCullWidth at a time.
+class Bvh {
+ public:
+  // Builds over object 0 to box.size() - 1, splitting at the median of
+  // the longest axis of the centers.
+  void Build(const std::vector<Aabb> &box);
+  // Appends the index of each object that Intersects frustum to visible,
+  // in no particular order.
+  void Cull(const Frustum &frustum, std::vector<unsigned> &visible) const;
+
+ private:
+  // A node's children as four boxes. child is the node index of an inner
+  // child and -1 for a leaf; either way the child's objects are object_
+  // first to first + count - 1, and none when count is 0.
+  struct Node {
+    float center[3][4];
+    float extent[3][4];
+    std::int32_t child[4];
+    std::uint32_t first[4];
+    std::uint32_t count[4];
+  };
+
+  // an object while building, with its box and doubled center, which
+  // orders the same as the center
+  struct Item {
+    Aabb box;
+    glm::vec3 center;
+    unsigned object;
+  };
+
+  std::int32_t BuildNode(std::uint32_t first, std::uint32_t count,
+                         std::vector<Item> &item);
+
+  std::vector<Node> node_;
+  // object indices in leaf order
+  std::vector<unsigned> object_;
+  // their boxes, in the same order
+  BoxSet leaf_box_;
+};
+
+};  // namespace graphics
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef GRAPHICS_FILE_WATCHER_H
+#define GRAPHICS_FILE_WATCHER_H
+
+#include <string>
+#include <vector>
+
+namespace graphics {
+
+// Tells which of a set of files changed, without blocking. On Linux an
+// inotify watch on each file's directory catches both writes in place and
+// the renames editors save with; elsewhere Poll compares modification
+// times. A symlink is followed to the file it names.
+class FileWatcher {
+ public:
+  FileWatcher();
+  ~FileWatcher();
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  // Returns false, leaving path unwatched, if it cannot be watched.
+  bool Add(const std::string &path);
+  // Appends each path, as given to Add, changed since the last Poll.
+  void Poll(std::vector<std::string> &changed);
+
+ private:
+  struct File {
+    std::string path;
+    std::string directory;
+    std::string name;
+    int watch;
+    long long modified;
+  };
+
+  int fd_;
+  std::vector<File> file_;
+};
+
+};  // namespace graphics
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef GRAPHICS_FREE_LIST_H
+#define GRAPHICS_FREE_LIST_H
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <utility>
+
+namespace graphics {
+
+// Hands out ranges of [0, capacity), best fit, merging freed ranges with
+// free neighbours so the space does not splinter.
+class FreeList {
+ public:
+  explicit FreeList(std::size_t capacity = 0);
+
+  // Forgets every allocation.
+  void Reset(std::size_t capacity);
+  // Returns false, changing nothing, when no free range holds size.
+  bool Allocate(std::size_t size, std::size_t &offset);
+  void Free(std::size_t offset, std::size_t size);
+
+  std::size_t capacity_;
+  std::size_t free_size_;
+
+ private:
+  // each free range by offset, and by size for the best fit
+  std::map<std::size_t, std::size_t> by_offset_;
+  std::set<std::pair<std::size_t, std::size_t>> by_size_;
+};
+
+};  // namespace graphics
+
+#endif
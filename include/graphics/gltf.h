@@ -0,0 +1,124 @@
+#ifndef GRAPHICS_GLTF_H
+#define GRAPHICS_GLTF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "graphics/mapped_file.h"
+
+namespace graphics {
+
+// The parts of a glTF 2.0 asset the renderer draws. Indices into the
+// other arrays are -1 when absent. Buffers are not read but mapped, so
+// data points into the .glb or .bin files for as long as the Gltf lives.
+
+struct GltfBuffer {
+  std::string uri;
+  std::size_t byte_length;
+  const unsigned char *data;
+};
+
+struct GltfBufferView {
+  int buffer;
+  std::size_t byte_offset;
+  std::size_t byte_length;
+  // 0 when tightly packed
+  std::size_t byte_stride;
+};
+
+// component_type takes the GL enum values glTF uses; component_count is 1
+// for SCALAR up to 16 for MAT4.
+struct GltfAccessor {
+  int buffer_view;
+  std::size_t byte_offset;
+  unsigned component_type;
+  unsigned component_count;
+  std::size_t count;
+  bool normalized;
+  bool bounded;
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// mode takes the GL primitive enum values glTF uses.
+struct GltfPrimitive {
+  int position;
+  int normal;
+  int tangent;
+  int texture_coordinate;
+  int indices;
+  int material;
+  unsigned mode;
+};
+
+struct GltfMesh {
+  std::string name;
+  std::vector<GltfPrimitive> primitive;
+};
+
+// path is the file the image's uri resolves to, empty when the image is
+// stored in a buffer view instead.
+struct GltfImage {
+  std::string path;
+  int buffer_view;
+};
+
+struct GltfTexture {
+  int source;
+};
+
+// Only texture coordinate set 0 is supported.
+struct GltfMaterial {
+  glm::vec4 base_color_factor;
+  int base_color_texture;
+  float metallic_factor;
+  float roughness_factor;
+  int metallic_roughness_texture;
+  int normal_texture;
+  int occlusion_texture;
+  float occlusion_strength;
+};
+
+struct GltfNode {
+  int mesh;
+  std::vector<int> children;
+  glm::mat4 matrix;
+};
+
+struct Gltf {
+  std::string directory;
+  std::vector<GltfBuffer> buffer;
+  std::vector<GltfBufferView> buffer_view;
+  std::vector<GltfAccessor> accessor;
+  std::vector<GltfMesh> mesh;
+  std::vector<GltfImage> image;
+  std::vector<GltfTexture> texture;
+  std::vector<GltfMaterial> material;
+  std::vector<GltfNode> node;
+  std::vector<std::vector<int>> scene;
+  int default_scene;
+  std::size_t json_size;
+  std::vector<std::unique_ptr<MappedFile>> file;
+};
+
+// Parses the .gltf or .glb at path in a single pass over its JSON and maps
+// the buffers it references. Throws std::string on failure.
+void LoadGltf(const std::string &path, Gltf &gltf);
+// The size in bytes of a component of the given type.
+std::size_t GltfComponentSize(unsigned component_type);
+// The bytes accessor starts at, checked to lie within its buffer view, and
+// the distance between its elements.
+const unsigned char *AccessorData(const Gltf &gltf, int accessor,
+                                  std::size_t &stride);
+// Every mesh the default scene, or the first, draws, with the world
+// transform it is drawn with.
+std::vector<std::pair<int, glm::mat4>> FlattenScene(const Gltf &gltf);
+
+};  // namespace graphics
+
+#endif
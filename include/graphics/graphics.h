@@ -1,12 +1,25 @@
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "GL/glew.h"
 #include "GLFW/glfw3.h"
 #include "glm/glm.hpp"
+#include "graphics/cull.h"
+#include "graphics/file_watcher.h"
+#include "graphics/free_list.h"
+#include "graphics/hash.h"
+#include "graphics/mesh.h"
+#include "graphics/mesh_file.h"
+#include "graphics/meshlet.h"
+#include "graphics/pack.h"
 
 namespace graphics {
 
@@ -25,14 +38,102 @@ extern float delta_time;
 
 extern bool enable_camera_move;
 
-extern unsigned sphere_vao;
-extern unsigned sphere_index_count;
-extern unsigned cube_vao;
 extern unsigned quad_vao;
 
-unsigned LoadTexture(const std::string &path);
-std::vector<std::vector<unsigned>> LoadPbrTexture(const char *material[],
-                                                  unsigned count);
+// An uploaded level of a mesh file: a VAO with the Vertex layout, or the
+// PackedVertex one if packed is set, at locations 0, 1 and 2 and an element
+// buffer of index_type indices, of which it draws index_count from
+// index_first. Every level of a file shares these. Packed positions decode
+// through position_offset and position_scale; only shaders that do so,
+// like pbr.vs, can draw them.
+struct Mesh {
+  unsigned vao;
+  unsigned vbo;
+  unsigned ebo;
+  unsigned vertex_count;
+  unsigned index_first;
+  unsigned index_count;
+  unsigned index_type;
+  float error;
+  bool packed;
+  glm::vec3 position_offset;
+  glm::vec3 position_scale;
+  Aabb bounds;
+  // the level's meshlets, their first indices counted from the start of
+  // the element buffer
+  std::vector<Meshlet> meshlet;
+};
+
+// Meshes loaded so far, each one's levels, keyed by shape, tessellation and
+// layout.
+extern std::unordered_map<std::uint64_t, std::vector<Mesh>> mesh_cache;
+
+// A texture whose texels all lie within kConstantTextureTolerance of one
+// value is not uploaded; constant is set and value holds that texel as the
+// shader would sample it. Otherwise id names a GL texture, shared by every
+// load whose decoded content has the same TextureKey.
+struct Texture {
+  unsigned id;
+  bool constant;
+  glm::vec4 value;
+};
+
+// A decoded texture's size and two 64-bit hashes of its texels, under
+// different seeds; 128 bits make a collision unlikely enough for a hit to
+// be trusted without reading the texture back.
+struct TextureKey {
+  std::uint64_t hash[2];
+  int width;
+  int height;
+  int component_count;
+
+  bool operator==(const TextureKey &other) const {
+    return hash[0] == other.hash[0] && hash[1] == other.hash[1] &&
+           width == other.width && height == other.height &&
+           component_count == other.component_count;
+  }
+};
+
+struct TextureKeyHash {
+  std::size_t operator()(const TextureKey &key) const {
+    return static_cast<std::size_t>(key.hash[0]);
+  }
+};
+
+extern const unsigned kConstantTextureTolerance;
+extern std::unordered_map<TextureKey, unsigned, TextureKeyHash> texture_cache;
+// Shader files as ShaderReloader last read them, which the Shader
+// constructor takes over those embedded at build time.
+extern std::unordered_map<std::string, std::string> shader_source;
+// Opened by main from bin/asset.pack when present; loaders look there first.
+extern Pack asset_pack;
+
+// The thread-safe half of LoadTexture: decodes an encoded image into pixel,
+// rows padded to the default GL_UNPACK_ALIGNMENT of 4, checks whether it is
+// constant and hashes its content. pixel keeps its capacity across decodes.
+struct DecodedTexture {
+  std::vector<unsigned char> pixel;
+  int width;
+  int height;
+  int component_count;
+  int row_pitch;
+  bool constant;
+  glm::vec4 value;
+  TextureKey key;
+};
+
+void DecodeTexture(const std::string &path, const unsigned char *data,
+                   std::size_t size, DecodedTexture &decoded);
+// The GL half of LoadTexture; call it on the thread owning the context.
+Texture UploadTexture(const DecodedTexture &decoded);
+Texture LoadTexture(const std::string &path);
+// Reads every material's maps in one batch through ReadAssets, decoding on a
+// thread pool while this thread uploads whatever has finished.
+std::vector<std::vector<Texture>> LoadPbrTexture(const char *material[],
+                                                 unsigned count);
+// Streams an equirectangular .hdr into an RGB16F texture no wider than
+// max_width, bottom row first, without holding the full-size image in memory.
+unsigned LoadHdrTexture(const std::string &path, int max_width);
 
 void ErrorCallback(int error, const char *description);
 void KeyCallback(GLFWwindow *window, int key, int scancode, int action,
@@ -42,6 +143,303 @@ void ScrollCallback(GLFWwindow *window, double xoffset, double yoffset);
 void FramebufferSizeCallback(GLFWwindow *window, int width, int height);
 void ProcessInput(GLFWwindow *window);
 
+// One glBufferData each for the vertices in the layout packed picks and
+// for the indices, straight from view, and a Mesh per level.
+std::vector<Mesh> UploadMeshFile(const MeshFileView &view,
+                                 bool packed = false);
+// Uploads shape at tessellation the first time it is asked for, from
+// bin/mesh/<MeshShapeName>.mesh, in the asset pack or on disk, when
+// mesh_import has written a current one and from BuildShapeAsset
+// otherwise; tessellation is ignored for shapes that have only one.
+const std::vector<Mesh> &GetMeshLevels(MeshShape shape,
+                                       unsigned tessellation,
+                                       bool packed = false);
+// GetMeshLevels' finest level.
+const Mesh &GetMesh(MeshShape shape, unsigned tessellation,
+                    bool packed = false);
+void DrawMesh(const Mesh &mesh);
+// Draws the index ranges CullMeshlets left of mesh in one
+// glMultiDrawElements.
+void DrawMeshRanges(const Mesh &mesh, const std::vector<unsigned> &first,
+                    const std::vector<unsigned> &count);
+
+const unsigned kPbrMapCount{5};
+const unsigned kLightCount{4};
+
+// The std140 layouts of the uniform blocks pbr.vs, pbr.fs and background.vs
+// declare; keep them in step. GLSL bools are 4-byte integers there, and a
+// scalar after a vec3 takes the rest of its 16 bytes. Frame holds what is
+// the same for every draw of a frame, Draw what changes between draws.
+struct FrameBlock {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 camera_position;
+  std::int32_t reserved;
+  glm::vec4 light_position[kLightCount];
+  glm::vec4 light_color[kLightCount];
+};
+
+struct DrawBlock {
+  glm::mat4 model;
+  // packed vertices decode as position_offset + position_scale * p
+  glm::vec3 position_offset;
+  std::int32_t packed_vertex;
+  glm::vec3 position_scale;
+  // without vertex tangents pbr.fs falls back to screen-space derivatives
+  std::int32_t vertex_tangent;
+  // per map in LoadPbrTexture's order, the value to use in place of its
+  // texture when map_constant is set
+  glm::vec4 map_value[kPbrMapCount];
+  std::int32_t map_constant[kPbrMapCount];
+  std::int32_t normal_y_up;
+  std::int32_t instanced;
+  // glTF puts v = 0 at the top of the image, which is decoded bottom row
+  // first
+  std::int32_t flip_texture_coord;
+};
+
+// The binding points Shader attaches the blocks named Frame and Draw to.
+const unsigned kFrameBlockBinding{0};
+const unsigned kDrawBlockBinding{1};
+
+// The buffers behind the Frame and Draw blocks, shared by every program.
+// SetFrame uploads a frame's FrameBlock and binds it. draw_ is the next
+// draw's DrawBlock, which the drawing functions below fill in field by
+// field; PushDraw copies it to the next slot of a ring and binds that slot
+// with glBindBufferRange, so the draws before keep theirs. Reaching the end
+// of the ring orphans its storage rather than wait for the GPU to finish
+// with it. The GL objects are created on first use, so UniformBlocks can
+// exist before the context.
+class UniformBlocks {
+ public:
+  explicit UniformBlocks(unsigned draw_capacity);
+  UniformBlocks(const UniformBlocks &) = delete;
+  UniformBlocks &operator=(const UniformBlocks &) = delete;
+
+  void SetFrame(const FrameBlock &frame);
+  void PushDraw();
+
+  DrawBlock draw_;
+  // PushDraws since the last SetFrame
+  unsigned draw_count_;
+
+ private:
+  void Initialize();
+
+  unsigned draw_capacity_;
+  unsigned frame_buffer_;
+  unsigned draw_buffer_;
+  // sizeof(DrawBlock) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+  std::size_t draw_stride_;
+  unsigned draw_next_;
+};
+
+extern UniformBlocks uniform_blocks;
+
+// Tells pbr.vs how to decode mesh's vertices, or plain float ones without
+// tangents when mesh is null, through uniform_blocks.draw_.
+void SetVertexFormat(const Mesh *mesh);
+
+// A glTF scene uploaded for pbr.vs and pbr.fs. Every buffer view holding
+// vertex or index data becomes one GL buffer, filled straight from the
+// mapped file, and each primitive's VAO points into those.
+struct ModelPrimitive {
+  unsigned vao;
+  unsigned mode;
+  // indices to draw, or vertices when index_type is 0
+  unsigned count;
+  unsigned index_type;
+  std::size_t index_offset;
+  unsigned material;
+  // whether location 3 holds tangents, from the file or generated
+  bool tangent;
+  // levels of detail, finest first, as byte offsets and counts into the
+  // element buffer and their errors; empty when the primitive has none
+  std::vector<std::size_t> lod_offset;
+  std::vector<unsigned> lod_count;
+  std::vector<float> lod_error;
+  // the level drawn last, and a sphere around the primitive to pick the
+  // next by
+  unsigned lod;
+  glm::vec3 center;
+  float radius;
+};
+
+struct Model {
+  std::vector<unsigned> buffer;
+  std::vector<ModelPrimitive> primitive;
+  // each glTF mesh's first primitive and primitive count
+  std::vector<std::pair<unsigned, unsigned>> mesh;
+  // textures per material in LoadPbrTexture's order, glTF's default
+  // material last
+  std::vector<std::vector<Texture>> material;
+  // the meshes the scene draws and their world transforms
+  std::vector<std::pair<int, glm::mat4>> node;
+  // a sphere around the whole scene
+  glm::vec3 center;
+  float radius;
+};
+
+// Loads a .gltf or .glb, logging its load throughput and, with analyze set,
+// the statistics of each indexed triangle mesh. Base color, metallic,
+// roughness and occlusion factors are baked into the textures pbr.fs reads,
+// metallic and roughness split out of their shared texture. With build_lods
+// set each triangle primitive gets a BuildLodChain, its levels moved with
+// its own indices into one 32-bit element buffer.
+Model LoadModel(const std::string &path, bool analyze = false,
+                bool build_lods = false);
+// Binds a material's textures to units 0 to 4 and fills in
+// uniform_blocks.draw_ for them. The demo's normal maps point +y down the
+// texture; glTF's, with normal_y_up set, point it up.
+void BindPbrMaterial(const std::vector<Texture> &texture,
+                     bool normal_y_up = false);
+// Draws each primitive with levels of detail at the one SelectLod picks
+// for pixels_per_unit, PixelsPerUnit at distance one, scaled to the
+// primitive's distance from camera_position. Zero, the default, draws the
+// finest. Each node's draws share one PushDraw, with another wherever the
+// material or the tangents change.
+void DrawModel(Model &model, const glm::mat4 &transform,
+               const glm::vec3 &camera_position = glm::vec3{0.0f},
+               float pixels_per_unit = 0.0f);
+
+// One object of an instanced draw: the top three rows of its model matrix,
+// applied after the Draw block's model, and its row of the material
+// table. Locations 4 to 6 and 7 in pbr.vs.
+struct Instance {
+  glm::vec4 row[3];
+  std::uint32_t material;
+};
+
+// Constant PBR parameters for instanced draws, which cannot switch textures
+// per object. albedo is linear.
+struct InstanceMaterial {
+  glm::vec3 albedo;
+  float ao;
+  float metallic;
+  float roughness;
+};
+
+// The InstanceMaterials instanced draws index, two texels each in a texture
+// buffer that pbr.fs reads on unit kMaterialTableUnit.
+class MaterialTable {
+ public:
+  MaterialTable();
+  ~MaterialTable();
+  MaterialTable(const MaterialTable &) = delete;
+  MaterialTable &operator=(const MaterialTable &) = delete;
+
+  void Set(const std::vector<InstanceMaterial> &material);
+  void Bind() const;
+
+ private:
+  unsigned buffer_;
+  unsigned texture_;
+};
+
+// Draws many copies of a mesh in one glDrawElementsInstanced. Instances
+// stream through a buffer orphaned on every Upload.
+class InstanceBatch {
+ public:
+  InstanceBatch();
+  ~InstanceBatch();
+  InstanceBatch(const InstanceBatch &) = delete;
+  InstanceBatch &operator=(const InstanceBatch &) = delete;
+
+  void Upload(const std::vector<Instance> &instance);
+  void Draw(const Mesh &mesh, const MaterialTable &material) const;
+
+  unsigned count_;
+
+ private:
+  unsigned instance_buffer_;
+};
+
+const unsigned kMaterialTableUnit{8};
+
+// Where a mesh lives in a MeshPool. id is dense, reused after Remove.
+struct PoolMesh {
+  unsigned id;
+  unsigned first_vertex;
+  unsigned vertex_count;
+  unsigned first_index;
+  unsigned index_count;
+  float error;
+  Aabb bounds;
+};
+
+// Static meshes in the float Vertex layout sharing one VAO and one vertex
+// and one index buffer, sub-allocated through free lists. Draws are queued
+// with an Instance each and go out grouped by mesh, one indirect command
+// per mesh whose instances read their attributes from baseInstance on: as
+// a single glMultiDrawElementsIndirect on GL 4.3 or ARB_multi_draw_indirect,
+// otherwise one glDrawElementsInstancedBaseVertex per mesh, re-pointing the
+// instance attributes in place of baseInstance. The GL objects are created
+// on the first Add, so a pool can exist before the context, and like
+// UploadMeshFile's they live as long as the context.
+class MeshPool {
+ public:
+  MeshPool(std::size_t vertex_capacity, std::size_t index_capacity);
+  MeshPool(const MeshPool &) = delete;
+  MeshPool &operator=(const MeshPool &) = delete;
+
+  // Throws std::string when the pool has no room for data.
+  PoolMesh Add(const MeshData &data);
+  void Remove(const PoolMesh &mesh);
+  void Queue(const PoolMesh &mesh, const Instance &instance);
+  // Draws and clears the queue.
+  void Draw(const MaterialTable &material);
+
+  bool multi_draw_indirect_;
+  // GL draw calls and indirect commands the last Draw issued
+  unsigned draw_call_count_;
+  unsigned command_count_;
+  FreeList vertex_space_;
+  FreeList index_space_;
+
+ private:
+  void Initialize();
+  void PointInstances(std::size_t first_instance);
+
+  unsigned vao_;
+  unsigned vertex_buffer_;
+  unsigned index_buffer_;
+  unsigned instance_buffer_;
+  unsigned indirect_buffer_;
+  // the mesh behind each id, and the ids Remove freed
+  std::vector<PoolMesh> mesh_;
+  std::vector<unsigned> free_id_;
+  // queued draws by mesh id, and Draw's staging for them
+  std::vector<std::pair<unsigned, Instance>> queue_;
+  std::vector<unsigned> first_;
+  std::vector<Instance> instance_;
+};
+
+// Every shape GetMesh builds can also come from this pool.
+extern MeshPool mesh_pool;
+const PoolMesh &GetPoolMesh(MeshShape shape, unsigned tessellation);
+
+// Times the GPU work between Begin and End with GL_TIME_ELAPSED queries,
+// which are read back a few frames late instead of stalling the pipeline.
+class GpuTimer {
+ public:
+  GpuTimer();
+  ~GpuTimer();
+  GpuTimer(const GpuTimer &) = delete;
+  GpuTimer &operator=(const GpuTimer &) = delete;
+
+  void Begin();
+  void End();
+  // Takes the oldest finished measurement, in milliseconds, if there is one.
+  bool Poll(double &milliseconds);
+
+ private:
+  static const unsigned kQueryCount{4};
+  unsigned query_[kQueryCount];
+  // queries begun and read so far
+  unsigned begun_;
+  unsigned read_;
+};
+
 void RenderSphere();
 void RenderCube();
 void RenderQuad();
@@ -74,28 +472,208 @@ class Camera {
   void UpdateCamera();
 };
 
+// A uniform's name as the HashString key Shader finds its location by.
+// Declared constexpr, as the uniforms set every frame are, the name is
+// hashed at compile time; built from a literal in place, it is hashed
+// where it is used, which suits setup code.
+struct Uniform {
+  constexpr Uniform(const char *name) : key{HashString(name)} {}
+  std::uint64_t key;
+};
+
+// uniforms the cubemap captures set per face
+constexpr Uniform kUniformView{"view"};
+constexpr Uniform kUniformProjection{"projection"};
+
+// Linked programs kept on disk with glGetProgramBinary, one file per key,
+// and restored with glProgramBinary, which skips compiling and linking.
+// A key hashes the driver's vendor, renderer and version with every stage's
+// source after its defines, so a variant, an edit or a driver update each
+// miss. A binary the driver turns down anyway is counted as rejected and
+// its program is compiled and stored afresh. Until Open, or without
+// program binary support, the cache neither finds nor stores anything.
+class ProgramCache {
+ public:
+  ProgramCache();
+  ProgramCache(const ProgramCache &) = delete;
+  ProgramCache &operator=(const ProgramCache &) = delete;
+
+  // Needs the context current; creates directory if need be.
+  void Open(const std::string &directory);
+  // hash holds a program's stage source hashes and its defines' hash.
+  std::uint64_t Key(const std::vector<std::uint64_t> &hash) const;
+  // Links program from key's binary; false leaves it unlinked.
+  bool Load(std::uint64_t key, unsigned program);
+  // Call before linking a program to Store.
+  void Retrievable(unsigned program) const;
+  void Store(std::uint64_t key, unsigned program) const;
+
+  unsigned hit_;
+  unsigned miss_;
+  unsigned rejected_;
+
+ private:
+  std::string Path(std::uint64_t key) const;
+
+  bool enabled_;
+  std::string directory_;
+  std::string driver_;
+};
+
+extern ProgramCache program_cache;
+
+// A linked program and the locations of its active uniforms, looked up
+// once after linking. Setters find a location by binary search over the
+// keys, without touching the name or GL; uniforms the program lacks, or
+// the compiler dropped, resolve to -1, which GL ignores. Blocks named
+// Frame and Draw are attached to kFrameBlockBinding and kDrawBlockBinding.
+// defines, #define lines, go in after each stage's #version line, and a
+// #line directive after them keeps error messages on the file's lines.
+// Stage files are found in shader_source, then among the embedded ones,
+// then on disk, and key program_cache by their hashes. Programs come from
+// program_cache when it has them and go into it when not, whether built at
+// construction or by Reload. Compile status is only asked for once linking
+// has failed, so a good program waits on the driver once.
 class Shader {
  public:
   Shader(const std::string &vertex_shader, const std::string &fragment_shader,
-         const std::string &geometry_shader = std::string{});
+         const std::string &geometry_shader = std::string{},
+         const std::string &defines = std::string{});
   void UseProgram();
-  void SetBool(const std::string &name, bool value) const;
-  void SetInt(const std::string &name, int value) const;
-  void SetFloat(const std::string &name, float value) const;
-  void SetVec2(const std::string &name, const glm::vec2 &value) const;
-  void SetVec2(const std::string &name, float x, float y) const;
-  void SetVec3(const std::string &name, const glm::vec3 &value) const;
-  void SetVec3(const std::string &name, float x, float y, float z) const;
-  void SetVec4(const std::string &name, const glm::vec4 &value) const;
-  void SetVec4(const std::string &name, float x, float y, float z, float w);
-  void SetMat2(const std::string &name, const glm::mat2 &value) const;
-  void SetMat3(const std::string &name, const glm::mat3 &value) const;
-  void SetMat4(const std::string &name, const glm::mat4 &value) const;
+  void SetBool(Uniform uniform, bool value) const;
+  void SetInt(Uniform uniform, int value) const;
+  void SetFloat(Uniform uniform, float value) const;
+  void SetVec2(Uniform uniform, const glm::vec2 &value) const;
+  void SetVec2(Uniform uniform, float x, float y) const;
+  void SetVec3(Uniform uniform, const glm::vec3 &value) const;
+  void SetVec3(Uniform uniform, float x, float y, float z) const;
+  // Sets count elements of an array from its first; uniform names the
+  // array without a subscript.
+  void SetVec3(Uniform uniform, const glm::vec3 *value, int count) const;
+  void SetVec4(Uniform uniform, const glm::vec4 &value) const;
+  void SetVec4(Uniform uniform, float x, float y, float z, float w) const;
+  void SetMat2(Uniform uniform, const glm::mat2 &value) const;
+  void SetMat3(Uniform uniform, const glm::mat3 &value) const;
+  void SetMat4(Uniform uniform, const glm::mat4 &value) const;
+  int Location(Uniform uniform) const;
+
+  // The stage files the program is built from.
+  const std::vector<std::string> &Files() const { return file_; }
+  // Starts building the program again from shader_source, leaving program
+  // in use meanwhile. With ARB_parallel_shader_compile the driver compiles
+  // and links on its own threads.
+  void Reload();
+  // Returns false while the program Reload started is still being built,
+  // or without a Reload. Otherwise swaps it in for program, deleting the
+  // old one and running setup_ on it, or on failure deletes it, keeps
+  // program and puts the log in error, and returns true.
+  bool FinishReload(std::string &error);
 
   unsigned program;
+  // runs, with the program in use, on each program a reload swaps in
+  std::function<void(Shader &)> setup_;
 
  private:
+  // The stages' sources with defines_ after their #version lines, and
+  // their cache key.
+  std::vector<std::string> Source(std::uint64_t &key) const;
+  // Compiles source into new stages of program and links it, without
+  // waiting for either.
+  void Build(unsigned program, const std::vector<std::string> &source,
+             std::vector<unsigned> &stage) const;
+  // Attaches the blocks named Frame and Draw to their binding points.
+  void BindBlocks();
   void CheckError(unsigned shader, const std::string &type);
+  // Fills location_ from the linked program. An array is entered under
+  // each element's name and under its own, which GL takes for element 0.
+  void ResolveUniforms();
+
+  // sorted by key
+  std::vector<std::pair<std::uint64_t, int>> location_;
+  std::vector<std::string> file_;
+  std::string defines_;
+  // the program a Reload is building, or 0, its stages and its cache key
+  unsigned pending_;
+  std::vector<unsigned> pending_stage_;
+  std::uint64_t pending_key_;
+};
+
+// The bits of a shader variant key. Each feature bit compiles its code in
+// with a #define rather than branching on a uniform per fragment, so a
+// variant without a feature neither runs nor samples for it. Bits 4 to 7
+// hold the number of punctual lights, LIGHT_COUNT, from 0 to kLightCount,
+// and are left 0 without kShaderPunctualLight, which alone reads them, so
+// one program serves every count then. A new feature takes a bit here and
+// its #define in ShaderDefines.
+const unsigned kShaderPunctualLight{1u << 0};
+const unsigned kShaderImageBasedLight{1u << 1};
+const unsigned kShaderLightCountShift{4};
+const unsigned kShaderLightCountMask{0xfu << kShaderLightCountShift};
+
+inline unsigned ShaderLightCount(unsigned count) {
+  return count << kShaderLightCountShift;
+}
+// The #define lines key stands for.
+std::string ShaderDefines(unsigned key);
+
+// A program compiled once per variant key, on the first Get of the key,
+// and kept. setup runs on each new variant, in use, for what the program
+// needs set once, such as its sampler units.
+class ShaderVariants {
+ public:
+  ShaderVariants(const std::string &vertex_shader,
+                 const std::string &fragment_shader,
+                 std::function<void(Shader &)> setup);
+  ShaderVariants(const ShaderVariants &) = delete;
+  ShaderVariants &operator=(const ShaderVariants &) = delete;
+
+  Shader &Get(unsigned key);
+  std::size_t Size() const { return variant_.size(); }
+  std::vector<std::string> Files() const {
+    return {vertex_shader_, fragment_shader_};
+  }
+  // Appends the variants built so far.
+  void Shaders(std::vector<Shader *> &shader);
+
+ private:
+  std::string vertex_shader_;
+  std::string fragment_shader_;
+  std::function<void(Shader &)> setup_;
+  std::unordered_map<unsigned, Shader> variant_;
+};
+
+// Rebuilds the programs of the watched Shaders and ShaderVariants when
+// their files change on disk, so shaders can be worked on without a
+// restart. Every embedded file is watched, since any may be included; on a
+// change each watched stage file goes through PreprocessShader again, and
+// those that come out different go into shader_source, where variants
+// built later find them too, and rebuild the programs using them. A
+// program that fails to build leaves the one before in use and its log in
+// error_ until the next change.
+class ShaderReloader {
+ public:
+  ShaderReloader();
+  ShaderReloader(const ShaderReloader &) = delete;
+  ShaderReloader &operator=(const ShaderReloader &) = delete;
+
+  // Needs the context current.
+  void Watch(Shader &shader);
+  void Watch(ShaderVariants &variants);
+  // Call once a frame, before drawing.
+  void Update();
+
+  std::string error_;
+  // programs swapped in so far
+  unsigned reload_count_;
+
+ private:
+  void WatchFiles(const std::vector<std::string> &file);
+
+  FileWatcher watcher_;
+  // the paths given watcher_
+  std::vector<std::string> watched_;
+  std::vector<Shader *> shader_;
+  std::vector<ShaderVariants *> variants_;
 };
 
 };  // namespace graphics
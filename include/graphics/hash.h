@@ -0,0 +1,24 @@
+#ifndef GRAPHICS_HASH_H
+#define GRAPHICS_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace graphics {
+
+// A fast 64-bit content hash, FNV-style over 8-byte words. Not for security.
+std::uint64_t HashBytes(const void *data, std::size_t size,
+                        std::uint64_t seed = 14695981039346656037ull);
+// 64-bit FNV-1a over a NUL-terminated string. Being constexpr, it hashes
+// literals at compile time wherever a constant is required.
+constexpr std::uint64_t HashString(
+    const char *text, std::uint64_t hash = 14695981039346656037ull) {
+  return *text ? HashString(text + 1,
+                            (hash ^ static_cast<unsigned char>(*text)) *
+                                1099511628211ull)
+               : hash;
+}
+
+};  // namespace graphics
+
+#endif
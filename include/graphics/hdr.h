@@ -0,0 +1,58 @@
+#ifndef GRAPHICS_HDR_H
+#define GRAPHICS_HDR_H
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace graphics {
+
+// Reads a Radiance .hdr file one scanline at a time, top row first, so only
+// a row of the image is ever held in memory.
+class HdrReader {
+ public:
+  explicit HdrReader(const std::string &path);
+  // Reads from size bytes at data, which must outlive the reader; path only
+  // names the image in errors.
+  HdrReader(const std::string &path, const unsigned char *data,
+            std::size_t size);
+  HdrReader(const HdrReader &) = delete;
+  HdrReader &operator=(const HdrReader &) = delete;
+
+  // Decodes the next scanline into width_ * 3 floats; returns false once
+  // every row has been read.
+  bool ReadRow(float *rgb);
+
+  int width_;
+  int height_;
+
+ private:
+  void ReadHeader();
+  int GetByte();
+  std::string GetLine();
+  void Fail(const std::string &reason);
+
+  std::string path_;
+  // closed however the constructor leaves
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> file_;
+  std::vector<unsigned char> buffer_;
+  const unsigned char *data_;
+  std::size_t buffer_position_;
+  std::size_t buffer_size_;
+  std::vector<unsigned char> rgbe_;
+  int row_;
+};
+
+// Box-filters the image by the smallest integer factor that brings its width
+// to at most max_width and hands each filtered row to row_callback as soon
+// as its source rows have been read. An image fewer rows high than the
+// factor still gives one row. Returns the filtered size.
+void DownsampleHdr(
+    HdrReader &reader, int max_width, int &width, int &height,
+    const std::function<void(int y, const float *rgb)> &row_callback);
+
+};  // namespace graphics
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef GRAPHICS_JSON_H
+#define GRAPHICS_JSON_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace graphics {
+
+// A pull parser over a JSON text in memory. The caller walks the document
+// once, in order, asking for the value it expects next; nothing is kept
+// but the nesting of the containers still open, so callers fill their own
+// structures as they go instead of building a tree first. Every call
+// throws std::string on malformed input or a value of the wrong type.
+//
+//   reader.BeginObject();
+//   std::string key;
+//   while (reader.NextMember(key)) {
+//     if (key == "count") {
+//       count = reader.ReadNumber();
+//     } else {
+//       reader.Skip();
+//     }
+//   }
+class JsonReader {
+ public:
+  enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  JsonReader(const char *data, std::size_t size);
+
+  // The type of the next value, without consuming it.
+  Type Peek();
+  void BeginObject();
+  // Steps to the next member of the innermost object, reading its key;
+  // returns false, closing the object, after the last one.
+  bool NextMember(std::string &key);
+  void BeginArray();
+  // Steps to the next element of the innermost array; returns false,
+  // closing the array, after the last one.
+  bool NextElement();
+  double ReadNumber();
+  bool ReadBool();
+  void ReadString(std::string &value);
+  std::string ReadString();
+  // Consumes the next value whatever it is.
+  void Skip();
+  // Throws unless only whitespace is left.
+  void End();
+
+ private:
+  void SkipSpace();
+  char Next();
+  void Expect(char c);
+  void Fail(const std::string &what) const;
+
+  const char *data_;
+  const char *end_;
+  const char *cursor_;
+  // for each open container, whether its first element is still to come
+  std::vector<bool> first_;
+};
+
+};  // namespace graphics
+
+#endif
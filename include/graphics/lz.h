@@ -0,0 +1,62 @@
+#ifndef GRAPHICS_LZ_H
+#define GRAPHICS_LZ_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "graphics/thread_pool.h"
+
+namespace graphics {
+
+// A byte-oriented LZ77 codec in the LZ4 block format: greedy matching
+// through a 16K-entry hash table for speed over ratio, and a decoder that
+// copies in 8 and 16 byte strides.
+//
+// Large inputs go through the block stream below, which cuts them into
+// kLzBlockSize pieces compressed independently, so any number of threads
+// can decompress one asset at once. Stream layout, little-endian:
+//   LzHeader
+//   std::uint32_t block_end[block_count]  end of each block after the table,
+//                                         top bit set if stored raw
+//   block data
+const char kLzMagic[4]{'G', 'L', 'Z', '1'};
+const std::size_t kLzBlockSize{256 << 10};
+const std::uint32_t kLzStoredBlock{0x80000000u};
+
+struct LzHeader {
+  char magic[4];
+  std::uint32_t block_size;
+  std::uint64_t size;
+};
+
+// Worst-case compressed size of a size byte block.
+std::size_t LzCompressBound(std::size_t size);
+// Compresses size bytes at data into out, which must hold
+// LzCompressBound(size) bytes; returns the compressed size.
+std::size_t LzCompress(const unsigned char *data, std::size_t size,
+                       unsigned char *out);
+// Decompresses a block that must expand to exactly out_size bytes; returns
+// false on malformed input without touching memory outside either buffer.
+bool LzDecompress(const unsigned char *data, std::size_t size,
+                  unsigned char *out, std::size_t out_size);
+
+std::vector<unsigned char> LzCompressBlocks(
+    const unsigned char *data, std::size_t size,
+    std::size_t block_size = kLzBlockSize);
+// Validates the stream header and block table and reports the stream's
+// decompressed size and block count; returns false if it is malformed.
+bool LzStreamInfo(const unsigned char *stream, std::size_t size,
+                  std::size_t &raw_size, std::size_t &block_count);
+// Decompresses one block of a validated stream into its place in out.
+bool LzDecompressBlock(const unsigned char *stream, std::size_t block,
+                       unsigned char *out);
+// Decompresses a whole stream into out, which must hold the raw size, with
+// the blocks spread over pool when one is given. Throws std::string on
+// malformed input. Do not call it from a task running on pool.
+void LzDecompressBlocks(const unsigned char *stream, std::size_t size,
+                        unsigned char *out, ThreadPool *pool = nullptr);
+
+};  // namespace graphics
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef GRAPHICS_MAPPED_FILE_H
+#define GRAPHICS_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace graphics {
+
+// A whole file mapped read-only into memory.
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Returns false, leaving the file closed, if path cannot be mapped.
+  bool Open(const std::string &path);
+  void Close();
+  bool IsOpen() const { return data_ != nullptr; }
+  const unsigned char *Data() const { return data_; }
+  std::size_t Size() const { return size_; }
+
+ private:
+  int fd_;
+  const unsigned char *data_;
+  std::size_t size_;
+};
+
+};  // namespace graphics
+
+#endif
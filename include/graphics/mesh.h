@@ -0,0 +1,128 @@
+#ifndef GRAPHICS_MESH_H
+#define GRAPHICS_MESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace graphics {
+
+// The interleaved layout every shader expects at locations 0 to 3. tangent
+// is a MikkTSpace tangent: xyz points along increasing u, orthogonal to the
+// normal, and w is the sign taking cross(normal, tangent) to increasing v.
+struct Vertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 texture_coordinate;
+  glm::vec4 tangent;
+};
+
+// The compact layout, 16 bytes against Vertex's 48:
+//   position            unsigned 16-bit normalized, the fourth unused; the
+//                       position is position_offset + position_scale * it
+//   normal              GL_INT_2_10_10_10_REV, not normalized: x and y hold
+//                       the octahedral encoding times kOctahedralScale, z
+//                       the tangent's angle around the normal times
+//                       kOctahedralScale / pi, and w the tangent's sign
+//   texture_coordinate  half floats
+// pbr.vs decodes both layouts.
+struct PackedVertex {
+  std::uint16_t position[4];
+  std::uint32_t normal;
+  std::uint16_t texture_coordinate[2];
+};
+
+const float kOctahedralScale{511.0f};
+
+// An indexed triangle list on the CPU. Indices are index_size bytes each,
+// 2 whenever the vertex count allows and 4 otherwise. error is the largest
+// distance between the triangles and the surface they approximate, in the
+// mesh's own units, for choosing between levels of detail.
+struct MeshData {
+  std::vector<Vertex> vertex;
+  std::vector<unsigned char> index;
+  unsigned index_size{4};
+  float error{0.0f};
+
+  std::size_t IndexCount() const { return index.size() / index_size; }
+  unsigned GetIndex(std::size_t i) const;
+  void SetIndex(std::size_t i, unsigned value);
+};
+
+// Fills a MeshData in place: Begin sizes both buffers once for the counts
+// given, and vertices and triangles are written straight into them.
+class MeshBuilder {
+ public:
+  explicit MeshBuilder(MeshData &mesh);
+
+  void Begin(std::size_t vertex_count, std::size_t index_count);
+  // Tangents are left zero for GenerateTangents.
+  void AddVertex(const glm::vec3 &position, const glm::vec3 &normal,
+                 const glm::vec2 &texture_coordinate);
+  void AddTriangle(unsigned a, unsigned b, unsigned c);
+  // Trims the buffers to what was actually added.
+  void End();
+
+ private:
+  MeshData &mesh_;
+  std::size_t vertex_count_;
+  std::size_t index_count_;
+};
+
+// A sphere of segment_count segments around and segment_count / 2 + 1
+// rings from pole to pole, without the degenerate triangles at the poles.
+void BuildUvSphere(MeshData &mesh, unsigned segment_count, float radius);
+// A cube from -1 to 1 with a separate quad per face.
+void BuildCube(MeshData &mesh);
+// An icosahedron with its edges split level times, 20 * 4^level triangles
+// of nearly equal size. Two of its vertices sit on the poles, and vertices
+// on the texture seam and at the poles are duplicated per triangle as
+// needed for texture coordinates matching BuildUvSphere's.
+void BuildIcosphere(MeshData &mesh, unsigned level, float radius);
+
+// Fills in every vertex's tangent the way MikkTSpace does: each triangle's
+// texture space gradients are projected into the plane of each corner's
+// normal and summed weighted by the corner's angle, and the sign records
+// whether the bitangent sum agrees with cross(normal, tangent). Unlike
+// MikkTSpace it never splits a vertex whose triangles disagree in sign.
+// Vertices no triangle maps get an arbitrary tangent orthogonal to the
+// normal.
+void GenerateTangents(MeshData &mesh);
+
+// Quantizes mesh's vertices into packed, returning in position_offset and
+// position_scale the transform back to mesh's positions. Positions are
+// quantized over the mesh's bounds, to within a 65535th of their extent.
+void PackVertices(const MeshData &mesh, std::vector<PackedVertex> &packed,
+                  glm::vec3 &position_offset, glm::vec3 &position_scale);
+// The normal word of a PackedVertex for unit vector normal and a tangent
+// orthogonal to it. The tangent's angle is measured in TangentBasis of the
+// normal as pbr.vs decodes it, so quantizing the normal does not skew it.
+std::uint32_t PackNormal(const glm::vec3 &normal, const glm::vec4 &tangent);
+// Two unit vectors completing an orthonormal basis with unit vector normal,
+// continuous everywhere but at the sign change of normal.z, where the
+// caller picks the side with upper; pbr.vs builds the same one.
+void TangentBasis(const glm::vec3 &normal, bool upper, glm::vec3 &x,
+                  glm::vec3 &y);
+// Rounds value to the nearest IEEE half float.
+std::uint16_t FloatToHalf(float value);
+
+// Sphere level of detail l is BuildIcosphere level kSphereLodCount - 1 - l,
+// from 20480 triangles down to 20.
+const unsigned kSphereLodCount{6};
+
+// How many pixels one unit spans at distance from a perspective camera.
+float PixelsPerUnit(float distance, float yfov, float viewport_height);
+// Picks from a chain of lod_count levels of detail, finest first, whose
+// errors increase along the chain. The result is the coarsest level whose
+// error stays under max_pixel_error pixels, but a level is only left once
+// its error is outside the band hysteresis times wider or narrower, so an
+// object sitting at a switch point does not flip between two levels.
+unsigned SelectLod(const float *error, unsigned lod_count,
+                   float pixels_per_unit, unsigned current,
+                   float max_pixel_error = 1.0f, float hysteresis = 0.25f);
+
+};  // namespace graphics
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef GRAPHICS_MESH_FILE_H
+#define GRAPHICS_MESH_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "graphics/mesh.h"
+#include "graphics/meshlet.h"
+#include "graphics/simplify.h"
+
+namespace graphics {
+
+// kIcosphere's tessellation is its subdivision level. kSimplifiedIcosphere
+// is kIcosphere at tessellation followed by a BuildLodChain of it, each
+// level a quarter of the one before as the icosphere levels are.
+enum MeshShape { kUvSphere, kCube, kIcosphere, kSimplifiedIcosphere };
+
+// On-disk layout of a mesh file, all little-endian:
+//   MeshFileHeader
+//   MeshFileLod[lod_count]
+//   Meshlet[meshlet_count]
+//   Vertex[vertex_count]        from vertex_offset
+//   PackedVertex[vertex_count]  from packed_vertex_offset
+//   indices, index_size bytes each, every level's one after another, from
+//   index_offset
+// The three blobs start on kMeshFileAlignment boundaries so they can be
+// handed to glBufferData straight from the mapping. Files are rejected
+// unless their version is kMeshFileVersion; bump it whenever the layout or
+// the way shapes are built changes, and mesh_import writes them afresh.
+const char kMeshFileMagic[4]{'G', 'M', 'S', 'H'};
+const std::uint32_t kMeshFileVersion{1};
+const std::uint64_t kMeshFileAlignment{64};
+
+struct MeshFileHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t vertex_count;
+  std::uint32_t index_count;
+  std::uint32_t index_size;
+  std::uint32_t lod_count;
+  std::uint32_t meshlet_count;
+  std::uint32_t reserved;
+  float bounds_min[3];
+  float bounds_max[3];
+  // PackedVertex positions decode as position_offset + position_scale * p
+  float position_offset[3];
+  float position_scale[3];
+  std::uint64_t vertex_offset;
+  std::uint64_t packed_vertex_offset;
+  std::uint64_t index_offset;
+  std::uint64_t size;
+};
+
+// A level of detail: indices index_first to index_first + index_count - 1
+// and meshlets meshlet_first to meshlet_first + meshlet_count - 1, whose
+// own first indices count from the start of all the indices.
+struct MeshFileLod {
+  std::uint32_t index_first;
+  std::uint32_t index_count;
+  std::uint32_t meshlet_first;
+  std::uint32_t meshlet_count;
+  float error;
+  std::uint32_t reserved;
+};
+
+// What a mesh file holds: mesh's indices are every level's, one after
+// another, all indexing mesh's vertices.
+struct MeshAsset {
+  MeshData mesh;
+  std::vector<MeshFileLod> lod;
+  std::vector<Meshlet> meshlet;
+};
+
+// The name shape goes by in logs and in file names.
+std::string MeshShapeName(MeshShape shape, unsigned tessellation);
+// Builds shape at tessellation, with tangents, and its levels of detail as
+// BuildMeshAsset takes them; tessellation is ignored for shapes that have
+// only one.
+void BuildShape(MeshShape shape, unsigned tessellation, MeshData &data,
+                std::vector<MeshLod> &lod);
+// BuildShape and BuildMeshAsset in one, ready for upload or
+// SerializeMeshFile.
+void BuildShapeAsset(MeshShape shape, unsigned tessellation,
+                     MeshAsset &asset);
+// Fills asset with mesh's vertices and lod's levels of them, as
+// BuildLodChain leaves them, the first normally mesh's own triangles. Each
+// level is ordered for the vertex cache and overdraw and split into
+// meshlets, and the vertices are then ordered for fetch across them all.
+void BuildMeshAsset(const MeshData &mesh, const std::vector<MeshLod> &lod,
+                    MeshAsset &asset);
+
+void SerializeMeshFile(const MeshAsset &asset,
+                       std::vector<unsigned char> &data);
+// Writes asset to path. Throws std::string on failure.
+void WriteMeshFile(const std::string &path, const MeshAsset &asset);
+
+// A mesh file's parts, pointing into its bytes.
+struct MeshFileView {
+  const MeshFileHeader *header;
+  const MeshFileLod *lod;
+  const Meshlet *meshlet;
+  const Vertex *vertex;
+  const PackedVertex *packed_vertex;
+  const unsigned char *index;
+};
+
+// Checks that data, size bytes of a mesh file, is whole and current and
+// points view into it. Throws std::string otherwise.
+void ParseMeshFile(const unsigned char *data, std::size_t size,
+                   MeshFileView &view);
+
+};  // namespace graphics
+
+#endif
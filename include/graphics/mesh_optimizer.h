@@ -0,0 +1,45 @@
+#ifndef GRAPHICS_MESH_OPTIMIZER_H
+#define GRAPHICS_MESH_OPTIMIZER_H
+
+#include <vector>
+
+#include "graphics/mesh.h"
+
+namespace graphics {
+
+// Post-transform cache size the reordering targets and the statistics
+// simulate, a FIFO as on most hardware.
+const unsigned kVertexCacheSize{16};
+
+struct MeshStatistics {
+  // vertices transformed per triangle, from 0.5 at best to 3
+  float acmr;
+  // vertices transformed per vertex referenced, 1 at best
+  float atvr;
+  // fragments shaded per pixel covered, averaged over six axis-aligned
+  // views with back faces culled, 1 at best
+  float overdraw;
+};
+
+MeshStatistics AnalyzeMesh(const MeshData &mesh,
+                           unsigned cache_size = kVertexCacheSize);
+
+// Reorders triangles for the post-transform cache with Tipsify (Sander,
+// Nehab and Barczak 2007) and fills cluster with the first triangle of
+// each run between cache flushes, split further wherever a run's own ACMR
+// has fallen to within threshold of the whole mesh's.
+void OptimizeVertexCache(MeshData &mesh, std::vector<unsigned> &cluster,
+                         unsigned cache_size = kVertexCacheSize,
+                         float threshold = 1.05f);
+// Sorts the clusters from OptimizeVertexCache so that those facing out from
+// the middle of the mesh, which occlude the rest, are drawn first.
+void OptimizeOverdraw(MeshData &mesh, const std::vector<unsigned> &cluster);
+// Renumbers vertices in the order the index buffer first uses them, so
+// vertex fetch walks memory forward.
+void OptimizeVertexFetch(MeshData &mesh);
+// All three in order.
+void OptimizeMesh(MeshData &mesh);
+
+};  // namespace graphics
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef GRAPHICS_MESHLET_H
+#define GRAPHICS_MESHLET_H
+
+#include <cstddef>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "graphics/cull.h"
+#include "graphics/mesh.h"
+
+namespace graphics {
+
+// The sizes mesh shader hardware is built around: 64 vertices fit a wave
+// and 124 triangles keep the primitive indices under 512 bytes.
+const unsigned kMeshletMaxVertices{64};
+const unsigned kMeshletMaxTriangles{124};
+
+// A small cluster of a mesh's triangles, indices first to first + count - 1
+// of its index buffer, with bounds for culling it whole. The bounds are in
+// the mesh's own space.
+struct Meshlet {
+  unsigned first;
+  unsigned count;
+  unsigned vertex_count;
+  glm::vec3 center;
+  float radius;
+  // every triangle faces away from a camera at c when
+  // dot(normalize(cone_apex - c), cone_axis) > cone_cutoff, which never
+  // holds when cone_cutoff is above one
+  glm::vec3 cone_apex;
+  glm::vec3 cone_axis;
+  float cone_cutoff;
+};
+
+// Reorders mesh's triangles into meshlets of at most max_vertices distinct
+// vertices and max_triangles triangles and fills meshlet with them. Each
+// meshlet grows from the earliest triangle left by adding the neighbour
+// that brings in the fewest new vertices, so an order from OptimizeMesh
+// mostly survives, and its triangles are then reordered for the vertex
+// cache on their own.
+void BuildMeshlets(MeshData &mesh, std::vector<Meshlet> &meshlet,
+                   unsigned max_vertices = kMeshletMaxVertices,
+                   unsigned max_triangles = kMeshletMaxTriangles);
+
+// Appends the index ranges of the meshlets that may be seen, outside
+// neither frustum nor their cones, to first and count, merging neighbours,
+// and returns the triangles they hold. frustum and camera_position are in
+// the mesh's space; back faces stay back faces under its transform.
+std::size_t CullMeshlets(const std::vector<Meshlet> &meshlet,
+                         const Frustum &frustum,
+                         const glm::vec3 &camera_position,
+                         std::vector<unsigned> &first,
+                         std::vector<unsigned> &count);
+
+};  // namespace graphics
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef GRAPHICS_PACK_H
+#define GRAPHICS_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphics {
+
+// On-disk layout of an asset pack, all little-endian:
+//   PackHeader
+//   PackEntry[entry_count]
+//   std::uint32_t bucket[bucket_count]  entry index + 1, 0 when empty
+//   entry names, not terminated
+//   entry data, each entry starting on a kPackAlignment boundary
+// bucket_count is a power of two and buckets are probed linearly from
+// hash & (bucket_count - 1). The first ordered_count entries are laid out
+// in the order a previous run first read them. Entries flagged
+// kPackCompressed hold an lz block stream of raw_size bytes.
+const char kPackMagic[4]{'G', 'P', 'A', 'K'};
+const std::uint32_t kPackVersion{2};
+const std::uint64_t kPackAlignment{4096};
+const std::uint32_t kPackCompressed{1};
+
+struct PackHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t entry_count;
+  std::uint32_t ordered_count;
+  std::uint32_t bucket_count;
+  std::uint32_t name_size;
+};
+
+struct PackEntry {
+  std::uint64_t hash;
+  std::uint64_t offset;
+  std::uint64_t size;
+  std::uint64_t raw_size;
+  std::uint32_t name_offset;
+  std::uint32_t name_size;
+  std::uint32_t flags;
+  std::uint32_t reserved;
+};
+
+// A read-only, memory-mapped asset pack. Entries are named by their path
+// relative to the directory the pack was built from.
+class Pack {
+ public:
+  Pack();
+  ~Pack();
+  Pack(const Pack &) = delete;
+  Pack &operator=(const Pack &) = delete;
+
+  // Maps the pack at path and starts reading its ordered entries ahead.
+  // Lookups of absolute paths under root are made relative to it. Returns
+  // false, leaving the pack closed, if there is no readable pack at path.
+  bool Open(const std::string &path, const std::string &root);
+  void Close();
+  bool IsOpen() const { return data_ != nullptr; }
+
+  // Returns the entry for path, or nullptr if it is not in the pack. Safe to
+  // call from several threads.
+  const PackEntry *Find(const std::string &path);
+  // The mapped bytes of entry, size bytes long and compressed if flagged.
+  const unsigned char *Data(const PackEntry &entry) const {
+    return data_ + entry.offset;
+  }
+  // Copies or decompresses entry into data, resized to its raw size.
+  void Read(const PackEntry &entry, std::vector<unsigned char> &data) const;
+  // Writes the entry names in the order Find first returned them, one per
+  // line, for the pack tool to lay the next pack out by.
+  void WriteAccessOrder(const std::string &path);
+
+ private:
+  void Prefetch();
+
+  std::string root_;
+  int fd_;
+  const unsigned char *data_;
+  std::size_t size_;
+  const PackHeader *header_;
+  const PackEntry *entry_;
+  const std::uint32_t *bucket_;
+  const char *name_;
+  std::mutex mutex_;
+  std::vector<bool> accessed_;
+  std::vector<std::uint32_t> access_order_;
+};
+
+// Packs the files named by names, paths relative to root, into output.
+// Names listed in order come first and in that order; the rest follow
+// sorted. Each file also named in compress is stored lz compressed if that
+// saves at least an eighth of it, the rest raw. Throws std::string on
+// failure.
+void WritePack(const std::string &output, const std::string &root,
+               std::vector<std::string> names,
+               const std::vector<std::string> &order,
+               const std::vector<std::string> &compress = {});
+
+};  // namespace graphics
+
+#endif
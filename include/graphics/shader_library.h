@@ -0,0 +1,27 @@
+#ifndef GRAPHICS_SHADER_LIBRARY_H
+#define GRAPHICS_SHADER_LIBRARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace graphics {
+
+// A shader file as shader_embed built it into the binary: through
+// PreprocessShader, and hashed with HashBytes, at build time. name is the
+// file's name, as the Shader constructor is given it.
+struct EmbeddedShader {
+  const char *name;
+  const char *source;
+  std::size_t size;
+  std::uint64_t hash;
+};
+
+// Null if no file was embedded under name.
+const EmbeddedShader *FindEmbeddedShader(const std::string &name);
+// Every embedded file, in name order.
+const EmbeddedShader *EmbeddedShaders(std::size_t &count);
+
+};  // namespace graphics
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef GRAPHICS_SHADER_PREPROCESS_H
+#define GRAPHICS_SHADER_PREPROCESS_H
+
+#include <string>
+
+namespace graphics {
+
+// Reads the shader at path as the compiler is given it, whether embedded by
+// shader_embed at build time or read again for a reload. Each
+// #include "file" line, file relative to the includer, is replaced by file
+// the first time and by nothing after. Comments go, as do indentation and
+// runs of spaces; newlines stay, and #line directives around an include
+// keep error messages on the lines of the file they name, each file by the
+// source string number it got in order of inclusion, path being 0. Throws
+// a std::string naming a file it cannot read or a malformed #include.
+std::string PreprocessShader(const std::string &path);
+
+};  // namespace graphics
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef GRAPHICS_SIMPLIFY_H
+#define GRAPHICS_SIMPLIFY_H
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "graphics/mesh.h"
+
+namespace graphics {
+
+// A level of detail of a MeshData: triangles indexing its vertices and
+// their error, in MeshData::error's sense.
+struct MeshLod {
+  std::vector<unsigned> index;
+  float error;
+};
+
+// Simplifies mesh by collapsing edges in order of quadric error (Garland
+// and Heckbert 1997), each vertex moving onto a neighbour, so no vertex is
+// made and every attribute stays as authored. Collapses run until at most
+// target_index_count indices are left or the next would cost more than
+// target_error. Vertices on open borders only slide along them. Vertices
+// on attribute seams, positions two vertices share with different normals
+// or texture coordinates, only slide along the seam with both sides moving
+// together, and vertices where borders or seams meet stay put. The error
+// is mesh.error plus the root of the largest quadric error collapsed, the
+// mean squared distance to the planes merged into the vertex moved.
+MeshLod SimplifyMesh(const MeshData &mesh, std::size_t target_index_count,
+                     float target_error);
+// Fills lod with mesh's own triangles followed by levels simplified from
+// them, each with at most ratio times the triangles of the one before. The
+// chain ends before a level that would exceed max_error, have fewer than
+// min_triangle_count triangles or drop less than a tenth of the previous
+// level's, so its errors rise along it as SelectLod expects.
+void BuildLodChain(const MeshData &mesh, std::vector<MeshLod> &lod,
+                   float ratio = 0.5f, std::size_t min_triangle_count = 32,
+                   float max_error = std::numeric_limits<float>::max());
+// A copy of mesh drawing lod's triangles instead of its own. It keeps all
+// of mesh's vertices; OptimizeVertexFetch drops those lod does not use.
+MeshData LodMesh(const MeshData &mesh, const MeshLod &lod);
+
+};  // namespace graphics
+
+#endif
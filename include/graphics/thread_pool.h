@@ -0,0 +1,45 @@
+#ifndef GRAPHICS_THREAD_POOL_H
+#define GRAPHICS_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace graphics {
+
+// A fixed set of worker threads running queued tasks in FIFO order.
+class ThreadPool {
+ public:
+  explicit ThreadPool(
+      unsigned thread_count = std::thread::hardware_concurrency());
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void Submit(std::function<void()> task);
+  // Blocks until every submitted task has finished, then rethrows the first
+  // exception a task threw, if any.
+  void Wait();
+
+  unsigned thread_count_;
+
+ private:
+  void Work();
+
+  std::vector<std::thread> threads_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable task_ready_;
+  std::condition_variable all_done_;
+  unsigned busy_count_;
+  bool stop_;
+  std::exception_ptr error_;
+};
+
+};  // namespace graphics
+
+#endif
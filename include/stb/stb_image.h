@@ -271,6 +271,9 @@ RECENT REVISION HISTORY:
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
 //
+// PNG unfiltering also uses SSE2 (and AVX2 for the 'up' filter when the
+// translation unit is compiled with -mavx2).
+//
 // ===========================================================================
 //
 // HDR image support   (disable by defining STBI_NO_HDR)
@@ -434,6 +437,17 @@ STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int *
 STBIDEF int stbi_convert_wchar_to_utf8(char *buffer, size_t bufferlen, const wchar_t* input);
 #endif
 
+// Decode into caller-provided memory (e.g. a mapped pixel-unpack buffer)
+// instead of a fresh allocation. Size 'out' with stbi_info first: y rows,
+// 'out_stride' bytes apart, of x pixels with 'desired_channels' (1..4) bytes
+// each. Honors stbi_set_flip_vertically_on_load. 8-bit non-interlaced PNGs
+// are unfiltered straight into 'out'; anything else is decoded as usual and
+// copied over. Returns 1 on success, 0 on failure.
+STBIDEF int stbi_load_from_memory_into(stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels, stbi_uc *out, int out_stride);
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_into            (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels, stbi_uc *out, int out_stride);
+#endif
+
 ////////////////////////////////////
 //
 // 16-bits-per-channel interface
@@ -521,6 +535,10 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// set this flag to 0 to unfilter PNG rows with the scalar code even where the
+// SIMD path applies, e.g. to compare the two; the output is the same
+STBIDEF void stbi_set_png_simd_unfilter(int flag_true_if_should_use_simd);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -640,12 +658,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned __int64 stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -721,6 +741,9 @@ typedef unsigned char validate_uint32[sizeof(stbi__uint32)==4 ? 1 : -1];
 #if !defined(STBI_NO_SIMD) && (defined(STBI__X86_TARGET) || defined(STBI__X64_TARGET))
 #define STBI_SSE2
 #include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #ifdef _MSC_VER
 
@@ -1237,6 +1260,14 @@ static void stbi__vertical_flip_slices(void *image, int w, int h, int z, int byt
 }
 #endif
 
+// copies a tightly packed 8-bit image into rows 'stride' bytes apart
+static void stbi__copy_rows(stbi_uc *out, int stride, const stbi_uc *image, int w, int h, int n)
+{
+   int j;
+   for (j=0; j < h; ++j)
+      memcpy(out + (ptrdiff_t) j * stride, image + (size_t) j * w * n, (size_t) w * n);
+}
+
 static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
@@ -4237,11 +4268,156 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+// fast path: while at least 8 input bytes and a worst-case match of output
+// remain, bits are kept in a local 64-bit buffer refilled branchlessly, so a
+// whole length/distance pair (at most 48 bits with extra bits) decodes from a
+// single refill with no end-of-input checks, consecutive literals are pulled
+// straight out of the fast table, and matches are copied in wide chunks.
+#define STBI__ZFAST_IN_SLACK   8
+#define STBI__ZFAST_OUT_SLACK  (258 + 16)
+
+stbi_inline static stbi__uint64 stbi__zload64le(const stbi_uc *p)
+{
+   return  (stbi__uint64) p[0]        | ((stbi__uint64) p[1] <<  8) |
+          ((stbi__uint64) p[2] << 16) | ((stbi__uint64) p[3] << 24) |
+          ((stbi__uint64) p[4] << 32) | ((stbi__uint64) p[5] << 40) |
+          ((stbi__uint64) p[6] << 48) | ((stbi__uint64) p[7] << 56);
+}
+
+stbi_inline static int stbi__zhuffman_decode_wide(stbi__zhuffman *z, stbi__uint64 *bits, int *num_bits)
+{
+   int b,s,k;
+   b = z->fast[*bits & STBI__ZFAST_MASK];
+   if (b) {
+      s = b >> 9;
+   } else {
+      k = stbi__bit_reverse((int) (*bits & 0xffff), 16);
+      for (s=STBI__ZFAST_BITS+1; ; ++s)
+         if (k < z->maxcode[s])
+            break;
+      if (s >= 16) return -1; // invalid code!
+      b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
+      if (b >= STBI__ZNSYMS) return -1;
+      if (z->size[b] != s) return -1;
+      b = z->value[b];
+   }
+   *bits >>= s;
+   *num_bits -= s;
+   return b & 511;
+}
+
+// returns 0 on error, 1 at end of block, 2 when the slack ran out
+static int stbi__parse_huffman_fast(stbi__zbuf *a, char **pzout)
+{
+   char *zout = *pzout;
+   const stbi_uc *in = a->zbuffer;
+   const stbi_uc *in_limit = a->zbuffer_end - STBI__ZFAST_IN_SLACK;
+   const char *out_limit = a->zout_end - STBI__ZFAST_OUT_SLACK;
+   stbi__uint64 bits = a->code_buffer;
+   int num_bits = a->num_bits;
+   int result = 2;
+
+   while (in <= in_limit && zout <= out_limit) {
+      int z,len,dist;
+      stbi_uc *p;
+
+      // refill to 56..63 bits; bytes loaded past the ones counted sit above
+      // num_bits and are simply loaded again at the same position next time
+      bits |= stbi__zload64le(in) << num_bits;
+      in += (63 - num_bits) >> 3;
+      num_bits |= 56;
+
+      z = stbi__zhuffman_decode_wide(&a->z_length, &bits, &num_bits);
+      if (z < 256) {
+         if (z < 0) { result = stbi__err("bad huffman code","Corrupt PNG"); break; }
+         *zout++ = (char) z;
+         // at least 41 bits remain, enough for two more fast-table literals
+         z = a->z_length.fast[bits & STBI__ZFAST_MASK];
+         if (z && (z & 511) < 256) {
+            bits >>= z >> 9;
+            num_bits -= z >> 9;
+            *zout++ = (char) z;
+            z = a->z_length.fast[bits & STBI__ZFAST_MASK];
+            if (z && (z & 511) < 256) {
+               bits >>= z >> 9;
+               num_bits -= z >> 9;
+               *zout++ = (char) z;
+            }
+         }
+         continue;
+      }
+      if (z == 256) {
+         result = 1;
+         break;
+      }
+      z -= 257;
+      len = stbi__zlength_base[z];
+      if (stbi__zlength_extra[z]) {
+         len += (int) (bits & ((1 << stbi__zlength_extra[z]) - 1));
+         bits >>= stbi__zlength_extra[z];
+         num_bits -= stbi__zlength_extra[z];
+      }
+      z = stbi__zhuffman_decode_wide(&a->z_distance, &bits, &num_bits);
+      if (z < 0) { result = stbi__err("bad huffman code","Corrupt PNG"); break; }
+      dist = stbi__zdist_base[z];
+      if (stbi__zdist_extra[z]) {
+         dist += (int) (bits & ((1 << stbi__zdist_extra[z]) - 1));
+         bits >>= stbi__zdist_extra[z];
+         num_bits -= stbi__zdist_extra[z];
+      }
+      if (zout - a->zout_start < dist) { result = stbi__err("bad dist","Corrupt PNG"); break; }
+      p = (stbi_uc *) (zout - dist);
+      if (dist >= 8 && len) {
+         // chunks never overlap their own source; the last one may write up
+         // to 15 bytes past the match, which the output slack covers
+         char *end = zout + len;
+#ifdef STBI_SSE2
+         if (dist >= 16) {
+            do {
+               _mm_storeu_si128((__m128i *) zout, _mm_loadu_si128((const __m128i *) p));
+               zout += 16;
+               p += 16;
+            } while (zout < end);
+         } else
+#endif
+         do {
+            memcpy(zout, p, 8);
+            zout += 8;
+            p += 8;
+         } while (zout < end);
+         zout = end;
+      } else if (dist == 1) {
+         memset(zout, *p, len);
+         zout += len;
+      } else {
+         if (len) { do *zout++ = *p++; while (--len); }
+      }
+   }
+
+   // hand whole unconsumed bytes back to the byte-wise reader
+   in -= num_bits >> 3;
+   num_bits &= 7;
+   a->zbuffer = (stbi_uc *) in;
+   a->code_buffer = (stbi__uint32) (bits & ((1u << num_bits) - 1));
+   a->num_bits = num_bits;
+   *pzout = zout;
+   return result;
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+      if (a->zbuffer_end - a->zbuffer >= STBI__ZFAST_IN_SLACK && a->zout_end - zout >= STBI__ZFAST_OUT_SLACK) {
+         z = stbi__parse_huffman_fast(a, &zout);
+         if (z == 0) return 0;
+         if (z == 1) {
+            a->zout = zout;
+            return 1;
+         }
+      }
+      z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4554,6 +4730,13 @@ typedef struct
    stbi__context *s;
    stbi_uc *idata, *expanded, *out;
    int depth;
+   // caller-owned destination for stbi_load_into; when the image can be
+   // unfiltered straight into it, out_direct is set and out points at its
+   // first row, out_pitch bytes from the next (negative when flipping)
+   stbi_uc *dest;
+   int dest_stride;
+   int out_direct;
+   int out_pitch;
 } stbi__png;
 
 
@@ -4590,6 +4773,144 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+static int stbi__png_simd_unfilter_global = 1;
+
+STBIDEF void stbi_set_png_simd_unfilter(int flag_true_if_should_use_simd)
+{
+   stbi__png_simd_unfilter_global = flag_true_if_should_use_simd;
+}
+
+#ifdef STBI_SSE2
+// SIMD unfiltering of one scanline (after its first pixel) for the case where
+// the filtered bytes map 1:1 onto the output. 'up' is a plain vector add;
+// 'sub' is a prefix sum over the pixels of a 16-byte block; 'avg' and 'paeth'
+// carry a dependency from pixel to pixel, so they work on all channels of one
+// 3- or 4-byte pixel at once. Returns 0 when the row should take the scalar path.
+stbi_inline static __m128i stbi__png_load_px(const stbi_uc *p, int bpp)
+{
+   int v = 0;
+   if (bpp == 4) memcpy(&v, p, 4); else memcpy(&v, p, 3);
+   return _mm_cvtsi32_si128(v);
+}
+
+stbi_inline static void stbi__png_store_px(stbi_uc *p, __m128i x, int bpp)
+{
+   int v = _mm_cvtsi128_si32(x);
+   if (bpp == 4) memcpy(p, &v, 4); else memcpy(p, &v, 3);
+}
+
+static void stbi__png_unfilter_up_simd(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n)
+{
+   int k = 0;
+#ifdef __AVX2__
+   for (; k + 32 <= n; k += 32) {
+      __m256i x = _mm256_loadu_si256((const __m256i *) (raw + k));
+      __m256i b = _mm256_loadu_si256((const __m256i *) (prior + k));
+      _mm256_storeu_si256((__m256i *) (cur + k), _mm256_add_epi8(x, b));
+   }
+#endif
+   for (; k + 16 <= n; k += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i *) (raw + k));
+      __m128i b = _mm_loadu_si128((const __m128i *) (prior + k));
+      _mm_storeu_si128((__m128i *) (cur + k), _mm_add_epi8(x, b));
+   }
+   for (; k < n; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+}
+
+static void stbi__png_unfilter_sub_sse2(stbi_uc *cur, const stbi_uc *raw, int n, int bpp)
+{
+   // a bpp=3 block holds 5 whole pixels; its 16th byte is rewritten by the next block
+   int step = bpp == 3 ? 15 : 16;
+   int k = 0;
+   for (; k + 16 <= n; k += step) {
+      int left = 0;
+      __m128i x;
+      memcpy(&left, cur + k - bpp, bpp);
+      // seeding slot 0 with the left pixel lets the prefix sum carry it across the block
+      x = _mm_add_epi8(_mm_loadu_si128((const __m128i *) (raw + k)), _mm_cvtsi32_si128(left));
+      switch (bpp) {
+         case 1: x = _mm_add_epi8(x, _mm_slli_si128(x, 1)); // fallthrough
+         case 2: x = _mm_add_epi8(x, _mm_slli_si128(x, 2)); // fallthrough
+         case 4: x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+                 x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+                 break;
+         case 3: x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+                 x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+                 x = _mm_add_epi8(x, _mm_slli_si128(x, 12));
+                 break;
+      }
+      _mm_storeu_si128((__m128i *) (cur + k), x);
+   }
+   for (; k < n; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + cur[k-bpp]);
+}
+
+static void stbi__png_unfilter_avg_sse2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n, int bpp)
+{
+   __m128i a = stbi__png_load_px(cur - bpp, bpp);
+   int k;
+   for (k=0; k < n; k += bpp) {
+      __m128i b = stbi__png_load_px(prior + k, bpp);
+      // pavgb rounds up; take the odd bit back off to get (a+b)>>1
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+      a = _mm_add_epi8(stbi__png_load_px(raw + k, bpp), avg);
+      stbi__png_store_px(cur + k, a, bpp);
+   }
+}
+
+static void stbi__png_unfilter_paeth_sse2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n, int bpp)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i a = _mm_unpacklo_epi8(stbi__png_load_px(cur - bpp, bpp), zero);
+   __m128i c = _mm_unpacklo_epi8(stbi__png_load_px(prior - bpp, bpp), zero);
+   int k;
+   for (k=0; k < n; k += bpp) {
+      __m128i b = _mm_unpacklo_epi8(stbi__png_load_px(prior + k, bpp), zero);
+      __m128i pa = _mm_sub_epi16(b, c); // p-a
+      __m128i pb = _mm_sub_epi16(a, c); // p-b
+      __m128i pc = _mm_add_epi16(pa, pb); // p-c
+      __m128i smallest, pick;
+      pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+      pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+      pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+      smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      // ties go to a, then b, then c, as in stbi__paeth
+      pick = _mm_cmpeq_epi16(smallest, pb);
+      pick = _mm_or_si128(_mm_and_si128(pick, b), _mm_andnot_si128(pick, c));
+      smallest = _mm_cmpeq_epi16(smallest, pa);
+      pick = _mm_or_si128(_mm_and_si128(smallest, a), _mm_andnot_si128(smallest, pick));
+      c = b;
+      a = _mm_add_epi8(stbi__png_load_px(raw + k, bpp), _mm_packus_epi16(pick, zero));
+      stbi__png_store_px(cur + k, a, bpp);
+      a = _mm_unpacklo_epi8(a, zero);
+   }
+}
+
+static int stbi__png_unfilter_row_simd(int filter, stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n, int bpp)
+{
+   switch (filter) {
+      case STBI__F_up:
+         stbi__png_unfilter_up_simd(cur, raw, prior, n);
+         return 1;
+      case STBI__F_sub:
+      case STBI__F_paeth_first: // paeth(a,0,0) is always a
+         if (bpp > 4) return 0;
+         stbi__png_unfilter_sub_sse2(cur, raw, n, bpp);
+         return 1;
+      case STBI__F_avg:
+         if (bpp != 3 && bpp != 4) return 0;
+         stbi__png_unfilter_avg_sse2(cur, raw, prior, n, bpp);
+         return 1;
+      case STBI__F_paeth:
+         if (bpp != 3 && bpp != 4) return 0;
+         stbi__png_unfilter_paeth_sse2(cur, raw, prior, n, bpp);
+         return 1;
+   }
+   return 0;
+}
+#endif
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4603,10 +4924,15 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int output_bytes = out_n*bytes;
    int filter_bytes = img_n*bytes;
    int width = x;
+   int row_pitch = (int) stride;
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
-   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
-   if (!a->out) return stbi__err("outofmem", "Out of memory");
+   if (a->out_direct) {
+      row_pitch = a->out_pitch;
+   } else {
+      a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
+      if (!a->out) return stbi__err("outofmem", "Out of memory");
+   }
 
    if (!stbi__mad3sizes_valid(img_n, x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
    img_width_bytes = (((img_n * x * depth) + 7) >> 3);
@@ -4618,7 +4944,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    if (raw_len < img_len) return stbi__err("not enough pixels","Corrupt PNG");
 
    for (j=0; j < y; ++j) {
-      stbi_uc *cur = a->out + stride*j;
+      stbi_uc *cur = a->out + (ptrdiff_t) j * row_pitch;
       stbi_uc *prior;
       int filter = *raw++;
 
@@ -4631,7 +4957,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          filter_bytes = 1;
          width = img_width_bytes;
       }
-      prior = cur - stride; // bugfix: need to compute this after 'cur +=' computation above
+      prior = cur - row_pitch; // bugfix: need to compute this after 'cur +=' computation above
 
       // if first row, use special filter that doesn't sample previous row
       if (j == 0) filter = first_row_filter[filter];
@@ -4675,6 +5001,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          #define STBI__CASE(f) \
              case f:     \
                 for (k=0; k < nk; ++k)
+#ifdef STBI_SSE2
+         if (!stbi__png_simd_unfilter_global || !stbi__png_unfilter_row_simd(filter, cur, raw, prior, nk, filter_bytes))
+#endif
          switch (filter) {
             // "none" filter turns into a memcpy here; make that explicit.
             case STBI__F_none:         memcpy(cur, raw, nk); break;
@@ -4707,7 +5036,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          // the loop above sets the high byte of the pixels' alpha, but for
          // 16 bit png files we also need the low byte set. we'll do that here.
          if (depth == 16) {
-            cur = a->out + stride*j; // start at the beginning of the row again
+            cur = a->out + (ptrdiff_t) j * row_pitch; // start at the beginning of the row again
             for (i=0; i < x; ++i,cur+=output_bytes) {
                cur[filter_bytes+1] = 255;
             }
@@ -4720,8 +5049,8 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    // intefere with filtering but will still be in the cache.
    if (depth < 8) {
       for (j=0; j < y; ++j) {
-         stbi_uc *cur = a->out + stride*j;
-         stbi_uc *in  = a->out + stride*j + x*out_n - img_width_bytes;
+         stbi_uc *cur = a->out + (ptrdiff_t) j * row_pitch;
+         stbi_uc *in  = a->out + (ptrdiff_t) j * row_pitch + x*out_n - img_width_bytes;
          // unpack 1/2/4-bit into a 8-bit buffer. allows us to keep the common 8-bit path optimal at minimal cost for 1/2/4-bit
          // png guarante byte alignment, if width is not multiple of 8/4/2 we'll decode dummy trailing data that will be skipped in the later loop
          stbi_uc scale = (color == 0) ? stbi__depth_scale_table[depth] : 1; // scale grayscale values to 0..255 range
@@ -4770,7 +5099,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          if (img_n != out_n) {
             int q;
             // insert alpha = 255
-            cur = a->out + stride*j;
+            cur = a->out + (ptrdiff_t) j * row_pitch;
             if (img_n == 1) {
                for (q=x-1; q >= 0; --q) {
                   cur[q*2+1] = 255;
@@ -5032,6 +5361,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
    z->expanded = NULL;
    z->idata = NULL;
    z->out = NULL;
+   z->out_direct = 0;
 
    if (!stbi__check_png_header(s)) return 0;
 
@@ -5147,6 +5477,16 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                s->img_out_n = s->img_n+1;
             else
                s->img_out_n = s->img_n;
+            if (z->dest && z->depth == 8 && !interlace && !has_trans && !pal_img_n && !is_iphone && s->img_out_n == req_comp) {
+               if (z->dest_stride < (int) s->img_x * req_comp) return stbi__err("bad stride", "Destination rows too short");
+               z->out_direct = 1;
+               z->out_pitch = z->dest_stride;
+               z->out = z->dest;
+               if (stbi__vertically_flip_on_load) {
+                  z->out += (ptrdiff_t) (s->img_y - 1) * z->dest_stride;
+                  z->out_pitch = -z->dest_stride;
+               }
+            }
             if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
             if (has_trans) {
                if (z->depth == 16) {
@@ -5232,6 +5572,7 @@ static void *stbi__png_load(stbi__context *s, int *x, int *y, int *comp, int req
 {
    stbi__png p;
    p.s = s;
+   p.dest = NULL;
    return stbi__do_png(&p, x,y,comp,req_comp, ri);
 }
 
@@ -5259,6 +5600,7 @@ static int stbi__png_info(stbi__context *s, int *x, int *y, int *comp)
 {
    stbi__png p;
    p.s = s;
+   p.dest = NULL;
    return stbi__png_info_raw(&p, x, y, comp);
 }
 
@@ -5266,6 +5608,7 @@ static int stbi__png_is16(stbi__context *s)
 {
    stbi__png p;
    p.s = s;
+   p.dest = NULL;
    if (!stbi__png_info_raw(&p, NULL, NULL, NULL))
 	   return 0;
    if (p.depth != 16) {
@@ -5274,6 +5617,91 @@ static int stbi__png_is16(stbi__context *s)
    }
    return 1;
 }
+
+static int stbi__png_load_into(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi_uc *out, int out_stride)
+{
+   stbi__png p;
+   int ok;
+   p.s = s;
+   p.dest = out;
+   p.dest_stride = out_stride;
+   ok = stbi__parse_png_file(&p, STBI__SCAN_load, req_comp);
+   if (p.out_direct) {
+      p.out = NULL; // never free the caller's memory
+   } else if (ok) {
+      // not decodable in place (palette, tRNS, interlaced, 16-bit, ...)
+      int w = s->img_x, h = s->img_y;
+      stbi_uc *image = p.out;
+      p.out = NULL;
+      if (p.depth == 16) {
+         // convert channels at full precision first, as stbi_load does
+         if (req_comp != s->img_out_n)
+            image = (stbi_uc *) stbi__convert_format16((stbi__uint16 *) image, s->img_out_n, req_comp, w, h);
+         if (image)
+            image = stbi__convert_16_to_8((stbi__uint16 *) image, w, h, req_comp);
+      } else if (req_comp != s->img_out_n) {
+         image = stbi__convert_format(image, s->img_out_n, req_comp, w, h);
+      }
+      if (!image) {
+         ok = 0;
+      } else if (out_stride < w * req_comp) {
+         ok = stbi__err("bad stride", "Destination rows too short");
+      } else {
+         if (stbi__vertically_flip_on_load)
+            stbi__vertical_flip(image, w, h, req_comp);
+         stbi__copy_rows(out, out_stride, image, w, h, req_comp);
+      }
+      STBI_FREE(image);
+   }
+   if (ok) {
+      *x = s->img_x;
+      *y = s->img_y;
+      if (comp) *comp = s->img_n;
+   }
+   STBI_FREE(p.out);      p.out      = NULL;
+   STBI_FREE(p.expanded); p.expanded = NULL;
+   STBI_FREE(p.idata);    p.idata    = NULL;
+   return ok;
+}
+#endif
+
+static int stbi__load_into(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi_uc *out, int out_stride)
+{
+   stbi_uc *image;
+   if (req_comp < 1 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+   #ifndef STBI_NO_PNG
+   if (stbi__png_test(s)) return stbi__png_load_into(s, x, y, comp, req_comp, out, out_stride);
+   #endif
+   image = stbi__load_and_postprocess_8bit(s, x, y, comp, req_comp);
+   if (!image) return 0;
+   if (out_stride < *x * req_comp) {
+      STBI_FREE(image);
+      return stbi__err("bad stride", "Destination rows too short");
+   }
+   stbi__copy_rows(out, out_stride, image, *x, *y, req_comp);
+   STBI_FREE(image);
+   return 1;
+}
+
+STBIDEF int stbi_load_from_memory_into(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, stbi_uc *out, int out_stride)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_into(&s,x,y,comp,req_comp,out,out_stride);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_into(char const *filename, int *x, int *y, int *comp, int req_comp, stbi_uc *out, int out_stride)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   stbi__context s;
+   int result;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   result = stbi__load_into(&s,x,y,comp,req_comp,out,out_stride);
+   fclose(f);
+   return result;
+}
 #endif
 
 // Microsoft/Windows BMP image
@@ -0,0 +1,388 @@
+#include "graphics/asset_io.h"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "graphics/lz.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define GRAPHICS_IO_URING
+#endif
+#endif
+
+#ifdef GRAPHICS_IO_URING
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace graphics {
+
+#ifdef GRAPHICS_IO_URING
+// Just enough of io_uring for batched reads, on the raw syscalls so there is
+// no liburing dependency.
+class IoUring {
+ public:
+  explicit IoUring(unsigned entry_count)
+      : ring_fd_{-1},
+        sq_ring_{MAP_FAILED},
+        cq_ring_{MAP_FAILED},
+        sqes_{MAP_FAILED},
+        in_flight_{0} {
+    std::memset(&params_, 0, sizeof(params_));
+    ring_fd_ = static_cast<int>(
+        syscall(__NR_io_uring_setup, entry_count, &params_));
+    if (ring_fd_ < 0) {
+      return;
+    }
+    sq_ring_size_ =
+        params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params_.cq_off.cqes + params_.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap{(params_.features & IORING_FEAT_SINGLE_MMAP) != 0};
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    cq_ring_ = single_mmap
+                   ? sq_ring_
+                   : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_,
+                          IORING_OFF_CQ_RING);
+    sqes_ = mmap(nullptr, params_.sq_entries * sizeof(io_uring_sqe),
+                 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                 IORING_OFF_SQES);
+    if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED ||
+        sqes_ == MAP_FAILED) {
+      Close();
+    }
+  }
+
+  ~IoUring() { Close(); }
+
+  bool Valid() const { return ring_fd_ >= 0; }
+  unsigned Capacity() const { return params_.sq_entries; }
+  unsigned InFlight() const { return in_flight_; }
+
+  void PrepareRead(int fd, void *buffer, unsigned size, std::uint64_t offset,
+                   std::uint64_t user_data) {
+    char *sq{static_cast<char *>(sq_ring_)};
+    unsigned *tail{reinterpret_cast<unsigned *>(sq + params_.sq_off.tail)};
+    unsigned mask{
+        *reinterpret_cast<unsigned *>(sq + params_.sq_off.ring_mask)};
+    unsigned *array{reinterpret_cast<unsigned *>(sq + params_.sq_off.array)};
+    unsigned index{*tail & mask};
+    io_uring_sqe &sqe{static_cast<io_uring_sqe *>(sqes_)[index]};
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(buffer);
+    sqe.len = size;
+    sqe.off = offset;
+    sqe.user_data = user_data;
+    array[index] = index;
+    __atomic_store_n(tail, *tail + 1, __ATOMIC_RELEASE);
+    ++to_submit_;
+    ++in_flight_;
+  }
+
+  // Submits everything prepared and waits for at least one completion.
+  bool SubmitAndWait() {
+    int result;
+    do {
+      result = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_,
+                                        to_submit_, 1u,
+                                        IORING_ENTER_GETEVENTS, nullptr, 0));
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+      return false;
+    }
+    to_submit_ -= static_cast<unsigned>(result) < to_submit_
+                      ? static_cast<unsigned>(result)
+                      : to_submit_;
+    return true;
+  }
+
+  bool Reap(io_uring_cqe &cqe) {
+    char *cq{static_cast<char *>(cq_ring_)};
+    unsigned *head{reinterpret_cast<unsigned *>(cq + params_.cq_off.head)};
+    unsigned *tail{reinterpret_cast<unsigned *>(cq + params_.cq_off.tail)};
+    unsigned mask{
+        *reinterpret_cast<unsigned *>(cq + params_.cq_off.ring_mask)};
+    if (*head == __atomic_load_n(tail, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+    cqe = reinterpret_cast<io_uring_cqe *>(cq +
+                                           params_.cq_off.cqes)[*head & mask];
+    __atomic_store_n(head, *head + 1, __ATOMIC_RELEASE);
+    --in_flight_;
+    return true;
+  }
+
+ private:
+  void Close() {
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, params_.sq_entries * sizeof(io_uring_sqe));
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != MAP_FAILED) {
+      munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+      close(ring_fd_);
+    }
+    sq_ring_ = cq_ring_ = sqes_ = MAP_FAILED;
+    ring_fd_ = -1;
+  }
+
+  io_uring_params params_;
+  int ring_fd_;
+  void *sq_ring_;
+  void *cq_ring_;
+  void *sqes_;
+  std::size_t sq_ring_size_;
+  std::size_t cq_ring_size_;
+  unsigned to_submit_{0};
+  unsigned in_flight_;
+};
+
+// Reads paths[index[k]] for every k; user_data carries k.
+static bool ReadAssetsIoUring(const std::vector<std::string> &paths,
+                              const std::vector<std::size_t> &index,
+                              ThreadPool &pool,
+                              const std::shared_ptr<AssetCallback> &on_read) {
+  IoUring ring{static_cast<unsigned>(std::min<std::size_t>(
+      std::max<std::size_t>(index.size(), 1), 256))};
+  if (!ring.Valid()) {
+    return false;
+  }
+
+  struct File {
+    int fd;
+    std::size_t size;
+    std::size_t done;
+    std::shared_ptr<std::vector<unsigned char>> data;
+  };
+  // files waiting for a submission slot, including short-read remainders
+  std::vector<std::size_t> queue;
+  std::vector<File> files(index.size());
+  for (std::size_t i = index.size(); i-- > 0;) {
+    files[i].fd = open(paths[index[i]].c_str(), O_RDONLY | O_CLOEXEC);
+    files[i].size = 0;
+    files[i].done = 0;
+    struct stat status;
+    if (files[i].fd >= 0 && fstat(files[i].fd, &status) == 0) {
+      files[i].size = static_cast<std::size_t>(status.st_size);
+      queue.push_back(i);
+      continue;
+    }
+    if (files[i].fd >= 0) {
+      close(files[i].fd);
+      files[i].fd = -1;
+    }
+    std::size_t path_index{index[i]};
+    pool.Submit([on_read, path_index] { (*on_read)(path_index, nullptr, 0); });
+  }
+
+  // Buffers are allocated when their first read is issued, and at most
+  // kMaxBufferedBytes of them are being read into at once. A buffer leaves
+  // the count when its file is handed to pool, so this bounds the reads in
+  // flight, not what waits in pool's queue. Waiting on callbacks to free
+  // theirs instead could deadlock a caller whose callbacks wait on it.
+  const std::size_t kMaxBufferedBytes{4u << 20};
+  std::size_t buffered_bytes{0};
+  auto finish = [&](std::size_t i, bool read) {
+    close(files[i].fd);
+    files[i].fd = -1;
+    std::shared_ptr<std::vector<unsigned char>> data{files[i].data};
+    files[i].data.reset();
+    buffered_bytes -= files[i].size;
+    std::size_t path_index{index[i]};
+    pool.Submit([on_read, path_index, data, read] {
+      (*on_read)(path_index, read ? data->data() : nullptr,
+                 read ? data->size() : 0);
+    });
+  };
+  const std::size_t kMaxRead{1u << 30};
+  while (!queue.empty() || ring.InFlight() > 0) {
+    while (!queue.empty() && ring.InFlight() < ring.Capacity()) {
+      std::size_t i{queue.back()};
+      File &file{files[i]};
+      if (!file.data) {
+        if (buffered_bytes > 0 &&
+            buffered_bytes + file.size > kMaxBufferedBytes) {
+          break;
+        }
+        file.data = std::make_shared<std::vector<unsigned char>>(file.size);
+        buffered_bytes += file.size;
+        if (file.size == 0) {
+          queue.pop_back();
+          finish(i, true);
+          continue;
+        }
+      }
+      queue.pop_back();
+      std::size_t size{std::min(file.size - file.done, kMaxRead)};
+      ring.PrepareRead(file.fd, file.data->data() + file.done,
+                       static_cast<unsigned>(size), file.done, i);
+    }
+    if (ring.InFlight() == 0) {
+      continue;
+    }
+    if (!ring.SubmitAndWait()) {
+      for (File &file : files) {
+        if (file.fd >= 0) {
+          close(file.fd);
+        }
+      }
+      throw std::string{"io_uring_enter failed"};
+    }
+    io_uring_cqe cqe;
+    while (ring.Reap(cqe)) {
+      std::size_t i{static_cast<std::size_t>(cqe.user_data)};
+      File &file{files[i]};
+      if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+        // kernels before 5.6 lack IORING_OP_READ; finish this one by hand
+        ssize_t count{1};
+        while (file.done < file.size && count > 0) {
+          count = pread(file.fd, file.data->data() + file.done,
+                        file.size - file.done, static_cast<off_t>(file.done));
+          if (count > 0) {
+            file.done += static_cast<std::size_t>(count);
+          }
+        }
+        if (count <= 0) {
+          finish(i, false);
+          continue;
+        }
+      } else if (cqe.res <= 0) {
+        finish(i, false);
+        continue;
+      } else {
+        file.done += static_cast<std::size_t>(cqe.res);
+      }
+      if (file.done == file.size) {
+        finish(i, true);
+      } else {
+        queue.push_back(i);
+      }
+    }
+  }
+  return true;
+}
+#endif
+
+// Spreads the blocks of a compressed pack entry over pool; whichever task
+// finishes the last block hands the asset on.
+static void DecompressAsset(std::size_t index, const unsigned char *data,
+                            std::size_t size, std::size_t raw_size,
+                            ThreadPool &pool,
+                            const std::shared_ptr<AssetCallback> &on_read) {
+  std::size_t stream_raw_size, block_count;
+  if (!LzStreamInfo(data, size, stream_raw_size, block_count) ||
+      stream_raw_size != raw_size) {
+    pool.Submit([on_read, index] { (*on_read)(index, nullptr, 0); });
+    return;
+  }
+  if (block_count == 0) {
+    pool.Submit([on_read, index] {
+      unsigned char empty;
+      (*on_read)(index, &empty, 0);
+    });
+    return;
+  }
+  struct Asset {
+    std::vector<unsigned char> data;
+    std::atomic<std::size_t> remaining;
+    std::atomic<bool> failed;
+  };
+  std::shared_ptr<Asset> asset{std::make_shared<Asset>()};
+  asset->data.resize(raw_size);
+  asset->remaining = block_count;
+  asset->failed = false;
+  for (std::size_t b = 0; b < block_count; ++b) {
+    pool.Submit([on_read, index, data, b, asset] {
+      if (!LzDecompressBlock(data, b, asset->data.data())) {
+        asset->failed = true;
+      }
+      if (--asset->remaining == 0) {
+        if (asset->failed) {
+          (*on_read)(index, nullptr, 0);
+        } else {
+          (*on_read)(index, asset->data.data(), asset->data.size());
+        }
+      }
+    });
+  }
+}
+
+AssetReadStats ReadAssets(const std::vector<std::string> &paths,
+                          ThreadPool &pool, AssetCallback on_read,
+                          Pack *pack) {
+  AssetReadStats stats{paths.size(), 0, false};
+  std::shared_ptr<AssetCallback> callback{
+      std::make_shared<AssetCallback>(std::move(on_read))};
+  std::vector<std::size_t> loose;
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    const PackEntry *entry{pack ? pack->Find(paths[i]) : nullptr};
+    if (!entry) {
+      loose.push_back(i);
+      continue;
+    }
+    ++stats.pack_count;
+    const unsigned char *data{pack->Data(*entry)};
+    std::size_t size{static_cast<std::size_t>(entry->size)};
+    if (!(entry->flags & kPackCompressed)) {
+      pool.Submit([callback, i, data, size] { (*callback)(i, data, size); });
+      continue;
+    }
+    DecompressAsset(i, data, size, static_cast<std::size_t>(entry->raw_size),
+                    pool, callback);
+  }
+  if (loose.empty()) {
+    return stats;
+  }
+#ifdef GRAPHICS_IO_URING
+  if (ReadAssetsIoUring(paths, loose, pool, callback)) {
+    stats.io_uring = true;
+    return stats;
+  }
+#endif
+  for (std::size_t i : loose) {
+    std::string path{paths[i]};
+    pool.Submit([callback, i, path] {
+      std::ifstream file{path, std::ios::binary | std::ios::ate};
+      if (!file) {
+        (*callback)(i, nullptr, 0);
+        return;
+      }
+      std::vector<unsigned char> data(static_cast<std::size_t>(file.tellg()));
+      file.seekg(0);
+      file.read(reinterpret_cast<char *>(data.data()), data.size());
+      if (!file) {
+        (*callback)(i, nullptr, 0);
+        return;
+      }
+      (*callback)(i, data.data(), data.size());
+    });
+  }
+  return stats;
+}
+
+};  // namespace graphics
@@ -1,8 +1,14 @@
 #version 330 core
 layout(location = 0) in vec3 object_position;
 
-uniform mat4 projection;
-uniform mat4 view;
+// the Frame block of pbr.vs
+layout (std140) uniform Frame {
+  mat4 view;
+  mat4 projection;
+  vec3 camera_position;
+  vec4 light_position[4];
+  vec4 light_color[4];
+};
 
 out vec3 world_position;
 
@@ -0,0 +1,386 @@
+#include "graphics/cull.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace graphics {
+
+Aabb MeshBounds(const MeshData &mesh) {
+  if (mesh.vertex.empty()) {
+    return Aabb{glm::vec3{0.0f}, glm::vec3{0.0f}};
+  }
+  Aabb box{mesh.vertex[0].position, mesh.vertex[0].position};
+  for (const Vertex &vertex : mesh.vertex) {
+    box.min = glm::min(box.min, vertex.position);
+    box.max = glm::max(box.max, vertex.position);
+  }
+  return box;
+}
+
+Aabb TransformAabb(const Aabb &box, const glm::mat4 &matrix) {
+  // Arvo's method on the center and half extent
+  glm::vec3 center{0.5f * (box.min + box.max)};
+  glm::vec3 extent{0.5f * (box.max - box.min)};
+  glm::vec3 new_center{matrix[3]};
+  glm::vec3 new_extent{0.0f};
+  for (int c = 0; c < 3; ++c) {
+    for (int r = 0; r < 3; ++r) {
+      new_center[r] += matrix[c][r] * center[c];
+      new_extent[r] += std::abs(matrix[c][r]) * extent[c];
+    }
+  }
+  return Aabb{new_center - new_extent, new_center + new_extent};
+}
+
+Frustum ExtractFrustum(const glm::mat4 &view_projection) {
+  // each plane is the last row of the matrix plus or minus one of the
+  // others; glm indexes columns first
+  glm::vec4 row[4];
+  for (int r = 0; r < 4; ++r) {
+    row[r] = glm::vec4{view_projection[0][r], view_projection[1][r],
+                       view_projection[2][r], view_projection[3][r]};
+  }
+  Frustum frustum;
+  for (int i = 0; i < 3; ++i) {
+    frustum.plane[2 * i] = row[3] + row[i];
+    frustum.plane[2 * i + 1] = row[3] - row[i];
+  }
+  for (glm::vec4 &plane : frustum.plane) {
+    float length{glm::length(glm::vec3{plane})};
+    if (length > 0.0f) {
+      plane /= length;
+    }
+  }
+  return frustum;
+}
+
+bool Intersects(const Frustum &frustum, const Aabb &box) {
+  glm::vec3 center{0.5f * (box.min + box.max)};
+  glm::vec3 extent{0.5f * (box.max - box.min)};
+  for (const glm::vec4 &plane : frustum.plane) {
+    glm::vec3 normal{plane};
+    float distance{glm::dot(normal, center) + plane.w};
+    float radius{glm::dot(glm::abs(normal), extent)};
+    if (distance + radius < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BoxSet::BoxSet() { Clear(); }
+
+void BoxSet::Clear() {
+  size_ = 0;
+  for (int a = 0; a < 3; ++a) {
+    center_[a].assign(kCullWidth, 0.0f);
+    extent_[a].assign(kCullWidth, 0.0f);
+  }
+}
+
+void BoxSet::Add(const Aabb &box) {
+  for (int a = 0; a < 3; ++a) {
+    // the new box takes the first padding slot and one more is added
+    center_[a].push_back(0.0f);
+    extent_[a].push_back(0.0f);
+    center_[a][size_] = 0.5f * (box.min[a] + box.max[a]);
+    extent_[a][size_] = 0.5f * (box.max[a] - box.min[a]);
+  }
+  ++size_;
+}
+
+// A frustum arranged for the wide tests: each plane's normal, its absolute
+// value and its distance term.
+struct CullPlanes {
+  float normal[6][3];
+  float abs_normal[6][3];
+  float w[6];
+};
+
+static CullPlanes PreparePlanes(const Frustum &frustum) {
+  CullPlanes planes;
+  for (int p = 0; p < 6; ++p) {
+    for (int a = 0; a < 3; ++a) {
+      planes.normal[p][a] = frustum.plane[p][a];
+      planes.abs_normal[p][a] = std::abs(frustum.plane[p][a]);
+    }
+    planes.w[p] = frustum.plane[p].w;
+  }
+  return planes;
+}
+
+// The per-axis arrays of centers and half extents of some boxes.
+struct BoxArrays {
+  const float *center[3];
+  const float *extent[3];
+};
+
+// Tests the W boxes from first on. Bit i of visible is set unless box
+// first + i lies outside one of the planes, as Intersects tests, and bit
+// i of inside if it also lies inside all of them.
+template <unsigned W>
+static void TestBoxes(const CullPlanes &planes, const BoxArrays &box,
+                      std::size_t first, unsigned &visible,
+                      unsigned &inside) {
+  unsigned outside{0};
+  unsigned partial{0};
+  for (unsigned i = 0; i < W; ++i) {
+    for (int p = 0; p < 6; ++p) {
+      float distance{planes.w[p]};
+      float radius{0.0f};
+      for (int a = 0; a < 3; ++a) {
+        distance += planes.normal[p][a] * box.center[a][first + i];
+        radius += planes.abs_normal[p][a] * box.extent[a][first + i];
+      }
+      if (distance + radius < 0.0f) {
+        outside |= 1u << i;
+      }
+      if (distance - radius < 0.0f) {
+        partial |= 1u << i;
+      }
+    }
+  }
+  visible = ~outside & ((1u << W) - 1);
+  inside = visible & ~partial;
+}
+
+#if defined(__SSE__)
+template <>
+void TestBoxes<4>(const CullPlanes &planes, const BoxArrays &box,
+                  std::size_t first, unsigned &visible, unsigned &inside) {
+  __m128 zero{_mm_setzero_ps()};
+  __m128 center[3];
+  __m128 extent[3];
+  for (int a = 0; a < 3; ++a) {
+    center[a] = _mm_loadu_ps(box.center[a] + first);
+    extent[a] = _mm_loadu_ps(box.extent[a] + first);
+  }
+  __m128 outside{zero};
+  __m128 partial{zero};
+  for (int p = 0; p < 6; ++p) {
+    __m128 distance{_mm_set1_ps(planes.w[p])};
+    __m128 radius{zero};
+    for (int a = 0; a < 3; ++a) {
+      distance = _mm_add_ps(
+          distance, _mm_mul_ps(_mm_set1_ps(planes.normal[p][a]), center[a]));
+      radius = _mm_add_ps(
+          radius, _mm_mul_ps(_mm_set1_ps(planes.abs_normal[p][a]), extent[a]));
+    }
+    outside =
+        _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+    partial =
+        _mm_or_ps(partial, _mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+  }
+  visible = ~_mm_movemask_ps(outside) & 0xfu;
+  inside = visible & ~_mm_movemask_ps(partial);
+}
+#endif
+
+#if defined(__AVX__)
+template <>
+void TestBoxes<8>(const CullPlanes &planes, const BoxArrays &box,
+                  std::size_t first, unsigned &visible, unsigned &inside) {
+  __m256 zero{_mm256_setzero_ps()};
+  __m256 center[3];
+  __m256 extent[3];
+  for (int a = 0; a < 3; ++a) {
+    center[a] = _mm256_loadu_ps(box.center[a] + first);
+    extent[a] = _mm256_loadu_ps(box.extent[a] + first);
+  }
+  __m256 outside{zero};
+  __m256 partial{zero};
+  for (int p = 0; p < 6; ++p) {
+    __m256 distance{_mm256_set1_ps(planes.w[p])};
+    __m256 radius{zero};
+    for (int a = 0; a < 3; ++a) {
+      distance = _mm256_add_ps(
+          distance,
+          _mm256_mul_ps(_mm256_set1_ps(planes.normal[p][a]), center[a]));
+      radius = _mm256_add_ps(
+          radius,
+          _mm256_mul_ps(_mm256_set1_ps(planes.abs_normal[p][a]), extent[a]));
+    }
+    outside = _mm256_or_ps(
+        outside,
+        _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+    partial = _mm256_or_ps(
+        partial,
+        _mm256_cmp_ps(_mm256_sub_ps(distance, radius), zero, _CMP_LT_OQ));
+  }
+  visible = ~_mm256_movemask_ps(outside) & 0xffu;
+  inside = visible & ~_mm256_movemask_ps(partial);
+}
+#endif
+
+// Tests boxes first to first + count - 1 kCullWidth at a time and appends
+// the visible ones' entries in index, or their positions if index is null.
+// Reads up to kCullWidth - 1 boxes past the range.
+static void CullRange(const CullPlanes &planes, const BoxArrays &box,
+                      std::size_t first, std::size_t count,
+                      const unsigned *index, std::vector<unsigned> &visible) {
+  for (std::size_t batch = first; batch < first + count;
+       batch += kCullWidth) {
+    unsigned mask;
+    unsigned inside;
+    TestBoxes<kCullWidth>(planes, box, batch, mask, inside);
+    std::size_t left{first + count - batch};
+    if (left < kCullWidth) {
+      mask &= (1u << left) - 1;
+    }
+    for (unsigned i = 0; mask != 0; ++i, mask >>= 1) {
+      if (mask & 1) {
+        std::size_t at{batch + i};
+        visible.push_back(index ? index[at] : static_cast<unsigned>(at));
+      }
+    }
+  }
+}
+
+static BoxArrays Arrays(const BoxSet &set) {
+  BoxArrays box;
+  for (int a = 0; a < 3; ++a) {
+    box.center[a] = set.center_[a].data();
+    box.extent[a] = set.extent_[a].data();
+  }
+  return box;
+}
+
+void CullBoxes(const Frustum &frustum, const BoxSet &set,
+               std::vector<unsigned> &visible) {
+  CullRange(PreparePlanes(frustum), Arrays(set), 0, set.size_, nullptr,
+            visible);
+}
+
+void Bvh::Build(const std::vector<Aabb> &box) {
+  // the objects are partitioned with their boxes rather than through
+  // indices, so the build walks memory in order
+  std::vector<Item> item(box.size());
+  for (std::size_t i = 0; i < box.size(); ++i) {
+    item[i].box = box[i];
+    item[i].center = box[i].min + box[i].max;
+    item[i].object = static_cast<unsigned>(i);
+  }
+  node_.clear();
+  if (!item.empty()) {
+    node_.reserve(item.size() / kBvhLeafSize + 1);
+    BuildNode(0, static_cast<std::uint32_t>(item.size()), item);
+  }
+  object_.resize(item.size());
+  leaf_box_.Clear();
+  for (std::size_t i = 0; i < item.size(); ++i) {
+    object_[i] = item[i].object;
+    leaf_box_.Add(item[i].box);
+  }
+}
+
+std::int32_t Bvh::BuildNode(std::uint32_t first, std::uint32_t count,
+                            std::vector<Item> &item) {
+  // splits item first to first + count - 1 in half at the median along
+  // the longest axis of the centers, returning the size of the first half
+  auto split = [&](std::uint32_t first, std::uint32_t count) {
+    if (count < 2) {
+      return count;
+    }
+    glm::vec3 low{item[first].center};
+    glm::vec3 high{low};
+    for (std::uint32_t i = first; i < first + count; ++i) {
+      low = glm::min(low, item[i].center);
+      high = glm::max(high, item[i].center);
+    }
+    glm::vec3 size{high - low};
+    int axis{size.x >= size.y && size.x >= size.z ? 0
+                                                  : size.y >= size.z ? 1 : 2};
+    std::uint32_t half{count / 2};
+    std::nth_element(item.begin() + first, item.begin() + first + half,
+                     item.begin() + first + count,
+                     [axis](const Item &a, const Item &b) {
+                       return a.center[axis] < b.center[axis];
+                     });
+    return half;
+  };
+
+  std::int32_t index{static_cast<std::int32_t>(node_.size())};
+  node_.push_back(Node{});
+  std::uint32_t half{split(first, count)};
+  std::uint32_t part_first[4];
+  std::uint32_t part_count[4];
+  part_first[0] = first;
+  part_count[0] = split(first, half);
+  part_first[1] = first + part_count[0];
+  part_count[1] = half - part_count[0];
+  part_first[2] = first + half;
+  part_count[2] = split(first + half, count - half);
+  part_first[3] = part_first[2] + part_count[2];
+  part_count[3] = count - half - part_count[2];
+
+  for (int c = 0; c < 4; ++c) {
+    Aabb bounds{glm::vec3{0.0f}, glm::vec3{0.0f}};
+    if (part_count[c] > 0) {
+      bounds = item[part_first[c]].box;
+      for (std::uint32_t i = part_first[c]; i < part_first[c] + part_count[c];
+           ++i) {
+        bounds.min = glm::min(bounds.min, item[i].box.min);
+        bounds.max = glm::max(bounds.max, item[i].box.max);
+      }
+    }
+    std::int32_t child{-1};
+    if (part_count[c] > kBvhLeafSize) {
+      child = BuildNode(part_first[c], part_count[c], item);
+    }
+    // the recursion may have moved the nodes
+    Node &node{node_[index]};
+    for (int a = 0; a < 3; ++a) {
+      node.center[a][c] = 0.5f * (bounds.min[a] + bounds.max[a]);
+      node.extent[a][c] = 0.5f * (bounds.max[a] - bounds.min[a]);
+    }
+    node.child[c] = child;
+    node.first[c] = part_first[c];
+    node.count[c] = part_count[c];
+  }
+  return index;
+}
+
+void Bvh::Cull(const Frustum &frustum, std::vector<unsigned> &visible) const {
+  if (node_.empty()) {
+    return;
+  }
+  CullPlanes planes{PreparePlanes(frustum)};
+  BoxArrays leaf_box{Arrays(leaf_box_)};
+  // the tree is balanced, so the stack grows by at most three a level
+  std::int32_t stack[128];
+  int top{0};
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node &node{node_[stack[--top]]};
+    BoxArrays child_box;
+    for (int a = 0; a < 3; ++a) {
+      child_box.center[a] = node.center[a];
+      child_box.extent[a] = node.extent[a];
+    }
+    unsigned mask;
+    unsigned inside;
+    TestBoxes<4>(planes, child_box, 0, mask, inside);
+    for (int c = 0; c < 4; ++c) {
+      if (!(mask >> c & 1) || node.count[c] == 0) {
+        continue;
+      }
+      if (inside >> c & 1) {
+        visible.insert(visible.end(), object_.begin() + node.first[c],
+                       object_.begin() + node.first[c] + node.count[c]);
+      } else if (node.child[c] >= 0) {
+        stack[top++] = node.child[c];
+      } else {
+        CullRange(planes, leaf_box, node.first[c], node.count[c],
+                  object_.data(), visible);
+      }
+    }
+  }
+}
+
+};  // namespace graphics
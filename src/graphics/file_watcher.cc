@@ -0,0 +1,100 @@
+#include "graphics/file_watcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace graphics {
+
+static long long ModifiedTime(const std::string &path) {
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0) {
+    return -1;
+  }
+  return static_cast<long long>(status.st_mtime);
+}
+
+FileWatcher::FileWatcher() : fd_{-1} {
+#ifdef __linux__
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+bool FileWatcher::Add(const std::string &path) {
+  char resolved[PATH_MAX];
+  if (!realpath(path.c_str(), resolved)) {
+    return false;
+  }
+  std::string target{resolved};
+  std::size_t slash{target.rfind('/')};
+  File file{path, target.substr(0, slash + 1), target.substr(slash + 1), -1,
+            ModifiedTime(target)};
+#ifdef __linux__
+  if (fd_ < 0) {
+    return false;
+  }
+  // the directory's, so a file replaced by a rename is still seen; adding
+  // a directory twice gives back its first watch
+  file.watch = inotify_add_watch(fd_, file.directory.c_str(),
+                                 IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (file.watch < 0) {
+    return false;
+  }
+#endif
+  file_.push_back(file);
+  return true;
+}
+
+void FileWatcher::Poll(std::vector<std::string> &changed) {
+  std::size_t first{changed.size()};
+  auto report = [&](const std::string &path) {
+    if (std::find(changed.begin() + first, changed.end(), path) ==
+        changed.end()) {
+      changed.push_back(path);
+    }
+  };
+#ifdef __linux__
+  if (fd_ < 0) {
+    return;
+  }
+  alignas(inotify_event) char buffer[4096];
+  ssize_t size;
+  while ((size = read(fd_, buffer, sizeof(buffer))) > 0) {
+    for (char *p = buffer; p < buffer + size;) {
+      const inotify_event &event{*reinterpret_cast<inotify_event *>(p)};
+      if (event.len > 0) {
+        for (const File &file : file_) {
+          if (file.watch == event.wd && file.name == event.name) {
+            report(file.path);
+          }
+        }
+      }
+      p += sizeof(inotify_event) + event.len;
+    }
+  }
+#else
+  for (File &file : file_) {
+    long long modified{ModifiedTime(file.directory + file.name)};
+    if (modified != file.modified) {
+      file.modified = modified;
+      report(file.path);
+    }
+  }
+#endif
+}
+
+};  // namespace graphics
@@ -0,0 +1,78 @@
+#include "graphics/free_list.h"
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <utility>
+
+namespace graphics {
+
+FreeList::FreeList(std::size_t capacity) { Reset(capacity); }
+
+void FreeList::Reset(std::size_t capacity) {
+  capacity_ = capacity;
+  free_size_ = capacity;
+  by_offset_.clear();
+  by_size_.clear();
+  if (capacity > 0) {
+    by_offset_[0] = capacity;
+    by_size_.insert(std::make_pair(capacity, std::size_t{0}));
+  }
+}
+
+bool FreeList::Allocate(std::size_t size, std::size_t &offset) {
+  if (size == 0) {
+    offset = 0;
+    return true;
+  }
+  auto fit = by_size_.lower_bound(std::make_pair(size, std::size_t{0}));
+  if (fit == by_size_.end()) {
+    return false;
+  }
+  std::size_t range_size{fit->first};
+  offset = fit->second;
+  by_size_.erase(fit);
+  by_offset_.erase(offset);
+  if (range_size > size) {
+    by_offset_[offset + size] = range_size - size;
+    by_size_.insert(std::make_pair(range_size - size, offset + size));
+  }
+  free_size_ -= size;
+  return true;
+}
+
+void FreeList::Free(std::size_t offset, std::size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (offset + size > capacity_) {
+    throw std::string{"free list: range out of bounds"};
+  }
+  std::size_t freed{size};
+  auto next = by_offset_.lower_bound(offset);
+  if (next != by_offset_.end() && next->first < offset + size) {
+    throw std::string{"free list: range freed twice"};
+  }
+  if (next != by_offset_.end() && next->first == offset + size) {
+    size += next->second;
+    by_size_.erase(std::make_pair(next->second, next->first));
+    next = by_offset_.erase(next);
+  }
+  if (next != by_offset_.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second > offset) {
+      throw std::string{"free list: range freed twice"};
+    }
+    if (previous->first + previous->second == offset) {
+      offset = previous->first;
+      size += previous->second;
+      by_size_.erase(std::make_pair(previous->second, previous->first));
+      by_offset_.erase(previous);
+    }
+  }
+  by_offset_[offset] = size;
+  by_size_.insert(std::make_pair(size, offset));
+  free_size_ += freed;
+}
+
+};  // namespace graphics
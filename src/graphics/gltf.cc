@@ -0,0 +1,602 @@
+#include "graphics/gltf.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "graphics/json.h"
+#include "graphics/mapped_file.h"
+
+namespace graphics {
+
+const std::uint32_t kGlbMagic{0x46546c67};
+const std::uint32_t kGlbJsonChunk{0x4e4f534a};
+const std::uint32_t kGlbBinaryChunk{0x004e4942};
+
+static int ReadIndex(JsonReader &reader) {
+  return static_cast<int>(reader.ReadNumber());
+}
+
+static std::size_t ReadSize(JsonReader &reader) {
+  double value{reader.ReadNumber()};
+  if (value < 0.0) {
+    throw std::string{"gltf: negative size"};
+  }
+  return static_cast<std::size_t>(value);
+}
+
+// Reads up to count numbers of an array into value.
+static void ReadNumbers(JsonReader &reader, float *value, unsigned count) {
+  reader.BeginArray();
+  for (unsigned i = 0; reader.NextElement(); ++i) {
+    float number{static_cast<float>(reader.ReadNumber())};
+    if (i < count) {
+      value[i] = number;
+    }
+  }
+}
+
+static void ReadIndices(JsonReader &reader, std::vector<int> &value) {
+  reader.BeginArray();
+  while (reader.NextElement()) {
+    value.push_back(ReadIndex(reader));
+  }
+}
+
+// Calls read for each element of an array, after appending a fresh element
+// to items for it to fill.
+template <typename Item, typename Read>
+static void ReadArray(JsonReader &reader, std::vector<Item> &items,
+                      const Item &initial, Read read) {
+  reader.BeginArray();
+  while (reader.NextElement()) {
+    items.push_back(initial);
+    read(items.back());
+  }
+}
+
+// The "index" of a textureInfo object, ignoring its other members.
+static int ReadTextureInfo(JsonReader &reader, float *scale = nullptr) {
+  int index{-1};
+  std::string key;
+  reader.BeginObject();
+  while (reader.NextMember(key)) {
+    if (key == "index") {
+      index = ReadIndex(reader);
+    } else if (scale && (key == "strength" || key == "scale")) {
+      *scale = static_cast<float>(reader.ReadNumber());
+    } else {
+      reader.Skip();
+    }
+  }
+  return index;
+}
+
+static unsigned ComponentCount(const std::string &type) {
+  if (type == "SCALAR") {
+    return 1;
+  } else if (type == "VEC2") {
+    return 2;
+  } else if (type == "VEC3") {
+    return 3;
+  } else if (type == "VEC4" || type == "MAT2") {
+    return 4;
+  } else if (type == "MAT3") {
+    return 9;
+  } else if (type == "MAT4") {
+    return 16;
+  }
+  throw "gltf: unknown accessor type " + type;
+}
+
+static glm::mat4 Compose(const float *translation, const float *rotation,
+                         const float *scale) {
+  float x{rotation[0]}, y{rotation[1]}, z{rotation[2]}, w{rotation[3]};
+  glm::mat4 m{1.0f};
+  m[0] = glm::vec4{1 - 2 * (y * y + z * z), 2 * (x * y + z * w),
+                   2 * (x * z - y * w), 0.0f} *
+         scale[0];
+  m[1] = glm::vec4{2 * (x * y - z * w), 1 - 2 * (x * x + z * z),
+                   2 * (y * z + x * w), 0.0f} *
+         scale[1];
+  m[2] = glm::vec4{2 * (x * z + y * w), 2 * (y * z - x * w),
+                   1 - 2 * (x * x + y * y), 0.0f} *
+         scale[2];
+  m[3] = glm::vec4{translation[0], translation[1], translation[2], 1.0f};
+  return m;
+}
+
+static void ReadNode(JsonReader &reader, GltfNode &node) {
+  float matrix[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+  float translation[3]{0, 0, 0};
+  float rotation[4]{0, 0, 0, 1};
+  float scale[3]{1, 1, 1};
+  bool has_matrix{false};
+  std::string key;
+  reader.BeginObject();
+  while (reader.NextMember(key)) {
+    if (key == "mesh") {
+      node.mesh = ReadIndex(reader);
+    } else if (key == "children") {
+      ReadIndices(reader, node.children);
+    } else if (key == "matrix") {
+      ReadNumbers(reader, matrix, 16);
+      has_matrix = true;
+    } else if (key == "translation") {
+      ReadNumbers(reader, translation, 3);
+    } else if (key == "rotation") {
+      ReadNumbers(reader, rotation, 4);
+    } else if (key == "scale") {
+      ReadNumbers(reader, scale, 3);
+    } else {
+      reader.Skip();
+    }
+  }
+  if (has_matrix) {
+    for (int c = 0; c < 4; ++c) {
+      node.matrix[c] = glm::vec4{matrix[4 * c], matrix[4 * c + 1],
+                                 matrix[4 * c + 2], matrix[4 * c + 3]};
+    }
+  } else {
+    node.matrix = Compose(translation, rotation, scale);
+  }
+}
+
+static void ReadPrimitive(JsonReader &reader, GltfPrimitive &primitive) {
+  std::string key;
+  reader.BeginObject();
+  while (reader.NextMember(key)) {
+    if (key == "attributes") {
+      reader.BeginObject();
+      while (reader.NextMember(key)) {
+        if (key == "POSITION") {
+          primitive.position = ReadIndex(reader);
+        } else if (key == "NORMAL") {
+          primitive.normal = ReadIndex(reader);
+        } else if (key == "TANGENT") {
+          primitive.tangent = ReadIndex(reader);
+        } else if (key == "TEXCOORD_0") {
+          primitive.texture_coordinate = ReadIndex(reader);
+        } else {
+          reader.Skip();
+        }
+      }
+    } else if (key == "indices") {
+      primitive.indices = ReadIndex(reader);
+    } else if (key == "material") {
+      primitive.material = ReadIndex(reader);
+    } else if (key == "mode") {
+      primitive.mode = static_cast<unsigned>(reader.ReadNumber());
+    } else {
+      reader.Skip();
+    }
+  }
+}
+
+static void ReadMaterial(JsonReader &reader, GltfMaterial &material) {
+  std::string key;
+  reader.BeginObject();
+  while (reader.NextMember(key)) {
+    if (key == "pbrMetallicRoughness") {
+      reader.BeginObject();
+      while (reader.NextMember(key)) {
+        if (key == "baseColorFactor") {
+          ReadNumbers(reader, &material.base_color_factor[0], 4);
+        } else if (key == "baseColorTexture") {
+          material.base_color_texture = ReadTextureInfo(reader);
+        } else if (key == "metallicFactor") {
+          material.metallic_factor = static_cast<float>(reader.ReadNumber());
+        } else if (key == "roughnessFactor") {
+          material.roughness_factor = static_cast<float>(reader.ReadNumber());
+        } else if (key == "metallicRoughnessTexture") {
+          material.metallic_roughness_texture = ReadTextureInfo(reader);
+        } else {
+          reader.Skip();
+        }
+      }
+    } else if (key == "normalTexture") {
+      material.normal_texture = ReadTextureInfo(reader);
+    } else if (key == "occlusionTexture") {
+      material.occlusion_texture =
+          ReadTextureInfo(reader, &material.occlusion_strength);
+    } else {
+      reader.Skip();
+    }
+  }
+}
+
+static void ReadDocument(JsonReader &reader, Gltf &gltf) {
+  const GltfBuffer kBuffer{std::string{}, 0, nullptr};
+  const GltfBufferView kBufferView{-1, 0, 0, 0};
+  const GltfAccessor kAccessor{-1, 0, 0, 0, 0, false, false,
+                               glm::vec3{0.0f}, glm::vec3{0.0f}};
+  const GltfMesh kMesh{std::string{}, std::vector<GltfPrimitive>{}};
+  const GltfPrimitive kPrimitive{-1, -1, -1, -1, -1, -1, 4};
+  const GltfImage kImage{std::string{}, -1};
+  const GltfTexture kTexture{-1};
+  const GltfMaterial kMaterial{glm::vec4{1.0f}, -1, 1.0f, 1.0f, -1, -1, -1,
+                               1.0f};
+  const GltfNode kNode{-1, std::vector<int>{}, glm::mat4{1.0f}};
+
+  std::string key;
+  reader.BeginObject();
+  while (reader.NextMember(key)) {
+    if (key == "asset") {
+      reader.BeginObject();
+      while (reader.NextMember(key)) {
+        if (key == "version") {
+          std::string version{reader.ReadString()};
+          if (version.compare(0, 2, "2.") != 0) {
+            throw "gltf: unsupported version " + version;
+          }
+        } else {
+          reader.Skip();
+        }
+      }
+    } else if (key == "extensionsRequired") {
+      reader.BeginArray();
+      while (reader.NextElement()) {
+        throw "gltf: unsupported required extension " + reader.ReadString();
+      }
+    } else if (key == "scene") {
+      gltf.default_scene = ReadIndex(reader);
+    } else if (key == "scenes") {
+      reader.BeginArray();
+      while (reader.NextElement()) {
+        gltf.scene.emplace_back();
+        reader.BeginObject();
+        while (reader.NextMember(key)) {
+          if (key == "nodes") {
+            ReadIndices(reader, gltf.scene.back());
+          } else {
+            reader.Skip();
+          }
+        }
+      }
+    } else if (key == "nodes") {
+      ReadArray(reader, gltf.node, kNode,
+                [&](GltfNode &node) { ReadNode(reader, node); });
+    } else if (key == "meshes") {
+      ReadArray(reader, gltf.mesh, kMesh, [&](GltfMesh &mesh) {
+        reader.BeginObject();
+        while (reader.NextMember(key)) {
+          if (key == "name") {
+            reader.ReadString(mesh.name);
+          } else if (key == "primitives") {
+            ReadArray(reader, mesh.primitive, kPrimitive,
+                      [&](GltfPrimitive &primitive) {
+                        ReadPrimitive(reader, primitive);
+                      });
+          } else {
+            reader.Skip();
+          }
+        }
+      });
+    } else if (key == "accessors") {
+      ReadArray(reader, gltf.accessor, kAccessor, [&](GltfAccessor &accessor) {
+        reader.BeginObject();
+        while (reader.NextMember(key)) {
+          if (key == "bufferView") {
+            accessor.buffer_view = ReadIndex(reader);
+          } else if (key == "byteOffset") {
+            accessor.byte_offset = ReadSize(reader);
+          } else if (key == "componentType") {
+            accessor.component_type =
+                static_cast<unsigned>(reader.ReadNumber());
+          } else if (key == "normalized") {
+            accessor.normalized = reader.ReadBool();
+          } else if (key == "count") {
+            accessor.count = ReadSize(reader);
+          } else if (key == "type") {
+            accessor.component_count = ComponentCount(reader.ReadString());
+          } else if (key == "min") {
+            ReadNumbers(reader, &accessor.min[0], 3);
+            accessor.bounded = true;
+          } else if (key == "max") {
+            ReadNumbers(reader, &accessor.max[0], 3);
+          } else {
+            reader.Skip();
+          }
+        }
+      });
+    } else if (key == "bufferViews") {
+      ReadArray(reader, gltf.buffer_view, kBufferView,
+                [&](GltfBufferView &view) {
+                  reader.BeginObject();
+                  while (reader.NextMember(key)) {
+                    if (key == "buffer") {
+                      view.buffer = ReadIndex(reader);
+                    } else if (key == "byteOffset") {
+                      view.byte_offset = ReadSize(reader);
+                    } else if (key == "byteLength") {
+                      view.byte_length = ReadSize(reader);
+                    } else if (key == "byteStride") {
+                      view.byte_stride = ReadSize(reader);
+                    } else {
+                      reader.Skip();
+                    }
+                  }
+                });
+    } else if (key == "buffers") {
+      ReadArray(reader, gltf.buffer, kBuffer, [&](GltfBuffer &buffer) {
+        reader.BeginObject();
+        while (reader.NextMember(key)) {
+          if (key == "uri") {
+            reader.ReadString(buffer.uri);
+          } else if (key == "byteLength") {
+            buffer.byte_length = ReadSize(reader);
+          } else {
+            reader.Skip();
+          }
+        }
+      });
+    } else if (key == "images") {
+      ReadArray(reader, gltf.image, kImage, [&](GltfImage &image) {
+        reader.BeginObject();
+        while (reader.NextMember(key)) {
+          if (key == "uri") {
+            reader.ReadString(image.path);
+          } else if (key == "bufferView") {
+            image.buffer_view = ReadIndex(reader);
+          } else {
+            reader.Skip();
+          }
+        }
+      });
+    } else if (key == "textures") {
+      ReadArray(reader, gltf.texture, kTexture, [&](GltfTexture &texture) {
+        reader.BeginObject();
+        while (reader.NextMember(key)) {
+          if (key == "source") {
+            texture.source = ReadIndex(reader);
+          } else {
+            reader.Skip();
+          }
+        }
+      });
+    } else if (key == "materials") {
+      ReadArray(
+          reader, gltf.material, kMaterial,
+          [&](GltfMaterial &material) { ReadMaterial(reader, material); });
+    } else {
+      reader.Skip();
+    }
+  }
+  reader.End();
+}
+
+// glTF nodes form a forest: a node listed as a child by two nodes, or by
+// itself, would be drawn once per path to it
+static void CheckHierarchy(const Gltf &gltf) {
+  std::vector<bool> parented(gltf.node.size(), false);
+  for (std::size_t n = 0; n < gltf.node.size(); ++n) {
+    for (int c : gltf.node[n].children) {
+      if (c < 0 || static_cast<std::size_t>(c) >= parented.size()) {
+        continue;
+      }
+      if (static_cast<std::size_t>(c) == n) {
+        throw "gltf: node " + std::to_string(c) + " is its own child";
+      }
+      if (parented[c]) {
+        throw "gltf: node " + std::to_string(c) + " has more than one parent";
+      }
+      parented[c] = true;
+    }
+  }
+}
+
+// -1 unless c is a hex digit
+static int HexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Undoes the percent-encoding of a relative uri.
+static std::string DecodeUri(const std::string &uri) {
+  std::string path;
+  for (std::size_t i = 0; i < uri.size(); ++i) {
+    if (uri[i] == '%') {
+      int high{i + 2 < uri.size() ? HexDigit(uri[i + 1]) : -1};
+      int low{i + 2 < uri.size() ? HexDigit(uri[i + 2]) : -1};
+      if (high < 0 || low < 0) {
+        throw "gltf: malformed escape in uri " + uri;
+      }
+      path += static_cast<char>(high << 4 | low);
+      i += 2;
+    } else {
+      path += uri[i];
+    }
+  }
+  return path;
+}
+
+static const MappedFile &MapFile(Gltf &gltf, const std::string &path) {
+  std::unique_ptr<MappedFile> file{new MappedFile};
+  if (!file->Open(path)) {
+    throw "gltf: fail to map " + path;
+  }
+  gltf.file.push_back(std::move(file));
+  return *gltf.file.back();
+}
+
+void LoadGltf(const std::string &path, Gltf &gltf) {
+  gltf = Gltf{};
+  gltf.default_scene = -1;
+  std::size_t slash{path.find_last_of('/')};
+  gltf.directory = slash == std::string::npos ? "." : path.substr(0, slash);
+  const MappedFile &file{MapFile(gltf, path)};
+
+  // a .glb is a header and a JSON chunk, then optionally the binary chunk
+  // its first buffer refers to
+  const char *json{reinterpret_cast<const char *>(file.Data())};
+  std::size_t json_size{file.Size()};
+  const unsigned char *binary{nullptr};
+  std::size_t binary_size{0};
+  std::uint32_t word[5];
+  if (file.Size() >= sizeof(word)) {
+    std::memcpy(word, file.Data(), sizeof(word));
+  }
+  if (file.Size() >= sizeof(word) && word[0] == kGlbMagic) {
+    if (word[1] != 2 || word[2] < 20 || word[2] > file.Size() ||
+        word[4] != kGlbJsonChunk ||
+        word[3] > word[2] - 20) {
+      throw "gltf: malformed glb " + path;
+    }
+    json = reinterpret_cast<const char *>(file.Data() + 20);
+    json_size = word[3];
+    std::size_t offset{20 + ((word[3] + 3) & ~std::size_t{3})};
+    if (offset + 8 <= word[2]) {
+      std::uint32_t chunk[2];
+      std::memcpy(chunk, file.Data() + offset, sizeof(chunk));
+      if (chunk[1] == kGlbBinaryChunk && chunk[0] <= word[2] - offset - 8) {
+        binary = file.Data() + offset + 8;
+        binary_size = chunk[0];
+      }
+    }
+  }
+  gltf.json_size = json_size;
+  JsonReader reader{json, json_size};
+  ReadDocument(reader, gltf);
+  CheckHierarchy(gltf);
+
+  for (std::size_t b = 0; b < gltf.buffer.size(); ++b) {
+    GltfBuffer &buffer{gltf.buffer[b]};
+    std::size_t size;
+    if (buffer.uri.empty()) {
+      if (b != 0 || !binary) {
+        throw std::string{"gltf: buffer without uri outside a glb"};
+      }
+      buffer.data = binary;
+      size = binary_size;
+    } else if (buffer.uri.compare(0, 5, "data:") == 0) {
+      throw std::string{"gltf: data uris are not supported; convert to .glb"};
+    } else {
+      const MappedFile &data{
+          MapFile(gltf, gltf.directory + "/" + DecodeUri(buffer.uri))};
+      buffer.data = data.Data();
+      size = data.Size();
+    }
+    if (buffer.byte_length > size) {
+      throw "gltf: buffer " + std::to_string(b) + " is truncated";
+    }
+  }
+  for (GltfImage &image : gltf.image) {
+    if (image.path.compare(0, 5, "data:") == 0) {
+      throw std::string{"gltf: data uris are not supported; convert to .glb"};
+    } else if (!image.path.empty()) {
+      image.path = gltf.directory + "/" + DecodeUri(image.path);
+    }
+  }
+  for (const GltfBufferView &view : gltf.buffer_view) {
+    if (view.buffer < 0 ||
+        static_cast<std::size_t>(view.buffer) >= gltf.buffer.size() ||
+        view.byte_offset + view.byte_length >
+            gltf.buffer[view.buffer].byte_length) {
+      throw std::string{"gltf: buffer view out of range"};
+    }
+  }
+}
+
+std::size_t GltfComponentSize(unsigned component_type) {
+  switch (component_type) {
+    case 5120:  // BYTE
+    case 5121:  // UNSIGNED_BYTE
+      return 1;
+    case 5122:  // SHORT
+    case 5123:  // UNSIGNED_SHORT
+      return 2;
+    case 5125:  // UNSIGNED_INT
+    case 5126:  // FLOAT
+      return 4;
+  }
+  throw "gltf: unknown component type " + std::to_string(component_type);
+}
+
+const unsigned char *AccessorData(const Gltf &gltf, int accessor,
+                                  std::size_t &stride) {
+  if (accessor < 0 || static_cast<std::size_t>(accessor) >=
+                          gltf.accessor.size()) {
+    throw std::string{"gltf: accessor out of range"};
+  }
+  const GltfAccessor &a{gltf.accessor[accessor]};
+  if (a.buffer_view < 0 ||
+      static_cast<std::size_t>(a.buffer_view) >= gltf.buffer_view.size()) {
+    throw std::string{"gltf: sparse or unbacked accessors are not supported"};
+  }
+  const GltfBufferView &view{gltf.buffer_view[a.buffer_view]};
+  std::size_t element_size{GltfComponentSize(a.component_type) *
+                           a.component_count};
+  stride = view.byte_stride ? view.byte_stride : element_size;
+  if (a.count > 0 && a.byte_offset + stride * (a.count - 1) + element_size >
+                         view.byte_length) {
+    throw std::string{"gltf: accessor overruns its buffer view"};
+  }
+  return gltf.buffer[view.buffer].data + view.byte_offset + a.byte_offset;
+}
+
+std::vector<std::pair<int, glm::mat4>> FlattenScene(const Gltf &gltf) {
+  std::vector<std::pair<int, glm::mat4>> drawn;
+  std::vector<int> root;
+  if (!gltf.scene.empty()) {
+    int scene{gltf.default_scene};
+    if (scene < 0 || static_cast<std::size_t>(scene) >= gltf.scene.size()) {
+      scene = 0;
+    }
+    root = gltf.scene[scene];
+  } else {
+    // no scenes: treat every node nobody parents as a root
+    std::vector<bool> child(gltf.node.size(), false);
+    for (const GltfNode &node : gltf.node) {
+      for (int c : node.children) {
+        if (c >= 0 && static_cast<std::size_t>(c) < child.size()) {
+          child[c] = true;
+        }
+      }
+    }
+    for (std::size_t n = 0; n < gltf.node.size(); ++n) {
+      if (!child[n]) {
+        root.push_back(static_cast<int>(n));
+      }
+    }
+  }
+
+  // depth first with an explicit stack; LoadGltf allows each node at most
+  // one parent, and visiting each once stops cycles and repeated roots
+  std::vector<std::pair<int, glm::mat4>> stack;
+  std::vector<bool> visited(gltf.node.size(), false);
+  for (int r : root) {
+    stack.push_back(std::make_pair(r, glm::mat4{1.0f}));
+  }
+  while (!stack.empty()) {
+    std::pair<int, glm::mat4> top{stack.back()};
+    stack.pop_back();
+    if (top.first < 0 ||
+        static_cast<std::size_t>(top.first) >= gltf.node.size() ||
+        visited[top.first]) {
+      continue;
+    }
+    visited[top.first] = true;
+    const GltfNode &node{gltf.node[top.first]};
+    glm::mat4 world{top.second * node.matrix};
+    if (node.mesh >= 0 &&
+        static_cast<std::size_t>(node.mesh) < gltf.mesh.size()) {
+      drawn.push_back(std::make_pair(node.mesh, world));
+    }
+    for (int c : node.children) {
+      stack.push_back(std::make_pair(c, world));
+    }
+  }
+  return drawn;
+}
+
+};  // namespace graphics
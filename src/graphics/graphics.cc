@@ -1,15 +1,37 @@
 #include "graphics/graphics.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "GL/glew.h"
 #include "configure/root_directory.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "graphics/asset_io.h"
+#include "graphics/gltf.h"
+#include "graphics/hdr.h"
+#include "graphics/mapped_file.h"
+#include "graphics/mesh_optimizer.h"
+#include "graphics/shader_library.h"
+#include "graphics/shader_preprocess.h"
+#include "graphics/simplify.h"
+#include "graphics/thread_pool.h"
 #include "stb/stb_image.h"
 
 namespace graphics {
@@ -27,61 +49,305 @@ float delta_time{0.0f};
 
 bool enable_camera_move{false};
 
-unsigned sphere_vao{0};
-unsigned sphere_index_count;
-unsigned cube_vao{0};
 unsigned quad_vao{0};
 
-unsigned LoadTexture(const std::string &path) {
-  unsigned texture_id;
-  glGenTextures(1, &texture_id);
+const unsigned kConstantTextureTolerance{2};
+std::unordered_map<TextureKey, unsigned, TextureKeyHash> texture_cache;
+std::unordered_map<std::string, std::string> shader_source;
+std::unordered_map<std::uint64_t, std::vector<Mesh>> mesh_cache;
+Pack asset_pack;
 
-  int width, height, component_count;
-  unsigned char *data =
-      stbi_load(path.c_str(), &width, &height, &component_count, 0);
-  if (data) {
-    GLenum format;
-    if (component_count == 1) {
-      format = GL_RED;
-    } else if (component_count == 3) {
-      format = GL_RGB;
-    } else if (component_count == 4) {
-      format = GL_RGBA;
-    }
-
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                 GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                    GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  } else {
+static bool IsConstantImage(const unsigned char *data, int width, int height,
+                            int component_count, int row_pitch,
+                            glm::vec4 &value) {
+  unsigned char low[4];
+  unsigned char high[4];
+  std::memcpy(low, data, component_count);
+  std::memcpy(high, data, component_count);
+  for (int y = 0; y < height; ++y) {
+    const unsigned char *texel{data + static_cast<std::size_t>(y) * row_pitch};
+    const unsigned char *end{texel + width * component_count};
+    for (; texel != end; texel += component_count) {
+      for (int c = 0; c < component_count; ++c) {
+        low[c] = std::min(low[c], texel[c]);
+        high[c] = std::max(high[c], texel[c]);
+        if (static_cast<unsigned>(high[c] - low[c]) >
+            kConstantTextureTolerance) {
+          return false;
+        }
+      }
+    }
+  }
+  // match what sampling a GL_RED/GL_RG/GL_RGB/GL_RGBA texture would return
+  value = glm::vec4{0.0f, 0.0f, 0.0f, 1.0f};
+  for (int c = 0; c < component_count; ++c) {
+    value[c] = (low[c] + high[c]) / (2.0f * 255.0f);
+  }
+  return true;
+}
+
+// Fills in whether decoded is constant, and its value or cache key.
+static void ClassifyTexture(DecodedTexture &decoded) {
+  const unsigned char *pixel{decoded.pixel.data()};
+  decoded.value = glm::vec4{0.0f, 0.0f, 0.0f, 1.0f};
+  decoded.constant =
+      IsConstantImage(pixel, decoded.width, decoded.height,
+                      decoded.component_count, decoded.row_pitch,
+                      decoded.value);
+  TextureKey &key{decoded.key};
+  key = TextureKey{{0, 0}, decoded.width, decoded.height,
+                   decoded.component_count};
+  if (decoded.constant) {
+    return;
+  }
+
+  key.hash[0] = 14695981039346656037ull;
+  key.hash[1] = 0x9e3779b97f4a7c15ull;
+  for (int y = 0; y < decoded.height; ++y) {
+    const unsigned char *row{pixel +
+                             static_cast<std::size_t>(y) * decoded.row_pitch};
+    std::size_t size{static_cast<std::size_t>(decoded.width) *
+                     decoded.component_count};
+    key.hash[0] = HashBytes(row, size, key.hash[0]);
+    key.hash[1] = HashBytes(row, size, key.hash[1]);
+  }
+}
+
+void DecodeTexture(const std::string &path, const unsigned char *data,
+                   std::size_t size, DecodedTexture &decoded) {
+  int length{static_cast<int>(size)};
+  if (!stbi_info_from_memory(data, length, &decoded.width, &decoded.height,
+                             &decoded.component_count)) {
     throw "fail to load texture at " + path;
   }
-  stbi_image_free(data);
-  return texture_id;
+  decoded.row_pitch = (decoded.width * decoded.component_count + 3) & ~3;
+  decoded.pixel.resize(static_cast<std::size_t>(decoded.row_pitch) *
+                       decoded.height);
+  unsigned char *pixel{decoded.pixel.data()};
+  if (!stbi_load_from_memory_into(data, length, &decoded.width,
+                                  &decoded.height, &decoded.component_count,
+                                  decoded.component_count, pixel,
+                                  decoded.row_pitch)) {
+    throw "fail to load texture at " + path;
+  }
+
+  ClassifyTexture(decoded);
 }
 
-std::vector<std::vector<unsigned>> LoadPbrTexture(const char *material[],
-                                                  unsigned count) {
-  std::string path;
-  std::vector<std::vector<unsigned>> pbr_texture;
+static GLenum TextureFormat(int component_count) {
+  if (component_count == 1) {
+    return GL_RED;
+  } else if (component_count == 2) {
+    return GL_RG;
+  } else if (component_count == 3) {
+    return GL_RGB;
+  }
+  return GL_RGBA;
+}
+
+Texture UploadTexture(const DecodedTexture &decoded) {
+  Texture texture{0, decoded.constant, decoded.value};
+  if (decoded.constant) {
+    return texture;
+  }
+
+  auto cached = texture_cache.find(decoded.key);
+  if (cached != texture_cache.end()) {
+    texture.id = cached->second;
+    return texture;
+  }
+
+  glGenTextures(1, &texture.id);
+  texture_cache[decoded.key] = texture.id;
+
+  GLenum format{TextureFormat(decoded.component_count)};
+
+  glBindTexture(GL_TEXTURE_2D, texture.id);
+  glTexImage2D(GL_TEXTURE_2D, 0, format, decoded.width, decoded.height, 0,
+               format, GL_UNSIGNED_BYTE, decoded.pixel.data());
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  return texture;
+}
+
+Texture LoadTexture(const std::string &path) {
+  std::ifstream file{path, std::ios::binary | std::ios::ate};
+  if (!file) {
+    throw "fail to load texture at " + path;
+  }
+  std::vector<unsigned char> data(static_cast<std::size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(data.data()), data.size());
+  // one staging buffer reused across loads
+  static DecodedTexture decoded;
+  DecodeTexture(path, data.data(), data.size(), decoded);
+  return UploadTexture(decoded);
+}
+
+const char *kPbrMapName[]{"normal", "albedo", "metallic", "roughness", "ao"};
+static_assert(sizeof(kPbrMapName) / sizeof(const char *) == kPbrMapCount,
+              "a map name per map the Draw block has");
+
+std::vector<std::vector<Texture>> LoadPbrTexture(const char *material[],
+                                                 unsigned count) {
+  std::vector<std::string> paths;
   for (unsigned u = 0; u < count; ++u) {
-    std::vector<unsigned> texture;
-    path = std::string{root_directory} + "/resource/texture/pbr/" + material[u];
-    texture.push_back(LoadTexture(path + "/normal.png"));
-    texture.push_back(LoadTexture(path + "/albedo.png"));
-    texture.push_back(LoadTexture(path + "/metallic.png"));
-    texture.push_back(LoadTexture(path + "/roughness.png"));
-    texture.push_back(LoadTexture(path + "/ao.png"));
-    pbr_texture.push_back(texture);
+    for (unsigned m = 0; m < kPbrMapCount; ++m) {
+      paths.push_back(std::string{root_directory} + "/resource/texture/pbr/" +
+                      material[u] + "/" + kPbrMapName[m] + ".png");
+    }
+  }
+
+  // Workers decode into buffers recycled from spare and queue the results;
+  // at most queue_limit decoded images wait for upload at once.
+  struct Decoded {
+    std::size_t index;
+    DecodedTexture texture;
+    std::string error;
+  };
+  std::mutex mutex;
+  std::condition_variable queue_ready;
+  std::condition_variable queue_space;
+  std::deque<Decoded> queue;
+  std::vector<std::vector<unsigned char>> spare;
+  std::size_t byte_count{0};
+  bool abandoned{false};
+
+  auto start = std::chrono::steady_clock::now();
+  ThreadPool pool;
+  const std::size_t queue_limit{pool.thread_count_ + 1};
+  auto on_read = [&](std::size_t i, const unsigned char *data,
+                     std::size_t size) {
+    Decoded decoded;
+    decoded.index = i;
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      byte_count += size;
+      if (!spare.empty()) {
+        decoded.texture.pixel.swap(spare.back());
+        spare.pop_back();
+      }
+    }
+    try {
+      if (!data) {
+        throw "fail to load texture at " + paths[i];
+      }
+      DecodeTexture(paths[i], data, size, decoded.texture);
+    } catch (const std::string &e) {
+      decoded.error = e;
+    } catch (...) {
+      // the upload loop waits for an entry per path, so one always goes in
+      decoded.error = "fail to decode texture at " + paths[i];
+    }
+    std::unique_lock<std::mutex> lock{mutex};
+    queue_space.wait(
+        lock, [&] { return abandoned || queue.size() < queue_limit; });
+    queue.push_back(std::move(decoded));
+    queue_ready.notify_one();
+  };
+  AssetReadStats stats;
+  try {
+    stats = ReadAssets(paths, pool, on_read, &asset_pack);
+  } catch (const std::string &) {
+    // let queued decodes drain so the pool can shut down
+    std::lock_guard<std::mutex> lock{mutex};
+    abandoned = true;
+    queue_space.notify_all();
+    throw;
+  }
+
+  std::vector<std::vector<Texture>> pbr_texture(
+      count, std::vector<Texture>(kPbrMapCount));
+  std::string error;
+  for (std::size_t uploaded = 0; uploaded < paths.size(); ++uploaded) {
+    Decoded decoded;
+    {
+      std::unique_lock<std::mutex> lock{mutex};
+      queue_ready.wait(lock, [&] { return !queue.empty(); });
+      decoded = std::move(queue.front());
+      queue.pop_front();
+      queue_space.notify_one();
+    }
+    if (!decoded.error.empty()) {
+      if (error.empty()) {
+        error = decoded.error;
+      }
+      continue;
+    }
+    pbr_texture[decoded.index / kPbrMapCount][decoded.index % kPbrMapCount] =
+        UploadTexture(decoded.texture);
+    std::lock_guard<std::mutex> lock{mutex};
+    spare.push_back(std::move(decoded.texture.pixel));
   }
+  pool.Wait();
+  if (!error.empty()) {
+    throw error;
+  }
+
+  std::chrono::duration<double, std::milli> elapsed{
+      std::chrono::steady_clock::now() - start};
+  std::cout << "loaded " << stats.file_count << " textures ("
+            << byte_count / 1024 << " KiB, " << stats.pack_count
+            << " from the pack) in " << elapsed.count() << " ms via "
+            << (stats.io_uring ? "io_uring" : "thread pool") << std::endl;
   return pbr_texture;
 }
 
+unsigned LoadHdrTexture(const std::string &path, int max_width) {
+  // .hdr files are packed raw and streamed from the mapping like the loose
+  // file; a compressed one, from a pack built otherwise, would have to be
+  // decompressed whole first, so the loose file is streamed instead
+  const PackEntry *entry{asset_pack.Find(path)};
+  std::unique_ptr<HdrReader> reader_pointer;
+  if (entry && !(entry->flags & kPackCompressed)) {
+    reader_pointer.reset(new HdrReader{path, asset_pack.Data(*entry),
+                                       static_cast<std::size_t>(entry->size)});
+  } else {
+    reader_pointer.reset(new HdrReader{path});
+  }
+  HdrReader &reader{*reader_pointer};
+  unsigned texture_id{0};
+  int width, height;
+  const int kBandHeight{64};
+  std::vector<float> band;
+  int band_start{0};
+  // rows arrive top first; filling each band from its end and uploading it
+  // below the previous one yields a bottom-up texture
+  auto upload = [&](int row_count) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, height - band_start - row_count,
+                    width, row_count, GL_RGB, GL_FLOAT,
+                    &band[(kBandHeight - row_count) * width * 3]);
+  };
+  DownsampleHdr(reader, max_width, width, height,
+                [&](int y, const float *rgb) {
+                  if (y == 0) {
+                    band.resize(kBandHeight * width * 3);
+                    glGenTextures(1, &texture_id);
+                    glBindTexture(GL_TEXTURE_2D, texture_id);
+                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height,
+                                 0, GL_RGB, GL_FLOAT, nullptr);
+                  }
+                  int slot{kBandHeight - 1 - (y - band_start)};
+                  std::copy(rgb, rgb + width * 3, &band[slot * width * 3]);
+                  if (slot == 0) {
+                    upload(kBandHeight);
+                    band_start += kBandHeight;
+                  }
+                });
+  if (band_start < height) {
+    upload(height - band_start);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  return texture_id;
+}
+
 void ErrorCallback(int error, const char *description) {
   throw std::string{description};
 }
@@ -151,164 +417,1215 @@ void ProcessInput(GLFWwindow *window) {
   }
 }
 
-void RenderSphere() {
-  if (sphere_vao == 0) {
-    glGenVertexArrays(1, &sphere_vao);
+// Points locations 0 to 3 of the bound VAO at the bound array buffer in
+// Vertex's layout, or 0 to 2 in PackedVertex's.
+static void PointVertexAttributes(bool packed) {
+  if (packed) {
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(
+        0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex),
+        reinterpret_cast<void *>(offsetof(PackedVertex, position)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(
+        1, 4, GL_INT_2_10_10_10_REV, GL_FALSE, sizeof(PackedVertex),
+        reinterpret_cast<void *>(offsetof(PackedVertex, normal)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(
+        2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex),
+        reinterpret_cast<void *>(offsetof(PackedVertex, texture_coordinate)));
+  } else {
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          reinterpret_cast<void *>(offsetof(Vertex, position)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          reinterpret_cast<void *>(offsetof(Vertex, normal)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(
+        2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+        reinterpret_cast<void *>(offsetof(Vertex, texture_coordinate)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          reinterpret_cast<void *>(offsetof(Vertex, tangent)));
+  }
+}
+
+std::vector<Mesh> UploadMeshFile(const MeshFileView &view, bool packed) {
+  const MeshFileHeader &header{*view.header};
+  Mesh mesh;
+  mesh.vertex_count = header.vertex_count;
+  mesh.index_type =
+      header.index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  mesh.packed = packed;
+  mesh.position_offset = glm::vec3{0.0f};
+  mesh.position_scale = glm::vec3{1.0f};
+  if (packed) {
+    mesh.position_offset =
+        glm::vec3{header.position_offset[0], header.position_offset[1],
+                  header.position_offset[2]};
+    mesh.position_scale =
+        glm::vec3{header.position_scale[0], header.position_scale[1],
+                  header.position_scale[2]};
+  }
+  mesh.bounds = Aabb{
+      glm::vec3{header.bounds_min[0], header.bounds_min[1],
+                header.bounds_min[2]},
+      glm::vec3{header.bounds_max[0], header.bounds_max[1],
+                header.bounds_max[2]}};
+  glGenVertexArrays(1, &mesh.vao);
+  glGenBuffers(1, &mesh.vbo);
+  glGenBuffers(1, &mesh.ebo);
+  glBindVertexArray(mesh.vao);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+  if (packed) {
+    glBufferData(GL_ARRAY_BUFFER,
+                 std::size_t{header.vertex_count} * sizeof(PackedVertex),
+                 view.packed_vertex, GL_STATIC_DRAW);
+  } else {
+    glBufferData(GL_ARRAY_BUFFER,
+                 std::size_t{header.vertex_count} * sizeof(Vertex),
+                 view.vertex, GL_STATIC_DRAW);
+  }
+  PointVertexAttributes(packed);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               std::size_t{header.index_count} * header.index_size,
+               view.index, GL_STATIC_DRAW);
+  glBindVertexArray(0);
 
-    unsigned vbo, ebo;
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+  std::vector<Mesh> level(header.lod_count, mesh);
+  for (std::uint32_t l = 0; l < header.lod_count; ++l) {
+    const MeshFileLod &lod{view.lod[l]};
+    level[l].index_first = lod.index_first;
+    level[l].index_count = lod.index_count;
+    level[l].error = lod.error;
+    level[l].meshlet.assign(view.meshlet + lod.meshlet_first,
+                            view.meshlet + lod.meshlet_first +
+                                lod.meshlet_count);
+  }
+  return level;
+}
 
-    std::vector<glm::vec3> position;
-    std::vector<glm::vec3> normal;
-    std::vector<glm::vec2> texture_coordinate;
-    std::vector<unsigned> index;
+const std::vector<Mesh> &GetMeshLevels(MeshShape shape,
+                                       unsigned tessellation, bool packed) {
+  if (shape == kCube) {
+    tessellation = 0;
+  }
+  std::uint64_t key{static_cast<std::uint64_t>(shape) << 33 |
+                    static_cast<std::uint64_t>(packed) << 32 | tessellation};
+  auto cached = mesh_cache.find(key);
+  if (cached != mesh_cache.end()) {
+    return cached->second;
+  }
+
+  // mesh_import's file from the pack or disk when there is a current one,
+  // and otherwise the same file built in memory
+  auto start = std::chrono::steady_clock::now();
+  std::string name{MeshShapeName(shape, tessellation)};
+  std::string path{std::string{root_directory} + "/bin/mesh/" + name +
+                   ".mesh"};
+  const PackEntry *entry{asset_pack.Find(path)};
+  MappedFile file;
+  std::vector<unsigned char> bytes;
+  const unsigned char *data{nullptr};
+  std::size_t size{0};
+  // mesh files are packed raw, so they go to GL straight from the mapping;
+  // a compressed one is from a pack built otherwise and passed over
+  if (entry && !(entry->flags & kPackCompressed)) {
+    data = asset_pack.Data(*entry);
+    size = static_cast<std::size_t>(entry->size);
+  } else if (file.Open(path)) {
+    data = file.Data();
+    size = file.Size();
+  }
+  MeshFileView view;
+  bool loaded{false};
+  if (data) {
+    try {
+      ParseMeshFile(data, size, view);
+      loaded = true;
+    } catch (const std::string &e) {
+      std::cout << path << ": " << e << std::endl;
+    }
+  }
+  if (!loaded) {
+    MeshAsset asset;
+    BuildShapeAsset(shape, tessellation, asset);
+    SerializeMeshFile(asset, bytes);
+    ParseMeshFile(bytes.data(), bytes.size(), view);
+  }
+  std::vector<Mesh> &level{mesh_cache[key] = UploadMeshFile(view, packed)};
+  std::chrono::duration<double, std::milli> elapsed{
+      std::chrono::steady_clock::now() - start};
+  std::cout << "mesh " << name << ": " << view.header->vertex_count
+            << " vertices, " << level[0].index_count / 3 << " triangles, "
+            << level.size() << " levels, " << view.header->meshlet_count
+            << " meshlets " << (loaded ? "loaded" : "built") << " in "
+            << elapsed.count() << " ms" << std::endl;
+  return level;
+}
+
+const Mesh &GetMesh(MeshShape shape, unsigned tessellation, bool packed) {
+  return GetMeshLevels(shape, tessellation, packed)[0];
+}
+
+const PoolMesh &GetPoolMesh(MeshShape shape, unsigned tessellation) {
+  static std::unordered_map<std::uint64_t, PoolMesh> pool_mesh_cache;
+  if (shape == kCube) {
+    tessellation = 0;
+  }
+  std::uint64_t key{static_cast<std::uint64_t>(shape) << 32 | tessellation};
+  auto cached = pool_mesh_cache.find(key);
+  if (cached != pool_mesh_cache.end()) {
+    return cached->second;
+  }
+  MeshAsset asset;
+  BuildShapeAsset(shape, tessellation, asset);
+  // the finest level only
+  asset.mesh.index.resize(asset.lod[0].index_count * asset.mesh.index_size);
+  return pool_mesh_cache[key] = mesh_pool.Add(asset.mesh);
+}
+
+// Where mesh's first index sits in its index buffer.
+static void *IndexOffset(const Mesh &mesh) {
+  std::size_t index_size{mesh.index_type == GL_UNSIGNED_SHORT ? 2u : 4u};
+  return reinterpret_cast<void *>(mesh.index_first * index_size);
+}
+
+void DrawMesh(const Mesh &mesh) {
+  glBindVertexArray(mesh.vao);
+  glDrawElements(GL_TRIANGLES, mesh.index_count, mesh.index_type,
+                 IndexOffset(mesh));
+  glBindVertexArray(0);
+}
+
+void DrawMeshRanges(const Mesh &mesh, const std::vector<unsigned> &first,
+                    const std::vector<unsigned> &count) {
+  if (first.empty()) {
+    return;
+  }
+  std::size_t index_size{mesh.index_type == GL_UNSIGNED_SHORT ? 2u : 4u};
+  std::vector<GLsizei> draw_count(count.begin(), count.end());
+  std::vector<const void *> offset(first.size());
+  for (std::size_t i = 0; i < first.size(); ++i) {
+    offset[i] = reinterpret_cast<const void *>(first[i] * index_size);
+  }
+  glBindVertexArray(mesh.vao);
+  glMultiDrawElements(GL_TRIANGLES, draw_count.data(), mesh.index_type,
+                      offset.data(), static_cast<GLsizei>(first.size()));
+  glBindVertexArray(0);
+}
 
-    const unsigned kXsegmentCount = 64;
-    const unsigned kYsegmentCount = 64;
-    const float kPi = 3.14159265359f;
-    for (unsigned x = 0; x <= kXsegmentCount; ++x) {
-      for (unsigned y = 0; y <= kYsegmentCount; ++y) {
-        float xsegment =
-            static_cast<float>(x) / static_cast<float>(kXsegmentCount);
-        float ysegment =
-            static_cast<float>(y) / static_cast<float>(kYsegmentCount);
-        float xposition =
-            2.0f * std::cos(xsegment * 2.0f * kPi) * std::sin(ysegment * kPi);
-        float yposition = 2.0f * std::cos(ysegment * kPi);
-        float zposition =
-            2.0f * std::sin(xsegment * 2.0f * kPi) * std::sin(ysegment * kPi);
+// the offsets std140 gives the blocks' members
+static_assert(offsetof(FrameBlock, light_position) == 144 &&
+                  sizeof(FrameBlock) == 272,
+              "FrameBlock no longer matches the Frame block");
+static_assert(offsetof(DrawBlock, packed_vertex) == 76 &&
+                  offsetof(DrawBlock, map_value) == 96 &&
+                  offsetof(DrawBlock, map_constant) == 176 &&
+                  sizeof(DrawBlock) == 208,
+              "DrawBlock no longer matches the Draw block");
 
-        position.push_back(glm::vec3(xposition, yposition, zposition));
-        normal.push_back(glm::vec3(xposition, yposition, zposition));
-        texture_coordinate.push_back(glm::vec2(xsegment, ysegment));
+UniformBlocks::UniformBlocks(unsigned draw_capacity)
+    : draw_{},
+      draw_count_{0},
+      draw_capacity_{draw_capacity},
+      frame_buffer_{0},
+      draw_buffer_{0},
+      draw_stride_{0},
+      draw_next_{0} {
+  draw_.model = glm::mat4{1.0f};
+  draw_.position_scale = glm::vec3{1.0f};
+}
+
+void UniformBlocks::Initialize() {
+  if (frame_buffer_ != 0) {
+    return;
+  }
+  GLint alignment;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  draw_stride_ = (sizeof(DrawBlock) + alignment - 1) / alignment * alignment;
+  glGenBuffers(1, &frame_buffer_);
+  glGenBuffers(1, &draw_buffer_);
+  glBindBuffer(GL_UNIFORM_BUFFER, draw_buffer_);
+  glBufferData(GL_UNIFORM_BUFFER, draw_capacity_ * draw_stride_, nullptr,
+               GL_STREAM_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBlocks::SetFrame(const FrameBlock &frame) {
+  Initialize();
+  // fresh storage, as the previous frame may still be reading the old
+  glBindBuffer(GL_UNIFORM_BUFFER, frame_buffer_);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), &frame, GL_STREAM_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, kFrameBlockBinding, frame_buffer_);
+  draw_count_ = 0;
+}
+
+void UniformBlocks::PushDraw() {
+  Initialize();
+  glBindBuffer(GL_UNIFORM_BUFFER, draw_buffer_);
+  if (draw_next_ == draw_capacity_) {
+    // draws already issued still read the slots about to be overwritten
+    glBufferData(GL_UNIFORM_BUFFER, draw_capacity_ * draw_stride_, nullptr,
+                 GL_STREAM_DRAW);
+    draw_next_ = 0;
+  }
+  GLintptr offset{static_cast<GLintptr>(draw_next_ * draw_stride_)};
+  glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(DrawBlock), &draw_);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferRange(GL_UNIFORM_BUFFER, kDrawBlockBinding, draw_buffer_,
+                    offset, sizeof(DrawBlock));
+  ++draw_next_;
+  ++draw_count_;
+}
+
+// a frame's worth of draws for the demo's grid of separate draws
+UniformBlocks uniform_blocks{4096};
+
+void SetVertexFormat(const Mesh *mesh) {
+  bool packed{mesh && mesh->packed};
+  DrawBlock &draw{uniform_blocks.draw_};
+  draw.vertex_tangent = mesh != nullptr;
+  draw.packed_vertex = packed;
+  draw.position_offset = packed ? mesh->position_offset : glm::vec3{0.0f};
+  draw.position_scale = packed ? mesh->position_scale : glm::vec3{1.0f};
+  draw.flip_texture_coord = false;
+}
+
+// Builds target from source as value * scale + bias per channel, taking
+// only the given channel into a one-channel image unless channel is -1.
+// Grayscale sources are widened to RGB so a colored scale can apply. A
+// missing source reads as 1, giving a constant texture.
+static void DeriveTexture(const DecodedTexture *source, int channel,
+                          const glm::vec4 &scale, const glm::vec4 &bias,
+                          DecodedTexture &target) {
+  if (!source) {
+    target.pixel.clear();
+    target.width = target.height = 0;
+    target.component_count = channel < 0 ? 4 : 1;
+    target.row_pitch = 0;
+    target.constant = true;
+    target.value = glm::vec4{0.0f, 0.0f, 0.0f, 1.0f};
+    for (int c = 0; c < target.component_count; ++c) {
+      target.value[c] = glm::clamp(scale[c] + bias[c], 0.0f, 1.0f);
+    }
+    target.key = TextureKey{{0, 0}, 0, 0, target.component_count};
+    return;
+  }
+  int source_count{source->component_count};
+  int count{1};
+  if (channel < 0) {
+    count = source_count < 3 ? source_count + 2 : source_count;
+  }
+  target.width = source->width;
+  target.height = source->height;
+  target.component_count = count;
+  target.row_pitch = (target.width * count + 3) & ~3;
+  target.pixel.resize(static_cast<std::size_t>(target.row_pitch) *
+                      target.height);
+  int from[4];
+  for (int c = 0; c < count; ++c) {
+    int wanted{channel < 0 ? c : channel};
+    from[c] = source_count >= 3 ? wanted : (wanted < 3 ? 0 : 1);
+  }
+  for (int y = 0; y < target.height; ++y) {
+    const unsigned char *in{source->pixel.data() +
+                            static_cast<std::size_t>(y) * source->row_pitch};
+    unsigned char *out{target.pixel.data() +
+                       static_cast<std::size_t>(y) * target.row_pitch};
+    for (int x = 0; x < target.width; ++x) {
+      for (int c = 0; c < count; ++c) {
+        float value{in[from[c]] * scale[c] + 255.0f * bias[c]};
+        out[c] = static_cast<unsigned char>(
+            glm::clamp(value, 0.0f, 255.0f) + 0.5f);
       }
+      in += source_count;
+      out += count;
+    }
+  }
+  ClassifyTexture(target);
+}
+
+// Decodes the images gltf's materials use on a thread pool, then bakes each
+// material into the five maps pbr.fs reads and uploads them.
+static std::vector<std::vector<Texture>> LoadModelMaterials(
+    const Gltf &gltf, std::size_t &image_bytes) {
+  std::vector<GltfMaterial> materials{gltf.material};
+  // glTF's default material, for primitives without one
+  materials.push_back(
+      GltfMaterial{glm::vec4{1.0f}, -1, 1.0f, 1.0f, -1, -1, -1, 1.0f});
+  auto image_of = [&](int texture) {
+    if (texture < 0 ||
+        static_cast<std::size_t>(texture) >= gltf.texture.size()) {
+      return -1;
     }
+    int source{gltf.texture[texture].source};
+    return source >= 0 && static_cast<std::size_t>(source) < gltf.image.size()
+               ? source
+               : -1;
+  };
 
-    bool odd_row = false;
-    for (unsigned y = 0; y < kYsegmentCount; ++y) {
-      if (!odd_row) {
-        for (unsigned x = 0; x <= kXsegmentCount; ++x) {
-          index.push_back(y * (kXsegmentCount + 1) + x);
-          index.push_back((y + 1) * (kXsegmentCount + 1) + x);
+  std::vector<DecodedTexture> image(gltf.image.size());
+  std::vector<bool> used(gltf.image.size(), false);
+  for (const GltfMaterial &material : materials) {
+    for (int texture :
+         {material.base_color_texture, material.metallic_roughness_texture,
+          material.normal_texture, material.occlusion_texture}) {
+      if (image_of(texture) >= 0) {
+        used[image_of(texture)] = true;
+      }
+    }
+  }
+  std::mutex mutex;
+  image_bytes = 0;
+  ThreadPool pool;
+  for (std::size_t i = 0; i < image.size(); ++i) {
+    if (!used[i]) {
+      continue;
+    }
+    pool.Submit([&, i] {
+      const GltfImage &source{gltf.image[i]};
+      std::string name{source.path.empty() ? "image " + std::to_string(i)
+                                           : source.path};
+      MappedFile file;
+      const unsigned char *data;
+      std::size_t size;
+      if (!source.path.empty()) {
+        if (!file.Open(source.path)) {
+          throw "fail to load texture at " + source.path;
         }
+        data = file.Data();
+        size = file.Size();
+      } else if (source.buffer_view >= 0 &&
+                 static_cast<std::size_t>(source.buffer_view) <
+                     gltf.buffer_view.size()) {
+        const GltfBufferView &view{gltf.buffer_view[source.buffer_view]};
+        data = gltf.buffer[view.buffer].data + view.byte_offset;
+        size = view.byte_length;
       } else {
-        for (int x = kXsegmentCount; x >= 0; --x) {
-          index.push_back((y + 1) * (kXsegmentCount + 1) + x);
-          index.push_back(y * (kXsegmentCount + 1) + x);
+        throw "gltf: " + name + " has no data";
+      }
+      DecodeTexture(name, data, size, image[i]);
+      std::lock_guard<std::mutex> lock{mutex};
+      image_bytes += size;
+    });
+  }
+  pool.Wait();
+
+  // factors are linear but albedo maps hold sRGB, so the base color factor
+  // scales them by its 1 / 2.2 power; metallic is blue and roughness green
+  // in their shared map, and occlusion strength s maps ao to s * ao + 1 - s
+  std::vector<DecodedTexture> derived(materials.size() * kPbrMapCount);
+  std::vector<const DecodedTexture *> baked(derived.size());
+  for (std::size_t m = 0; m < materials.size(); ++m) {
+    pool.Submit([&, m] {
+      const GltfMaterial &material{materials[m]};
+      auto source = [&](int texture) -> const DecodedTexture * {
+        return image_of(texture) >= 0 ? &image[image_of(texture)] : nullptr;
+      };
+      const DecodedTexture *normal{source(material.normal_texture)};
+      const DecodedTexture *albedo{source(material.base_color_texture)};
+      const DecodedTexture *metallic_roughness{
+          source(material.metallic_roughness_texture)};
+      const DecodedTexture *ao{source(material.occlusion_texture)};
+      const glm::vec4 &factor{material.base_color_factor};
+      glm::vec4 albedo_scale{std::pow(factor.r, 1.0f / 2.2f),
+                             std::pow(factor.g, 1.0f / 2.2f),
+                             std::pow(factor.b, 1.0f / 2.2f), factor.a};
+      float strength{material.occlusion_strength};
+      DecodedTexture *out{&derived[m * kPbrMapCount]};
+      const DecodedTexture **result{&baked[m * kPbrMapCount]};
+
+      result[0] = normal;
+      if (!normal) {
+        DeriveTexture(nullptr, -1, glm::vec4{0.5f, 0.5f, 1.0f, 1.0f},
+                      glm::vec4{0.0f}, out[0]);
+        result[0] = &out[0];
+      }
+      result[1] = albedo;
+      if (!albedo || albedo_scale != glm::vec4{1.0f}) {
+        DeriveTexture(albedo, -1, albedo_scale, glm::vec4{0.0f}, out[1]);
+        result[1] = &out[1];
+      }
+      DeriveTexture(metallic_roughness, 2,
+                    glm::vec4{material.metallic_factor}, glm::vec4{0.0f},
+                    out[2]);
+      DeriveTexture(metallic_roughness, 1,
+                    glm::vec4{material.roughness_factor}, glm::vec4{0.0f},
+                    out[3]);
+      DeriveTexture(ao, 0, glm::vec4{strength}, glm::vec4{1.0f - strength},
+                    out[4]);
+      for (unsigned i = 2; i < kPbrMapCount; ++i) {
+        result[i] = &out[i];
+      }
+    });
+  }
+  pool.Wait();
+
+  std::vector<std::vector<Texture>> texture(
+      materials.size(), std::vector<Texture>(kPbrMapCount));
+  for (std::size_t i = 0; i < baked.size(); ++i) {
+    texture[i / kPbrMapCount][i % kPbrMapCount] = UploadTexture(*baked[i]);
+  }
+  return texture;
+}
+
+static unsigned IndexAt(const unsigned char *data, unsigned component_type) {
+  if (component_type == GL_UNSIGNED_BYTE) {
+    return *data;
+  } else if (component_type == GL_UNSIGNED_SHORT) {
+    std::uint16_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  std::uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static unsigned MaxIndex(const unsigned char *data, std::size_t stride,
+                         unsigned component_type, std::size_t count) {
+  unsigned max{0};
+  for (std::size_t i = 0; i < count; ++i, data += stride) {
+    max = std::max(max, IndexAt(data, component_type));
+  }
+  return max;
+}
+
+static float ReadComponent(const unsigned char *data, unsigned type) {
+  if (type == GL_UNSIGNED_BYTE) {
+    return *data / 255.0f;
+  } else if (type == GL_UNSIGNED_SHORT) {
+    std::uint16_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value / 65535.0f;
+  }
+  float value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// Copies a triangle list into a MeshData, indexing it if it is not, with
+// texture coordinates flipped the way pbr.vs flips them.
+static void ExtractMesh(const Gltf &gltf, const GltfPrimitive &primitive,
+                        MeshData &data) {
+  std::size_t stride;
+  const unsigned char *position{
+      AccessorData(gltf, primitive.position, stride)};
+  std::size_t vertex_count{gltf.accessor[primitive.position].count};
+  data.vertex.resize(vertex_count);
+  for (std::size_t v = 0; v < vertex_count; ++v, position += stride) {
+    Vertex &vertex{data.vertex[v]};
+    std::memcpy(&vertex.position[0], position, sizeof(float) * 3);
+    vertex.normal = glm::vec3{0.0f};
+    vertex.texture_coordinate = glm::vec2{0.0f};
+    vertex.tangent = glm::vec4{0.0f};
+  }
+  if (primitive.normal >= 0) {
+    const unsigned char *normal{AccessorData(gltf, primitive.normal, stride)};
+    for (std::size_t v = 0; v < vertex_count; ++v, normal += stride) {
+      std::memcpy(&data.vertex[v].normal[0], normal, sizeof(float) * 3);
+    }
+  }
+  if (primitive.texture_coordinate >= 0) {
+    unsigned type{gltf.accessor[primitive.texture_coordinate].component_type};
+    std::size_t size{GltfComponentSize(type)};
+    const unsigned char *uv{
+        AccessorData(gltf, primitive.texture_coordinate, stride)};
+    for (std::size_t v = 0; v < vertex_count; ++v, uv += stride) {
+      data.vertex[v].texture_coordinate = glm::vec2{
+          ReadComponent(uv, type), 1.0f - ReadComponent(uv + size, type)};
+    }
+  }
+  data.index_size = 4;
+  if (primitive.indices >= 0) {
+    const GltfAccessor &indices{gltf.accessor[primitive.indices]};
+    const unsigned char *index{AccessorData(gltf, primitive.indices, stride)};
+    data.index.resize(indices.count * 4);
+    for (std::size_t i = 0; i < indices.count; ++i, index += stride) {
+      data.SetIndex(i, IndexAt(index, indices.component_type));
+    }
+  } else {
+    data.index.resize(vertex_count * 4);
+    for (std::size_t i = 0; i < vertex_count; ++i) {
+      data.SetIndex(i, static_cast<unsigned>(i));
+    }
+  }
+  data.error = 0.0f;
+}
+
+Model LoadModel(const std::string &path, bool analyze, bool build_lods) {
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+  auto start = Clock::now();
+  Gltf gltf;
+  LoadGltf(path, gltf);
+  Milliseconds parse_time{Clock::now() - start};
+
+  // one GL buffer per buffer view a primitive reads, filled straight from
+  // the mapped file; each accessor becomes an offset into its view's buffer
+  auto buffer_start = Clock::now();
+  Milliseconds analyze_time{0.0};
+  Milliseconds lod_time{0.0};
+  Model model;
+  std::vector<unsigned> view_buffer(gltf.buffer_view.size(), 0);
+  std::size_t buffer_bytes{0};
+  auto upload = [&](int accessor) {
+    std::size_t stride;
+    AccessorData(gltf, accessor, stride);
+    int v{gltf.accessor[accessor].buffer_view};
+    if (view_buffer[v] == 0) {
+      const GltfBufferView &view{gltf.buffer_view[v]};
+      glGenBuffers(1, &view_buffer[v]);
+      glBindBuffer(GL_ARRAY_BUFFER, view_buffer[v]);
+      glBufferData(GL_ARRAY_BUFFER, view.byte_length,
+                   gltf.buffer[view.buffer].data + view.byte_offset,
+                   GL_STATIC_DRAW);
+      model.buffer.push_back(view_buffer[v]);
+      buffer_bytes += view.byte_length;
+    }
+    return view_buffer[v];
+  };
+  auto attribute = [&](unsigned location, int accessor) {
+    const GltfAccessor &a{gltf.accessor[accessor]};
+    glBindBuffer(GL_ARRAY_BUFFER, upload(accessor));
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(
+        location, a.component_count, a.component_type, a.normalized,
+        static_cast<GLsizei>(gltf.buffer_view[a.buffer_view].byte_stride),
+        reinterpret_cast<void *>(a.byte_offset));
+  };
+
+  std::size_t triangle_count{0};
+  unsigned lod_primitive_count{0};
+  std::size_t lod_triangle_count{0};
+  unsigned skipped{0};
+  unsigned generated{0};
+  for (const GltfMesh &mesh : gltf.mesh) {
+    unsigned first{static_cast<unsigned>(model.primitive.size())};
+    for (const GltfPrimitive &primitive : mesh.primitive) {
+      if (primitive.position < 0 || primitive.normal < 0) {
+        ++skipped;
+        continue;
+      }
+      std::size_t stride;
+      AccessorData(gltf, primitive.position, stride);
+      AccessorData(gltf, primitive.normal, stride);
+      const GltfAccessor &position{gltf.accessor[primitive.position]};
+      const GltfAccessor &normal{gltf.accessor[primitive.normal]};
+      if (position.component_type != GL_FLOAT ||
+          position.component_count != 3 ||
+          normal.component_type != GL_FLOAT || normal.component_count != 3 ||
+          normal.count < position.count) {
+        throw "gltf: bad position or normal in mesh " + mesh.name;
+      }
+      std::size_t vertex_count{position.count};
+      if (primitive.texture_coordinate >= 0) {
+        AccessorData(gltf, primitive.texture_coordinate, stride);
+        const GltfAccessor &uv{gltf.accessor[primitive.texture_coordinate]};
+        if (uv.component_count != 2 || uv.count < vertex_count ||
+            (uv.component_type != GL_FLOAT && !uv.normalized)) {
+          throw "gltf: bad texture coordinates in mesh " + mesh.name;
+        }
+      }
+
+      ModelPrimitive drawn;
+      drawn.lod = 0;
+      drawn.center = glm::vec3{0.0f};
+      drawn.radius = 0.0f;
+      drawn.mode = primitive.mode;
+      drawn.index_type = 0;
+      drawn.index_offset = 0;
+      drawn.count = static_cast<unsigned>(vertex_count);
+      drawn.material =
+          primitive.material >= 0 &&
+                  static_cast<std::size_t>(primitive.material) <
+                      gltf.material.size()
+              ? static_cast<unsigned>(primitive.material)
+              : static_cast<unsigned>(gltf.material.size());
+      glGenVertexArrays(1, &drawn.vao);
+      glBindVertexArray(drawn.vao);
+      attribute(0, primitive.position);
+      attribute(1, primitive.normal);
+      if (primitive.texture_coordinate >= 0) {
+        attribute(2, primitive.texture_coordinate);
+      }
+      if (primitive.indices >= 0) {
+        const GltfAccessor &indices{gltf.accessor[primitive.indices]};
+        const unsigned char *data{
+            AccessorData(gltf, primitive.indices, stride)};
+        if (indices.component_count != 1 ||
+            (indices.component_type != GL_UNSIGNED_BYTE &&
+             indices.component_type != GL_UNSIGNED_SHORT &&
+             indices.component_type != GL_UNSIGNED_INT) ||
+            stride != GltfComponentSize(indices.component_type)) {
+          throw "gltf: bad indices in mesh " + mesh.name;
+        }
+        // GL does not bounds check indices, so a bad file could read past
+        // the vertex buffers
+        if (indices.count > 0 &&
+            MaxIndex(data, stride, indices.component_type, indices.count) >=
+                vertex_count) {
+          throw "gltf: index out of range in mesh " + mesh.name;
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, upload(primitive.indices));
+        drawn.index_type = indices.component_type;
+        drawn.index_offset = indices.byte_offset;
+        drawn.count = static_cast<unsigned>(indices.count);
+      }
+      drawn.tangent = true;
+      if (primitive.tangent >= 0) {
+        AccessorData(gltf, primitive.tangent, stride);
+        const GltfAccessor &tangent{gltf.accessor[primitive.tangent]};
+        if (tangent.component_type != GL_FLOAT ||
+            tangent.component_count != 4 || tangent.count < vertex_count) {
+          throw "gltf: bad tangents in mesh " + mesh.name;
+        }
+        attribute(3, primitive.tangent);
+      } else if (primitive.texture_coordinate >= 0 &&
+                 drawn.mode == GL_TRIANGLES) {
+        // the one attribute not read straight from the file
+        MeshData data;
+        ExtractMesh(gltf, primitive, data);
+        GenerateTangents(data);
+        std::vector<glm::vec4> tangent(data.vertex.size());
+        for (std::size_t v = 0; v < tangent.size(); ++v) {
+          tangent[v] = data.vertex[v].tangent;
+        }
+        unsigned buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, tangent.size() * sizeof(glm::vec4),
+                     tangent.data(), GL_STATIC_DRAW);
+        model.buffer.push_back(buffer);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
+        ++generated;
+      } else {
+        drawn.tangent = false;
+      }
+      if (build_lods && drawn.mode == GL_TRIANGLES) {
+        auto lod_start = Clock::now();
+        MeshData data;
+        ExtractMesh(gltf, primitive, data);
+        std::vector<MeshLod> chain;
+        BuildLodChain(data, chain);
+        if (chain.size() > 1) {
+          // level 0 too, so switching levels only moves the offset
+          std::vector<std::uint32_t> index;
+          for (const MeshLod &level : chain) {
+            drawn.lod_offset.push_back(index.size() * sizeof(std::uint32_t));
+            drawn.lod_count.push_back(
+                static_cast<unsigned>(level.index.size()));
+            drawn.lod_error.push_back(level.error);
+            index.insert(index.end(), level.index.begin(), level.index.end());
+          }
+          unsigned buffer;
+          glGenBuffers(1, &buffer);
+          glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+          glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                       index.size() * sizeof(std::uint32_t), index.data(),
+                       GL_STATIC_DRAW);
+          model.buffer.push_back(buffer);
+          drawn.index_type = GL_UNSIGNED_INT;
+          drawn.index_offset = drawn.lod_offset[0];
+          drawn.count = drawn.lod_count[0];
+          Aabb bounds{MeshBounds(data)};
+          drawn.center = 0.5f * (bounds.min + bounds.max);
+          drawn.radius = 0.5f * glm::length(bounds.max - bounds.min);
+          ++lod_primitive_count;
+          lod_triangle_count += data.IndexCount() / 3 * (chain.size() - 1);
         }
+        lod_time += Clock::now() - lod_start;
+      }
+      glBindVertexArray(0);
+      model.primitive.push_back(drawn);
+      if (drawn.mode == GL_TRIANGLES) {
+        triangle_count += drawn.count / 3;
+      }
+
+      if (analyze && drawn.mode == GL_TRIANGLES && drawn.index_type != 0) {
+        auto analyze_start = Clock::now();
+        MeshData data;
+        ExtractMesh(gltf, primitive, data);
+        MeshStatistics statistics{AnalyzeMesh(data)};
+        std::cout << "mesh " << mesh.name << "["
+                  << &primitive - mesh.primitive.data() << "]: "
+                  << data.vertex.size() << " vertices, "
+                  << data.IndexCount() / 3 << " triangles, acmr "
+                  << statistics.acmr << ", atvr " << statistics.atvr
+                  << ", overdraw " << statistics.overdraw << std::endl;
+        analyze_time += Clock::now() - analyze_start;
       }
-      odd_row = !odd_row;
     }
-    sphere_index_count = index.size();
+    model.mesh.push_back(std::make_pair(
+        first, static_cast<unsigned>(model.primitive.size()) - first));
+  }
+  if (generated > 0) {
+    std::cout << "gltf: generated tangents for " << generated
+              << " primitives" << std::endl;
+  }
+  if (lod_primitive_count > 0) {
+    std::cout << "gltf: built lods for " << lod_primitive_count
+              << " primitives in " << lod_time.count() << " ms, "
+              << lod_triangle_count / (lod_time.count() * 1e3)
+              << " M triangles/s simplified" << std::endl;
+  }
+  if (skipped > 0) {
+    std::cout << "gltf: skipped " << skipped
+              << " primitives without positions or normals" << std::endl;
+  }
+  Milliseconds buffer_time{Clock::now() - buffer_start - analyze_time -
+                           lod_time};
+
+  auto texture_start = Clock::now();
+  std::size_t image_bytes;
+  model.material = LoadModelMaterials(gltf, image_bytes);
+  Milliseconds texture_time{Clock::now() - texture_start};
 
-    std::vector<float> data;
-    for (unsigned i = 0; i < position.size(); ++i) {
-      data.push_back(position[i].x);
-      data.push_back(position[i].y);
-      data.push_back(position[i].z);
-      if (normal.size() > 0) {
-        data.push_back(normal[i].x);
-        data.push_back(normal[i].y);
-        data.push_back(normal[i].z);
+  // bound the scene by its position accessors' boxes, carried through each
+  // node's transform
+  model.node = FlattenScene(gltf);
+  glm::vec3 low{std::numeric_limits<float>::max()};
+  glm::vec3 high{-std::numeric_limits<float>::max()};
+  for (const std::pair<int, glm::mat4> &node : model.node) {
+    for (const GltfPrimitive &primitive : gltf.mesh[node.first].primitive) {
+      if (primitive.position < 0 ||
+          !gltf.accessor[primitive.position].bounded) {
+        continue;
       }
-      if (texture_coordinate.size() > 0) {
-        data.push_back(texture_coordinate[i].x);
-        data.push_back(texture_coordinate[i].y);
+      const GltfAccessor &position{gltf.accessor[primitive.position]};
+      for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 point{corner & 1 ? position.max.x : position.min.x,
+                        corner & 2 ? position.max.y : position.min.y,
+                        corner & 4 ? position.max.z : position.min.z};
+        glm::vec3 world{node.second * glm::vec4{point, 1.0f}};
+        low = glm::min(low, world);
+        high = glm::max(high, world);
       }
     }
-    glBindVertexArray(sphere_vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0],
-                 GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index.size() * sizeof(unsigned int),
-                 &index[0], GL_STATIC_DRAW);
-    unsigned stride = (3 + 2 + 3) * sizeof(float);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
-                          reinterpret_cast<void *>(0));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
-                          reinterpret_cast<void *>(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
-                          reinterpret_cast<void *>(6 * sizeof(float)));
-  }
-
-  glBindVertexArray(sphere_vao);
-  glDrawElements(GL_TRIANGLE_STRIP, sphere_index_count, GL_UNSIGNED_INT, 0);
-}
-
-void RenderCube() {
-  if (cube_vao == 0) {
-    float vertices[] = {
-        // back face
-        -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,  // bottom-left
-        1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,    // top-right
-        1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f,   // bottom-right
-        1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,    // top-right
-        -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,  // bottom-left
-        -1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f,   // top-left
-        // front face
-        -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,  // bottom-left
-        1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,   // bottom-right
-        1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,    // top-right
-        1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,    // top-right
-        -1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,   // top-left
-        -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,  // bottom-left
-        // left face
-        -1.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,    // top-right
-        -1.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f,   // top-left
-        -1.0f, -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,  // bottom-left
-        -1.0f, -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,  // bottom-left
-        -1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f,   // bottom-right
-        -1.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,    // top-right
-                                                             // right face
-        1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,      // top-left
-        1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,    // bottom-right
-        1.0f, 1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,     // top-right
-        1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,    // bottom-right
-        1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,      // top-left
-        1.0f, -1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,     // bottom-left
-        // bottom face
-        -1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f,  // top-right
-        1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 1.0f,   // top-left
-        1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,    // bottom-left
-        1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,    // bottom-left
-        -1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f,   // bottom-right
-        -1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f,  // top-right
-        // top face
-        -1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,  // top-left
-        1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,    // bottom-right
-        1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,   // top-right
-        1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,    // bottom-right
-        -1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,  // top-left
-        -1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f    // bottom-left
-    };
-    unsigned vbo{0};
-    glGenVertexArrays(1, &cube_vao);
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glBindVertexArray(cube_vao);
-    unsigned stride = (3 + 2 + 3) * sizeof(float);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
-                          reinterpret_cast<void *>(0));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
-                          reinterpret_cast<void *>(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
-                          reinterpret_cast<void *>(6 * sizeof(float)));
   }
+  if (low.x <= high.x) {
+    model.center = 0.5f * (low + high);
+    model.radius = std::max(0.5f * glm::length(high - low), 1e-6f);
+  } else {
+    model.center = glm::vec3{0.0f};
+    model.radius = 1.0f;
+  }
+
+  Milliseconds total_time{Clock::now() - start - analyze_time - lod_time};
+  auto rate = [](std::size_t bytes, const Milliseconds &time) {
+    return bytes / (1024.0 * 1024.0) / std::max(time.count() * 1e-3, 1e-9);
+  };
+  std::size_t total_bytes{gltf.json_size + buffer_bytes + image_bytes};
+  std::cout << "loaded " << path << ": " << gltf.mesh.size() << " meshes, "
+            << model.primitive.size() << " primitives, " << triangle_count
+            << " triangles, " << model.node.size() << " instances; json "
+            << gltf.json_size / 1024 << " KiB in " << parse_time.count()
+            << " ms (" << rate(gltf.json_size, parse_time) << " MiB/s), "
+            << "buffers " << buffer_bytes / 1024 << " KiB in "
+            << buffer_time.count() << " ms ("
+            << rate(buffer_bytes, buffer_time) << " MiB/s), "
+            << gltf.image.size() << " images " << image_bytes / 1024
+            << " KiB in " << texture_time.count() << " ms; "
+            << total_time.count() << " ms total ("
+            << rate(total_bytes, total_time) << " MiB/s)" << std::endl;
+  return model;
+}
+
+void BindPbrMaterial(const std::vector<Texture> &texture,
+                     bool normal_y_up) {
+  DrawBlock &draw{uniform_blocks.draw_};
+  draw.normal_y_up = normal_y_up;
+  for (unsigned i = 0; i < kPbrMapCount; ++i) {
+    if (!texture[i].constant) {
+      glActiveTexture(GL_TEXTURE0 + i);
+      glBindTexture(GL_TEXTURE_2D, texture[i].id);
+    }
+    draw.map_constant[i] = texture[i].constant;
+    draw.map_value[i] = texture[i].value;
+  }
+}
+
+void DrawModel(Model &model, const glm::mat4 &transform,
+               const glm::vec3 &camera_position, float pixels_per_unit) {
+  DrawBlock &draw{uniform_blocks.draw_};
+  SetVertexFormat(nullptr);
+  // the images are decoded bottom row first but glTF puts v = 0 at the top
+  draw.flip_texture_coord = true;
+  unsigned bound{static_cast<unsigned>(model.material.size())};
+  for (const std::pair<int, glm::mat4> &node : model.node) {
+    glm::mat4 world{transform * node.second};
+    draw.model = world;
+    // draw_ changed since the last PushDraw
+    bool changed{true};
+    // the largest stretch of the transform, to scale errors by
+    float scale{std::sqrt(
+        std::max(glm::dot(glm::vec3{world[0]}, glm::vec3{world[0]}),
+                 std::max(glm::dot(glm::vec3{world[1]}, glm::vec3{world[1]}),
+                          glm::dot(glm::vec3{world[2]},
+                                   glm::vec3{world[2]}))))};
+    const std::pair<unsigned, unsigned> &mesh{model.mesh[node.first]};
+    for (unsigned p = mesh.first; p < mesh.first + mesh.second; ++p) {
+      ModelPrimitive &primitive{model.primitive[p]};
+      if (!primitive.lod_error.empty()) {
+        unsigned lod{0};
+        if (pixels_per_unit > 0.0f) {
+          // from the nearest point of the bounding sphere, so a camera
+          // inside it sees the finest level
+          glm::vec3 center{world * glm::vec4{primitive.center, 1.0f}};
+          float distance{glm::length(camera_position - center) -
+                         scale * primitive.radius};
+          if (distance > 0.0f) {
+            lod = SelectLod(primitive.lod_error.data(),
+                            static_cast<unsigned>(primitive.lod_error.size()),
+                            scale * pixels_per_unit / distance,
+                            primitive.lod);
+          }
+        }
+        // the level is kept per primitive, so for a mesh several nodes draw
+        // the hysteresis follows the last of them
+        primitive.lod = lod;
+        primitive.index_offset = primitive.lod_offset[lod];
+        primitive.count = primitive.lod_count[lod];
+      }
+      if (primitive.material != bound) {
+        bound = primitive.material;
+        BindPbrMaterial(model.material[bound], true);
+        changed = true;
+      }
+      if (primitive.tangent != static_cast<bool>(draw.vertex_tangent)) {
+        draw.vertex_tangent = primitive.tangent;
+        changed = true;
+      }
+      if (changed) {
+        uniform_blocks.PushDraw();
+        changed = false;
+      }
+      glBindVertexArray(primitive.vao);
+      if (primitive.index_type != 0) {
+        glDrawElements(primitive.mode, primitive.count, primitive.index_type,
+                       reinterpret_cast<void *>(primitive.index_offset));
+      } else {
+        glDrawArrays(primitive.mode, 0, primitive.count);
+      }
+    }
+  }
+  glBindVertexArray(0);
+  draw.flip_texture_coord = false;
+}
+
+MaterialTable::MaterialTable() {
+  glGenBuffers(1, &buffer_);
+  glGenTextures(1, &texture_);
+}
+
+MaterialTable::~MaterialTable() {
+  glDeleteTextures(1, &texture_);
+  glDeleteBuffers(1, &buffer_);
+}
+
+void MaterialTable::Set(const std::vector<InstanceMaterial> &material) {
+  // two RGBA32F texels per material: albedo and ao, metallic and roughness
+  std::vector<glm::vec4> texel;
+  texel.reserve(material.size() * 2);
+  for (const InstanceMaterial &m : material) {
+    texel.push_back(glm::vec4{m.albedo, m.ao});
+    texel.push_back(glm::vec4{m.metallic, m.roughness, 0.0f, 0.0f});
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer_);
+  glBufferData(GL_TEXTURE_BUFFER, texel.size() * sizeof(glm::vec4),
+               texel.data(), GL_STATIC_DRAW);
+  glBindTexture(GL_TEXTURE_BUFFER, texture_);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer_);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void MaterialTable::Bind() const {
+  glActiveTexture(GL_TEXTURE0 + kMaterialTableUnit);
+  glBindTexture(GL_TEXTURE_BUFFER, texture_);
+}
+
+InstanceBatch::InstanceBatch() : count_{0} {
+  glGenBuffers(1, &instance_buffer_);
+}
+
+InstanceBatch::~InstanceBatch() { glDeleteBuffers(1, &instance_buffer_); }
+
+void InstanceBatch::Upload(const std::vector<Instance> &instance) {
+  count_ = static_cast<unsigned>(instance.size());
+  std::size_t size{instance.size() * sizeof(Instance)};
+  // orphan the storage the previous frame may still be drawing from rather
+  // than wait for it
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, size, instance.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Points locations 4 to 7 of the bound VAO at the instance buffer bound
+// to GL_ARRAY_BUFFER, from its first_instance'th Instance on.
+static void PointInstanceAttributes(std::size_t first_instance) {
+  std::size_t base{first_instance * sizeof(Instance)};
+  for (unsigned r = 0; r < 3; ++r) {
+    glEnableVertexAttribArray(4 + r);
+    glVertexAttribPointer(
+        4 + r, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+        reinterpret_cast<void *>(base + offsetof(Instance, row) +
+                                 r * sizeof(glm::vec4)));
+    glVertexAttribDivisor(4 + r, 1);
+  }
+  glEnableVertexAttribArray(7);
+  glVertexAttribIPointer(
+      7, 1, GL_UNSIGNED_INT, sizeof(Instance),
+      reinterpret_cast<void *>(base + offsetof(Instance, material)));
+  glVertexAttribDivisor(7, 1);
+}
+
+void InstanceBatch::Draw(const Mesh &mesh,
+                         const MaterialTable &material) const {
+  if (count_ == 0) {
+    return;
+  }
+  SetVertexFormat(&mesh);
+  uniform_blocks.draw_.instanced = true;
+  uniform_blocks.PushDraw();
+  uniform_blocks.draw_.instanced = false;
+  material.Bind();
+  glBindVertexArray(mesh.vao);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  PointInstanceAttributes(0);
+  glDrawElementsInstanced(GL_TRIANGLES, mesh.index_count, mesh.index_type,
+                          IndexOffset(mesh), count_);
+  // the mesh's other draws must not see the instance attributes
+  for (unsigned a = 4; a < 8; ++a) {
+    glDisableVertexAttribArray(a);
+  }
+  glBindVertexArray(0);
+}
+
+const std::size_t kPoolVertexCapacity{std::size_t{1} << 19};
+const std::size_t kPoolIndexCapacity{std::size_t{1} << 21};
+MeshPool mesh_pool{kPoolVertexCapacity, kPoolIndexCapacity};
+
+// The layout glMultiDrawElementsIndirect reads.
+struct IndirectCommand {
+  std::uint32_t count;
+  std::uint32_t instance_count;
+  std::uint32_t first_index;
+  std::int32_t base_vertex;
+  std::uint32_t base_instance;
+};
+
+MeshPool::MeshPool(std::size_t vertex_capacity, std::size_t index_capacity)
+    : multi_draw_indirect_{false},
+      draw_call_count_{0},
+      command_count_{0},
+      vertex_space_{vertex_capacity},
+      index_space_{index_capacity},
+      vao_{0} {}
+
+void MeshPool::Initialize() {
+  if (vao_ != 0) {
+    return;
+  }
+  multi_draw_indirect_ = GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vertex_buffer_);
+  glGenBuffers(1, &index_buffer_);
+  glGenBuffers(1, &instance_buffer_);
+  glGenBuffers(1, &indirect_buffer_);
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertex_space_.capacity_ * sizeof(Vertex),
+               nullptr, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        reinterpret_cast<void *>(offsetof(Vertex, position)));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        reinterpret_cast<void *>(offsetof(Vertex, normal)));
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(
+      2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+      reinterpret_cast<void *>(offsetof(Vertex, texture_coordinate)));
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        reinterpret_cast<void *>(offsetof(Vertex, tangent)));
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               index_space_.capacity_ * sizeof(std::uint32_t), nullptr,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  PointInstanceAttributes(0);
+  glBindVertexArray(0);
+}
+
+PoolMesh MeshPool::Add(const MeshData &data) {
+  Initialize();
+  PoolMesh mesh;
+  std::size_t first_vertex, first_index;
+  if (!vertex_space_.Allocate(data.vertex.size(), first_vertex)) {
+    throw std::string{"mesh pool: out of vertex space"};
+  }
+  if (!index_space_.Allocate(data.IndexCount(), first_index)) {
+    vertex_space_.Free(first_vertex, data.vertex.size());
+    throw std::string{"mesh pool: out of index space"};
+  }
+  mesh.first_vertex = static_cast<unsigned>(first_vertex);
+  mesh.vertex_count = static_cast<unsigned>(data.vertex.size());
+  mesh.first_index = static_cast<unsigned>(first_index);
+  mesh.index_count = static_cast<unsigned>(data.IndexCount());
+  mesh.error = data.error;
+  mesh.bounds = MeshBounds(data);
+  if (free_id_.empty()) {
+    mesh.id = static_cast<unsigned>(mesh_.size());
+    mesh_.push_back(mesh);
+  } else {
+    mesh.id = free_id_.back();
+    free_id_.pop_back();
+    mesh_[mesh.id] = mesh;
+  }
+
+  // indices stay relative to the mesh's first vertex, which each draw
+  // passes as its base vertex
+  std::vector<std::uint32_t> index(mesh.index_count);
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    index[i] = data.GetIndex(i);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, first_vertex * sizeof(Vertex),
+                  data.vertex.size() * sizeof(Vertex), data.vertex.data());
+  glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, first_index * sizeof(std::uint32_t),
+                  index.size() * sizeof(std::uint32_t), index.data());
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  return mesh;
+}
+
+void MeshPool::Remove(const PoolMesh &mesh) {
+  vertex_space_.Free(mesh.first_vertex, mesh.vertex_count);
+  index_space_.Free(mesh.first_index, mesh.index_count);
+  free_id_.push_back(mesh.id);
+}
+
+void MeshPool::Queue(const PoolMesh &mesh, const Instance &instance) {
+  queue_.push_back(std::make_pair(mesh.id, instance));
+}
+
+void MeshPool::Draw(const MaterialTable &material) {
+  draw_call_count_ = 0;
+  command_count_ = 0;
+  if (queue_.empty()) {
+    return;
+  }
+  // group the queue by mesh with a counting sort, so each mesh's instances
+  // are contiguous and take one command
+  first_.assign(mesh_.size() + 1, 0);
+  for (const std::pair<unsigned, Instance> &draw : queue_) {
+    ++first_[draw.first + 1];
+  }
+  for (std::size_t id = 0; id < mesh_.size(); ++id) {
+    first_[id + 1] += first_[id];
+  }
+  std::vector<IndirectCommand> command;
+  for (std::size_t id = 0; id < mesh_.size(); ++id) {
+    unsigned count{first_[id + 1] - first_[id]};
+    if (count > 0) {
+      const PoolMesh &mesh{mesh_[id]};
+      command.push_back(IndirectCommand{
+          mesh.index_count, count, mesh.first_index,
+          static_cast<std::int32_t>(mesh.first_vertex), first_[id]});
+    }
+  }
+  instance_.resize(queue_.size());
+  for (const std::pair<unsigned, Instance> &draw : queue_) {
+    instance_[first_[draw.first]++] = draw.second;
+  }
+  queue_.clear();
+  command_count_ = static_cast<unsigned>(command.size());
 
-  glBindVertexArray(cube_vao);
-  glDrawArrays(GL_TRIANGLES, 0, 36);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, instance_.size() * sizeof(Instance), nullptr,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, instance_.size() * sizeof(Instance),
+                  instance_.data());
+  SetVertexFormat(nullptr);
+  uniform_blocks.draw_.vertex_tangent = true;
+  uniform_blocks.draw_.instanced = true;
+  uniform_blocks.PushDraw();
+  uniform_blocks.draw_.instanced = false;
+  material.Bind();
+  glBindVertexArray(vao_);
+  if (multi_draw_indirect_) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 command.size() * sizeof(IndirectCommand), command.data(),
+                 GL_STREAM_DRAW);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+                                static_cast<GLsizei>(command.size()), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    draw_call_count_ = 1;
+  } else {
+    for (const IndirectCommand &c : command) {
+      PointInstanceAttributes(c.base_instance);
+      glDrawElementsInstancedBaseVertex(
+          GL_TRIANGLES, c.count, GL_UNSIGNED_INT,
+          reinterpret_cast<void *>(c.first_index * sizeof(std::uint32_t)),
+          c.instance_count, c.base_vertex);
+      ++draw_call_count_;
+    }
+    PointInstanceAttributes(0);
+  }
   glBindVertexArray(0);
 }
 
+GpuTimer::GpuTimer() : begun_{0}, read_{0} {
+  glGenQueries(kQueryCount, query_);
+}
+
+GpuTimer::~GpuTimer() { glDeleteQueries(kQueryCount, query_); }
+
+void GpuTimer::Begin() {
+  if (begun_ - read_ == kQueryCount) {
+    // nobody is polling; drop the oldest result to reuse its query
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(query_[read_ % kQueryCount], GL_QUERY_RESULT,
+                          &elapsed);
+    ++read_;
+  }
+  glBeginQuery(GL_TIME_ELAPSED, query_[begun_ % kQueryCount]);
+}
+
+void GpuTimer::End() {
+  glEndQuery(GL_TIME_ELAPSED);
+  ++begun_;
+}
+
+bool GpuTimer::Poll(double &milliseconds) {
+  if (read_ == begun_) {
+    return false;
+  }
+  unsigned query{query_[read_ % kQueryCount]};
+  int available;
+  glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    return false;
+  }
+  GLuint64 elapsed;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+  ++read_;
+  milliseconds = elapsed * 1e-6;
+  return true;
+}
+
+void RenderSphere() { DrawMesh(GetMesh(kUvSphere, 64)); }
+
+void RenderCube() { DrawMesh(GetMesh(kCube, 0)); }
+
 void RenderQuad() {
   if (quad_vao == 0) {
     unsigned int quad_vbo;
@@ -435,119 +1752,400 @@ void Camera::UpdateCamera() {
   up_ = glm::normalize(glm::cross(right_, front_));
 }
 
+// path's source and its hash: the text a reload read, the one embedded
+// with its hash at build time, or failing both the file itself
+static std::string ReadShaderSource(const std::string &path,
+                                    std::uint64_t &hash) {
+  auto loaded = shader_source.find(path);
+  if (loaded != shader_source.end()) {
+    hash = HashBytes(loaded->second.data(), loaded->second.size());
+    return loaded->second;
+  }
+  const EmbeddedShader *embedded{FindEmbeddedShader(path)};
+  if (embedded) {
+    hash = embedded->hash;
+    return std::string{embedded->source, embedded->size};
+  }
+  std::string source{PreprocessShader(path)};
+  hash = HashBytes(source.data(), source.size());
+  return source;
+}
+
+// source with defines after its #version line, numbering the lines after
+// them from 2 again
+static std::string InsertDefines(const std::string &source,
+                                 const std::string &defines) {
+  if (defines.empty()) {
+    return source;
+  }
+  std::size_t version{source.find("#version")};
+  std::size_t line_end{version == std::string::npos
+                           ? std::string::npos
+                           : source.find('\n', version)};
+  if (line_end == std::string::npos) {
+    return defines + "#line 1\n" + source;
+  }
+  return source.substr(0, line_end + 1) + defines + "#line 2\n" +
+         source.substr(line_end + 1);
+}
+
+const char kProgramFileMagic[4]{'G', 'P', 'R', 'G'};
+
+// A program cache file: this header, then size bytes of binary in format.
+struct ProgramFileHeader {
+  char magic[4];
+  std::uint32_t format;
+  std::uint64_t key;
+  std::uint64_t size;
+};
+
+ProgramCache program_cache;
+
+ProgramCache::ProgramCache()
+    : hit_{0}, miss_{0}, rejected_{0}, enabled_{false} {}
+
+void ProgramCache::Open(const std::string &directory) {
+  GLint format_count{0};
+  if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+  }
+  // a driver offering no formats would hand back nothing to store
+  enabled_ = format_count > 0;
+  if (!enabled_) {
+    return;
+  }
+  // failing because it exists is fine, and otherwise Store fails quietly
+  mkdir(directory.c_str(), 0755);
+  directory_ = directory;
+  driver_.clear();
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    const GLubyte *value{glGetString(name)};
+    driver_ += value ? reinterpret_cast<const char *>(value) : "";
+    driver_ += '\n';
+  }
+}
+
+std::uint64_t ProgramCache::Key(
+    const std::vector<std::uint64_t> &hash) const {
+  std::uint64_t key{HashBytes(driver_.data(), driver_.size())};
+  return HashBytes(hash.data(), hash.size() * sizeof(hash[0]), key);
+}
+
+std::string ProgramCache::Path(std::uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "/%016llx.bin",
+                static_cast<unsigned long long>(key));
+  return directory_ + name;
+}
+
+bool ProgramCache::Load(std::uint64_t key, unsigned program) {
+  if (!enabled_) {
+    return false;
+  }
+  MappedFile file;
+  ProgramFileHeader header;
+  if (!file.Open(Path(key)) || file.Size() < sizeof(header)) {
+    ++miss_;
+    return false;
+  }
+  std::memcpy(&header, file.Data(), sizeof(header));
+  if (std::memcmp(header.magic, kProgramFileMagic,
+                  sizeof(kProgramFileMagic)) != 0 ||
+      header.key != key || header.size != file.Size() - sizeof(header)) {
+    ++rejected_;
+    return false;
+  }
+  glProgramBinary(program, header.format, file.Data() + sizeof(header),
+                  static_cast<GLsizei>(header.size));
+  GLint linked;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    ++rejected_;
+    return false;
+  }
+  ++hit_;
+  return true;
+}
+
+void ProgramCache::Retrievable(unsigned program) const {
+  if (enabled_) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
+
+void ProgramCache::Store(std::uint64_t key, unsigned program) const {
+  if (!enabled_) {
+    return;
+  }
+  GLint length{0};
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<unsigned char> data(sizeof(ProgramFileHeader) + length);
+  GLsizei written{0};
+  GLenum format;
+  glGetProgramBinary(program, length, &written, &format,
+                     data.data() + sizeof(ProgramFileHeader));
+  ProgramFileHeader header;
+  std::memcpy(header.magic, kProgramFileMagic, sizeof(kProgramFileMagic));
+  header.format = format;
+  header.key = key;
+  header.size = static_cast<std::uint64_t>(written);
+  std::memcpy(data.data(), &header, sizeof(header));
+  data.resize(sizeof(header) + written);
+  // written in full under another name first, so no Load sees half a file
+  std::string path{Path(key)};
+  std::string temporary{path + ".tmp"};
+  std::ofstream file{temporary, std::ios::binary | std::ios::trunc};
+  if (file.write(reinterpret_cast<const char *>(data.data()),
+                 static_cast<std::streamsize>(data.size()))) {
+    file.close();
+    std::rename(temporary.c_str(), path.c_str());
+  }
+}
+
 Shader::Shader(const std::string &vertex_shader,
                const std::string &fragment_shader,
-               const std::string &geometry_shader) {
-  std::string vs_string;
-  std::string fs_string;
-  std::string gs_string;
-
-  std::ifstream vs_file{vertex_shader};
-  if (!vs_file) {
-    throw std::string{"fail to read "} + vertex_shader;
-  }
-  std::ifstream fs_file{fragment_shader};
-  if (!fs_file) {
-    throw std::string{"fail to read "} + fragment_shader;
-  }
-  std::stringstream vs_sstream;
-  std::stringstream fs_sstream;
-  vs_sstream << vs_file.rdbuf();
-  fs_sstream << fs_file.rdbuf();
-  vs_file.close();
-  fs_file.close();
-  vs_string = vs_sstream.str();
-  fs_string = fs_sstream.str();
-  if (geometry_shader != std::string{}) {
-    std::ifstream gs_file{geometry_shader};
-    if (!gs_file) {
-      throw std::string{"fail to read "} + geometry_shader;
-    }
-    std::stringstream gs_sstream;
-    gs_sstream << gs_file.rdbuf();
-    gs_file.close();
-    gs_string = gs_sstream.str();
-  }
-
-  const char *vs_source{vs_string.c_str()};
-  const char *fs_source{fs_string.c_str()};
-  unsigned int vs;
-  unsigned int fs;
-  vs = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vs, 1, &vs_source, nullptr);
-  glCompileShader(vs);
-  CheckError(vs, "vertex shaderz");
-  fs = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fs, 1, &fs_source, nullptr);
-  glCompileShader(fs);
-  CheckError(fs, "fragment shader");
-  unsigned int gs;
+               const std::string &geometry_shader,
+               const std::string &defines)
+    : file_{vertex_shader, fragment_shader},
+      defines_{defines},
+      pending_{0},
+      pending_key_{0} {
   if (geometry_shader != std::string{}) {
-    const char *gs_src{gs_string.c_str()};
-    gs = glCreateShader(GL_GEOMETRY_SHADER);
-    glShaderSource(gs, 1, &gs_src, nullptr);
-    glCompileShader(gs);
-    CheckError(gs, "geometry shader");
+    file_.push_back(geometry_shader);
   }
+  std::uint64_t key;
+  std::vector<std::string> source{Source(key)};
 
   program = glCreateProgram();
-  glAttachShader(program, vs);
-  glAttachShader(program, fs);
-  if (geometry_shader != std::string{}) {
-    glAttachShader(program, gs);
+  if (!program_cache.Load(key, program)) {
+    std::vector<unsigned> stage;
+    Build(program, source, stage);
+    int linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+      // a stage that failed to compile says why better than the link
+      const char *kStageName[]{"vertex shader", "fragment shader",
+                               "geometry shader"};
+      for (std::size_t i = 0; i < stage.size(); ++i) {
+        CheckError(stage[i], kStageName[i]);
+      }
+      CheckError(program, "program");
+    }
+    for (unsigned s : stage) {
+      glDeleteShader(s);
+    }
+    program_cache.Store(key, program);
+  }
+  ResolveUniforms();
+  BindBlocks();
+}
+
+std::vector<std::string> Shader::Source(std::uint64_t &key) const {
+  std::vector<std::string> source;
+  std::vector<std::uint64_t> hash;
+  for (const std::string &file : file_) {
+    hash.push_back(0);
+    source.push_back(
+        InsertDefines(ReadShaderSource(file, hash.back()), defines_));
+  }
+  hash.push_back(HashBytes(defines_.data(), defines_.size()));
+  key = program_cache.Key(hash);
+  return source;
+}
+
+void Shader::Build(unsigned program, const std::vector<std::string> &source,
+                   std::vector<unsigned> &stage) const {
+  const GLenum kStage[]{GL_VERTEX_SHADER, GL_FRAGMENT_SHADER,
+                        GL_GEOMETRY_SHADER};
+  stage.clear();
+  for (std::size_t i = 0; i < source.size(); ++i) {
+    const char *text{source[i].c_str()};
+    stage.push_back(glCreateShader(kStage[i]));
+    glShaderSource(stage[i], 1, &text, nullptr);
+    glCompileShader(stage[i]);
+    glAttachShader(program, stage[i]);
   }
+  program_cache.Retrievable(program);
   glLinkProgram(program);
-  CheckError(program, "program");
+}
 
-  glDeleteShader(vs);
-  glDeleteShader(fs);
-  if (geometry_shader != std::string{}) {
-    glDeleteShader(gs);
+void Shader::BindBlocks() {
+  const std::pair<const char *, unsigned> block[]{
+      {"Frame", kFrameBlockBinding}, {"Draw", kDrawBlockBinding}};
+  for (const std::pair<const char *, unsigned> &b : block) {
+    unsigned index{glGetUniformBlockIndex(program, b.first)};
+    if (index != GL_INVALID_INDEX) {
+      glUniformBlockBinding(program, index, b.second);
+    }
+  }
+}
+
+void Shader::Reload() {
+  if (pending_ != 0) {
+    // superseded; what it was built from has changed again
+    glDeleteProgram(pending_);
+    for (unsigned s : pending_stage_) {
+      glDeleteShader(s);
+    }
+    pending_stage_.clear();
+  }
+  std::vector<std::string> source{Source(pending_key_)};
+  pending_ = glCreateProgram();
+  // an edit undone is still in the cache
+  if (!program_cache.Load(pending_key_, pending_)) {
+    Build(pending_, source, pending_stage_);
+  }
+}
+
+bool Shader::FinishReload(std::string &error) {
+  if (pending_ == 0) {
+    return false;
+  }
+  if (GLEW_ARB_parallel_shader_compile) {
+    int done;
+    glGetProgramiv(pending_, GL_COMPLETION_STATUS_ARB, &done);
+    if (!done) {
+      return false;
+    }
+  }
+  unsigned built{pending_};
+  pending_ = 0;
+  int linked;
+  glGetProgramiv(built, GL_LINK_STATUS, &linked);
+  error.clear();
+  if (!linked) {
+    const char *kStageName[]{"vertex shader", "fragment shader",
+                             "geometry shader"};
+    try {
+      for (std::size_t i = 0; i < pending_stage_.size(); ++i) {
+        CheckError(pending_stage_[i], kStageName[i]);
+      }
+      CheckError(built, "program");
+    } catch (const std::string &e) {
+      error = e;
+    }
+  }
+  for (unsigned s : pending_stage_) {
+    glDeleteShader(s);
+  }
+  if (!linked) {
+    glDeleteProgram(built);
+    pending_stage_.clear();
+    return true;
   }
+  if (!pending_stage_.empty()) {
+    program_cache.Store(pending_key_, built);
+  }
+  pending_stage_.clear();
+  glDeleteProgram(program);
+  program = built;
+  ResolveUniforms();
+  BindBlocks();
+  UseProgram();
+  if (setup_) {
+    setup_(*this);
+  }
+  return true;
 }
 
 void Shader::UseProgram() { glUseProgram(program); }
 
-void Shader::SetBool(const std::string &name, bool value) const {
-  glUniform1i(glGetUniformLocation(program, name.c_str()),
-              static_cast<int>(value));
+void Shader::SetBool(Uniform uniform, bool value) const {
+  glUniform1i(Location(uniform), static_cast<int>(value));
+}
+void Shader::SetInt(Uniform uniform, int value) const {
+  glUniform1i(Location(uniform), value);
 }
-void Shader::SetInt(const std::string &name, int value) const {
-  glUniform1i(glGetUniformLocation(program, name.c_str()), value);
+void Shader::SetFloat(Uniform uniform, float value) const {
+  glUniform1f(Location(uniform), value);
 }
-void Shader::SetFloat(const std::string &name, float value) const {
-  glUniform1f(glGetUniformLocation(program, name.c_str()), value);
+void Shader::SetVec2(Uniform uniform, const glm::vec2 &value) const {
+  glUniform2fv(Location(uniform), 1, &value[0]);
 }
-void Shader::SetVec2(const std::string &name, const glm::vec2 &value) const {
-  glUniform2fv(glGetUniformLocation(program, name.c_str()), 1, &value[0]);
+void Shader::SetVec2(Uniform uniform, float x, float y) const {
+  glUniform2f(Location(uniform), x, y);
 }
-void Shader::SetVec2(const std::string &name, float x, float y) const {
-  glUniform2f(glGetUniformLocation(program, name.c_str()), x, y);
+void Shader::SetVec3(Uniform uniform, const glm::vec3 &value) const {
+  glUniform3fv(Location(uniform), 1, &value[0]);
 }
-void Shader::SetVec3(const std::string &name, const glm::vec3 &value) const {
-  glUniform3fv(glGetUniformLocation(program, name.c_str()), 1, &value[0]);
+void Shader::SetVec3(Uniform uniform, float x, float y, float z) const {
+  glUniform3f(Location(uniform), x, y, z);
 }
-void Shader::SetVec3(const std::string &name, float x, float y, float z) const {
-  glUniform3f(glGetUniformLocation(program, name.c_str()), x, y, z);
+void Shader::SetVec3(Uniform uniform, const glm::vec3 *value,
+                     int count) const {
+  glUniform3fv(Location(uniform), count, &value[0][0]);
 }
-void Shader::SetVec4(const std::string &name, const glm::vec4 &value) const {
-  glUniform4fv(glGetUniformLocation(program, name.c_str()), 1, &value[0]);
+void Shader::SetVec4(Uniform uniform, const glm::vec4 &value) const {
+  glUniform4fv(Location(uniform), 1, &value[0]);
 }
-void Shader::SetVec4(const std::string &name, float x, float y, float z,
-                     float w) {
-  glUniform4f(glGetUniformLocation(program, name.c_str()), x, y, z, w);
+void Shader::SetVec4(Uniform uniform, float x, float y, float z,
+                     float w) const {
+  glUniform4f(Location(uniform), x, y, z, w);
 }
-void Shader::SetMat2(const std::string &name, const glm::mat2 &value) const {
-  glUniformMatrix2fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE,
-                     &value[0][0]);
+void Shader::SetMat2(Uniform uniform, const glm::mat2 &value) const {
+  glUniformMatrix2fv(Location(uniform), 1, GL_FALSE, &value[0][0]);
 }
-void Shader::SetMat3(const std::string &name, const glm::mat3 &value) const {
-  glUniformMatrix3fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE,
-                     &value[0][0]);
+void Shader::SetMat3(Uniform uniform, const glm::mat3 &value) const {
+  glUniformMatrix3fv(Location(uniform), 1, GL_FALSE, &value[0][0]);
 }
-void Shader::SetMat4(const std::string &name, const glm::mat4 &value) const {
-  glUniformMatrix4fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE,
-                     &value[0][0]);
+void Shader::SetMat4(Uniform uniform, const glm::mat4 &value) const {
+  glUniformMatrix4fv(Location(uniform), 1, GL_FALSE, &value[0][0]);
+}
+
+int Shader::Location(Uniform uniform) const {
+  auto found = std::lower_bound(
+      location_.begin(), location_.end(),
+      std::make_pair(uniform.key, std::numeric_limits<int>::min()));
+  return found != location_.end() && found->first == uniform.key
+             ? found->second
+             : -1;
+}
+
+void Shader::ResolveUniforms() {
+  location_.clear();
+  int count;
+  int max_length;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+  std::vector<char> name(std::max(max_length, 1));
+  for (int u = 0; u < count; ++u) {
+    int size;
+    GLenum type;
+    glGetActiveUniform(program, static_cast<GLuint>(u),
+                       static_cast<GLsizei>(name.size()), nullptr, &size,
+                       &type, name.data());
+    std::string uniform{name.data()};
+    int location{glGetUniformLocation(program, uniform.c_str())};
+    // uniforms in blocks have no location of their own
+    if (location < 0) {
+      continue;
+    }
+    location_.push_back(
+        std::make_pair(HashString(uniform.c_str()), location));
+    const std::string kFirst{"[0]"};
+    if (uniform.size() > kFirst.size() &&
+        uniform.compare(uniform.size() - kFirst.size(), kFirst.size(),
+                        kFirst) == 0) {
+      std::string array{uniform.substr(0, uniform.size() - kFirst.size())};
+      location_.push_back(
+          std::make_pair(HashString(array.c_str()), location));
+      for (int i = 1; i < size; ++i) {
+        std::string element{array + "[" + std::to_string(i) + "]"};
+        location_.push_back(
+            std::make_pair(HashString(element.c_str()),
+                           glGetUniformLocation(program, element.c_str())));
+      }
+    }
+  }
+  std::sort(location_.begin(), location_.end());
+  for (std::size_t i = 1; i < location_.size(); ++i) {
+    if (location_[i].first == location_[i - 1].first) {
+      throw std::string{"two uniforms hash alike"};
+    }
+  }
 }
 
 void Shader::CheckError(unsigned int shader, const std::string &type) {
@@ -568,4 +2166,153 @@ void Shader::CheckError(unsigned int shader, const std::string &type) {
   }
 }
 
-};  // namespace graphics
\ No newline at end of file
+std::string ShaderDefines(unsigned key) {
+  struct Feature {
+    unsigned bit;
+    const char *define;
+  };
+  const Feature kFeature[]{{kShaderPunctualLight, "PUNCTUAL_LIGHT"},
+                           {kShaderImageBasedLight, "IMAGE_BASED_LIGHT"}};
+  std::string defines;
+  for (const Feature &feature : kFeature) {
+    if (key & feature.bit) {
+      defines += std::string{"#define "} + feature.define + "\n";
+    }
+  }
+  defines += "#define LIGHT_COUNT " +
+             std::to_string((key & kShaderLightCountMask) >>
+                            kShaderLightCountShift) +
+             "\n";
+  return defines;
+}
+
+ShaderVariants::ShaderVariants(const std::string &vertex_shader,
+                               const std::string &fragment_shader,
+                               std::function<void(Shader &)> setup)
+    : vertex_shader_{vertex_shader},
+      fragment_shader_{fragment_shader},
+      setup_{std::move(setup)} {}
+
+Shader &ShaderVariants::Get(unsigned key) {
+  auto found = variant_.find(key);
+  if (found != variant_.end()) {
+    return found->second;
+  }
+  auto start = std::chrono::steady_clock::now();
+  Shader &shader{
+      variant_
+          .emplace(key, Shader{vertex_shader_, fragment_shader_,
+                               std::string{}, ShaderDefines(key)})
+          .first->second};
+  shader.setup_ = setup_;
+  shader.UseProgram();
+  setup_(shader);
+  std::chrono::duration<double, std::milli> time{
+      std::chrono::steady_clock::now() - start};
+  std::cout << "compiled " << fragment_shader_ << " variant " << key
+            << " in " << time.count() << " ms" << std::endl;
+  return shader;
+}
+
+void ShaderVariants::Shaders(std::vector<Shader *> &shader) {
+  for (std::pair<const unsigned, Shader> &variant : variant_) {
+    shader.push_back(&variant.second);
+  }
+}
+
+ShaderReloader::ShaderReloader() : reload_count_{0} {}
+
+void ShaderReloader::WatchFiles(const std::vector<std::string> &file) {
+  if (shader_.empty() && variants_.empty()) {
+    if (GLEW_ARB_parallel_shader_compile) {
+      // as many compiler threads as the driver likes
+      glMaxShaderCompilerThreadsARB(0xffffffffu);
+    }
+    // any of them may be included by a watched file
+    std::size_t count;
+    const EmbeddedShader *embedded{EmbeddedShaders(count)};
+    for (std::size_t i = 0; i < count; ++i) {
+      watched_.push_back(embedded[i].name);
+      watcher_.Add(embedded[i].name);
+    }
+  }
+  for (const std::string &path : file) {
+    if (std::find(watched_.begin(), watched_.end(), path) ==
+        watched_.end()) {
+      watched_.push_back(path);
+      watcher_.Add(path);
+    }
+  }
+}
+
+void ShaderReloader::Watch(Shader &shader) {
+  WatchFiles(shader.Files());
+  shader_.push_back(&shader);
+}
+
+void ShaderReloader::Watch(ShaderVariants &variants) {
+  WatchFiles(variants.Files());
+  variants_.push_back(&variants);
+}
+
+void ShaderReloader::Update() {
+  std::vector<Shader *> shader{shader_};
+  for (ShaderVariants *variants : variants_) {
+    variants->Shaders(shader);
+  }
+  std::vector<std::string> changed;
+  watcher_.Poll(changed);
+  if (!changed.empty()) {
+    error_.clear();
+    std::vector<std::string> stage;
+    for (Shader *s : shader_) {
+      stage.insert(stage.end(), s->Files().begin(), s->Files().end());
+    }
+    for (ShaderVariants *variants : variants_) {
+      std::vector<std::string> file{variants->Files()};
+      stage.insert(stage.end(), file.begin(), file.end());
+    }
+    std::sort(stage.begin(), stage.end());
+    stage.erase(std::unique(stage.begin(), stage.end()), stage.end());
+    // what changed may be included anywhere, so every stage is read again
+    // and only those that come out different count as changed
+    changed.clear();
+    for (const std::string &path : stage) {
+      try {
+        std::string source{PreprocessShader(path)};
+        std::uint64_t hash;
+        if (source != ReadShaderSource(path, hash)) {
+          shader_source[path] = source;
+          changed.push_back(path);
+        }
+      } catch (const std::string &e) {
+        error_ += e + "\n";
+      }
+    }
+    for (Shader *s : shader) {
+      for (const std::string &path : changed) {
+        const std::vector<std::string> &file{s->Files()};
+        if (std::find(file.begin(), file.end(), path) != file.end()) {
+          s->Reload();
+          break;
+        }
+      }
+    }
+  }
+  for (Shader *s : shader) {
+    std::string error;
+    if (s->FinishReload(error)) {
+      if (error.empty()) {
+        ++reload_count_;
+      } else {
+        // every variant of a program fails alike
+        std::string line{s->Files()[1] + ": " + error};
+        if (error_.find(line) == std::string::npos) {
+          error_ += line;
+        }
+      }
+    }
+  }
+}
+
+};  // namespace graphics
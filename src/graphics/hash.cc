@@ -0,0 +1,28 @@
+#include "graphics/hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace graphics {
+
+std::uint64_t HashBytes(const void *data, std::size_t size,
+                        std::uint64_t seed) {
+  const unsigned char *byte{static_cast<const unsigned char *>(data)};
+  const std::uint64_t kPrime{1099511628211ull};
+  std::uint64_t hash{seed ^ size};
+  for (; size >= 8; size -= 8, byte += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, byte, 8);
+    hash = (hash ^ word) * kPrime;
+    hash ^= hash >> 29;
+  }
+  for (; size > 0; --size, ++byte) {
+    hash = (hash ^ *byte) * kPrime;
+  }
+  hash ^= hash >> 32;
+  hash *= kPrime;
+  return hash ^ (hash >> 29);
+}
+
+};  // namespace graphics
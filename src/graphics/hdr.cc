@@ -0,0 +1,208 @@
+#include "graphics/hdr.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace graphics {
+
+HdrReader::HdrReader(const std::string &path)
+    : width_{0},
+      height_{0},
+      path_{path},
+      file_{std::fopen(path.c_str(), "rb"), std::fclose},
+      buffer_(1 << 16),
+      data_{buffer_.data()},
+      buffer_position_{0},
+      buffer_size_{0},
+      row_{0} {
+  if (!file_) {
+    throw std::string{"fail to read "} + path;
+  }
+  ReadHeader();
+}
+
+HdrReader::HdrReader(const std::string &path, const unsigned char *data,
+                     std::size_t size)
+    : width_{0},
+      height_{0},
+      path_{path},
+      file_{nullptr, std::fclose},
+      data_{data},
+      buffer_position_{0},
+      buffer_size_{size},
+      row_{0} {
+  ReadHeader();
+}
+
+void HdrReader::ReadHeader() {
+  std::string line{GetLine()};
+  if (line != "#?RADIANCE" && line != "#?RGBE") {
+    Fail("not a radiance hdr");
+  }
+  bool valid{false};
+  for (line = GetLine(); !line.empty(); line = GetLine()) {
+    if (line == "FORMAT=32-bit_rle_rgbe") {
+      valid = true;
+    }
+  }
+  if (!valid) {
+    Fail("unsupported format");
+  }
+
+  line = GetLine();
+  char *token{&line[0]};
+  if (std::strncmp(token, "-Y ", 3) != 0) {
+    Fail("unsupported data layout");
+  }
+  height_ = std::strtol(token + 3, &token, 10);
+  while (*token == ' ') {
+    ++token;
+  }
+  if (std::strncmp(token, "+X ", 3) != 0) {
+    Fail("unsupported data layout");
+  }
+  width_ = std::strtol(token + 3, nullptr, 10);
+  if (width_ <= 0 || height_ <= 0 || width_ > (1 << 24) ||
+      height_ > (1 << 24)) {
+    Fail("invalid size");
+  }
+  rgbe_.resize(static_cast<std::size_t>(width_) * 4);
+}
+
+bool HdrReader::ReadRow(float *rgb) {
+  if (row_ == height_) {
+    return false;
+  }
+
+  unsigned char *rgbe{rgbe_.data()};
+  int start{0};
+  if (width_ >= 8 && width_ < 32768) {
+    int c1{GetByte()};
+    int c2{GetByte()};
+    int length{GetByte()};
+    if (c1 == 2 && c2 == 2 && !(length & 0x80)) {
+      length = (length << 8) | GetByte();
+      if (length != width_) {
+        Fail("invalid decoded scanline length");
+      }
+      for (int k = 0; k < 4; ++k) {
+        for (int i = 0; i < width_;) {
+          int count{GetByte()};
+          if (count > 128) {
+            count -= 128;
+            if (count > width_ - i) {
+              Fail("bad rle data");
+            }
+            unsigned char value{static_cast<unsigned char>(GetByte())};
+            for (; count > 0; --count) {
+              rgbe[i++ * 4 + k] = value;
+            }
+          } else {
+            if (count > width_ - i) {
+              Fail("bad rle data");
+            }
+            for (; count > 0; --count) {
+              rgbe[i++ * 4 + k] = static_cast<unsigned char>(GetByte());
+            }
+          }
+        }
+      }
+      start = width_;
+    } else {
+      // a flat scanline; the bytes just read are its first pixel
+      rgbe[0] = static_cast<unsigned char>(c1);
+      rgbe[1] = static_cast<unsigned char>(c2);
+      rgbe[2] = static_cast<unsigned char>(length);
+      rgbe[3] = static_cast<unsigned char>(GetByte());
+      start = 1;
+    }
+  }
+  for (int i = start * 4; i < width_ * 4; ++i) {
+    rgbe[i] = static_cast<unsigned char>(GetByte());
+  }
+
+  for (int i = 0; i < width_; ++i, rgbe += 4, rgb += 3) {
+    if (rgbe[3] != 0) {
+      float scale{std::ldexp(1.0f, rgbe[3] - (128 + 8))};
+      rgb[0] = rgbe[0] * scale;
+      rgb[1] = rgbe[1] * scale;
+      rgb[2] = rgbe[2] * scale;
+    } else {
+      rgb[0] = rgb[1] = rgb[2] = 0.0f;
+    }
+  }
+  ++row_;
+  return true;
+}
+
+int HdrReader::GetByte() {
+  if (buffer_position_ == buffer_size_) {
+    if (!file_) {
+      Fail("unexpected end of file");
+    }
+    buffer_size_ = std::fread(buffer_.data(), 1, buffer_.size(), file_.get());
+    buffer_position_ = 0;
+    if (buffer_size_ == 0) {
+      Fail("unexpected end of file");
+    }
+  }
+  return data_[buffer_position_++];
+}
+
+std::string HdrReader::GetLine() {
+  std::string line;
+  for (int c = GetByte(); c != '\n'; c = GetByte()) {
+    line.push_back(static_cast<char>(c));
+    if (line.size() > 1024) {
+      Fail("header line too long");
+    }
+  }
+  return line;
+}
+
+void HdrReader::Fail(const std::string &reason) {
+  throw reason + " in " + path_;
+}
+
+void DownsampleHdr(
+    HdrReader &reader, int max_width, int &width, int &height,
+    const std::function<void(int y, const float *rgb)> &row_callback) {
+  int factor{(reader.width_ + max_width - 1) / max_width};
+  if (factor < 1) {
+    factor = 1;
+  }
+  width = reader.width_ / factor;
+  height = std::max(reader.height_ / factor, 1);
+  int row_count{std::min(factor, reader.height_)};
+
+  std::vector<float> row(static_cast<std::size_t>(reader.width_) * 3);
+  std::vector<float> sum(static_cast<std::size_t>(width) * 3);
+  float weight{1.0f / (factor * row_count)};
+  for (int y = 0; y < height; ++y) {
+    std::fill(sum.begin(), sum.end(), 0.0f);
+    for (int r = 0; r < row_count; ++r) {
+      reader.ReadRow(row.data());
+      const float *texel{row.data()};
+      float *out{sum.data()};
+      for (int x = 0; x < width; ++x, out += 3) {
+        for (int f = 0; f < factor; ++f, texel += 3) {
+          out[0] += texel[0];
+          out[1] += texel[1];
+          out[2] += texel[2];
+        }
+      }
+    }
+    if (factor > 1) {
+      for (float &value : sum) {
+        value *= weight;
+      }
+    }
+    row_callback(y, sum.data());
+  }
+}
+
+};  // namespace graphics
@@ -0,0 +1,325 @@
+#include "graphics/json.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace graphics {
+
+JsonReader::JsonReader(const char *data, std::size_t size)
+    : data_{data}, end_{data + size}, cursor_{data} {}
+
+void JsonReader::SkipSpace() {
+  while (cursor_ != end_ && (*cursor_ == ' ' || *cursor_ == '\t' ||
+                             *cursor_ == '\n' || *cursor_ == '\r')) {
+    ++cursor_;
+  }
+}
+
+char JsonReader::Next() {
+  SkipSpace();
+  if (cursor_ == end_) {
+    Fail("unexpected end");
+  }
+  return *cursor_;
+}
+
+void JsonReader::Expect(char c) {
+  if (Next() != c) {
+    Fail(std::string{"expected '"} + c + "'");
+  }
+  ++cursor_;
+}
+
+void JsonReader::Fail(const std::string &what) const {
+  throw "json: " + what + " at offset " + std::to_string(cursor_ - data_);
+}
+
+JsonReader::Type JsonReader::Peek() {
+  switch (Next()) {
+    case '{':
+      return kObject;
+    case '[':
+      return kArray;
+    case '"':
+      return kString;
+    case 't':
+    case 'f':
+      return kBool;
+    case 'n':
+      return kNull;
+    default:
+      return kNumber;
+  }
+}
+
+void JsonReader::BeginObject() {
+  Expect('{');
+  first_.push_back(true);
+}
+
+bool JsonReader::NextMember(std::string &key) {
+  if (first_.empty()) {
+    Fail("no open object");
+  }
+  if (Next() == '}') {
+    ++cursor_;
+    first_.pop_back();
+    return false;
+  }
+  if (!first_.back()) {
+    Expect(',');
+  }
+  first_.back() = false;
+  ReadString(key);
+  Expect(':');
+  return true;
+}
+
+void JsonReader::BeginArray() {
+  Expect('[');
+  first_.push_back(true);
+}
+
+bool JsonReader::NextElement() {
+  if (first_.empty()) {
+    Fail("no open array");
+  }
+  if (Next() == ']') {
+    ++cursor_;
+    first_.pop_back();
+    return false;
+  }
+  if (!first_.back()) {
+    Expect(',');
+  }
+  first_.back() = false;
+  return true;
+}
+
+double JsonReader::ReadNumber() {
+  SkipSpace();
+  const char *start{cursor_};
+  auto digits = [&] {
+    const char *first{cursor_};
+    while (cursor_ != end_ && *cursor_ >= '0' && *cursor_ <= '9') {
+      ++cursor_;
+    }
+    return cursor_ != first;
+  };
+  if (cursor_ != end_ && *cursor_ == '-') {
+    ++cursor_;
+  }
+  bool valid{digits()};
+  if (valid && cursor_ != end_ && *cursor_ == '.') {
+    ++cursor_;
+    valid = digits();
+  }
+  if (valid && cursor_ != end_ && (*cursor_ == 'e' || *cursor_ == 'E')) {
+    ++cursor_;
+    if (cursor_ != end_ && (*cursor_ == '+' || *cursor_ == '-')) {
+      ++cursor_;
+    }
+    valid = digits();
+  }
+  if (!valid) {
+    cursor_ = start;
+    Fail("expected a number");
+  }
+  // strtod wants a terminated string and the input is not
+  char buffer[64];
+  std::size_t length{static_cast<std::size_t>(cursor_ - start)};
+  if (length >= sizeof(buffer)) {
+    return std::strtod(std::string{start, length}.c_str(), nullptr);
+  }
+  std::memcpy(buffer, start, length);
+  buffer[length] = '\0';
+  return std::strtod(buffer, nullptr);
+}
+
+bool JsonReader::ReadBool() {
+  SkipSpace();
+  std::size_t left{static_cast<std::size_t>(end_ - cursor_)};
+  if (left >= 4 && std::memcmp(cursor_, "true", 4) == 0) {
+    cursor_ += 4;
+    return true;
+  }
+  if (left >= 5 && std::memcmp(cursor_, "false", 5) == 0) {
+    cursor_ += 5;
+    return false;
+  }
+  Fail("expected true or false");
+  return false;
+}
+
+static void AppendUtf8(unsigned code, std::string &value) {
+  if (code < 0x80) {
+    value += static_cast<char>(code);
+  } else if (code < 0x800) {
+    value += static_cast<char>(0xc0 | code >> 6);
+    value += static_cast<char>(0x80 | (code & 0x3f));
+  } else if (code < 0x10000) {
+    value += static_cast<char>(0xe0 | code >> 12);
+    value += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+    value += static_cast<char>(0x80 | (code & 0x3f));
+  } else {
+    value += static_cast<char>(0xf0 | code >> 18);
+    value += static_cast<char>(0x80 | (code >> 12 & 0x3f));
+    value += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+    value += static_cast<char>(0x80 | (code & 0x3f));
+  }
+}
+
+void JsonReader::ReadString(std::string &value) {
+  Expect('"');
+  value.clear();
+  auto hex = [&] {
+    if (end_ - cursor_ < 4) {
+      Fail("short \\u escape");
+    }
+    unsigned code{0};
+    for (int i = 0; i < 4; ++i) {
+      char c{*cursor_++};
+      code <<= 4;
+      if (c >= '0' && c <= '9') {
+        code |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        code |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        code |= c - 'A' + 10;
+      } else {
+        Fail("bad \\u escape");
+      }
+    }
+    return code;
+  };
+  for (;;) {
+    // copy plain runs whole
+    const char *run{cursor_};
+    while (cursor_ != end_ && *cursor_ != '"' && *cursor_ != '\\' &&
+           static_cast<unsigned char>(*cursor_) >= 0x20) {
+      ++cursor_;
+    }
+    value.append(run, cursor_);
+    if (cursor_ == end_) {
+      Fail("unterminated string");
+    }
+    char c{*cursor_++};
+    if (c == '"') {
+      return;
+    }
+    if (c != '\\' || cursor_ == end_) {
+      Fail("bad character in string");
+    }
+    switch (*cursor_++) {
+      case '"':
+        value += '"';
+        break;
+      case '\\':
+        value += '\\';
+        break;
+      case '/':
+        value += '/';
+        break;
+      case 'b':
+        value += '\b';
+        break;
+      case 'f':
+        value += '\f';
+        break;
+      case 'n':
+        value += '\n';
+        break;
+      case 'r':
+        value += '\r';
+        break;
+      case 't':
+        value += '\t';
+        break;
+      case 'u': {
+        unsigned code{hex()};
+        if (code >= 0xd800 && code < 0xdc00 && end_ - cursor_ >= 6 &&
+            cursor_[0] == '\\' && cursor_[1] == 'u') {
+          cursor_ += 2;
+          unsigned low{hex()};
+          if (low < 0xdc00 || low >= 0xe000) {
+            Fail("unpaired surrogate");
+          }
+          code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+        }
+        AppendUtf8(code, value);
+        break;
+      }
+      default:
+        Fail("bad escape");
+    }
+  }
+}
+
+std::string JsonReader::ReadString() {
+  std::string value;
+  ReadString(value);
+  return value;
+}
+
+void JsonReader::Skip() {
+  // scans to the end of the value without interpreting it, tracking only
+  // the bracket depth
+  std::size_t depth{0};
+  do {
+    switch (Next()) {
+      case '{':
+      case '[':
+        ++cursor_;
+        ++depth;
+        break;
+      case '}':
+      case ']':
+        if (depth == 0) {
+          Fail("unexpected close");
+        }
+        ++cursor_;
+        --depth;
+        break;
+      case ',':
+      case ':':
+        if (depth == 0) {
+          Fail("unexpected separator");
+        }
+        ++cursor_;
+        break;
+      case '"':
+        ++cursor_;
+        while (cursor_ < end_ && *cursor_ != '"') {
+          cursor_ += *cursor_ == '\\' ? 2 : 1;
+        }
+        if (cursor_ >= end_) {
+          cursor_ = end_;
+          Fail("unterminated string");
+        }
+        ++cursor_;
+        break;
+      case 't':
+      case 'f':
+        ReadBool();
+        break;
+      case 'n':
+        if (end_ - cursor_ < 4 || std::memcmp(cursor_, "null", 4) != 0) {
+          Fail("expected null");
+        }
+        cursor_ += 4;
+        break;
+      default:
+        ReadNumber();
+    }
+  } while (depth != 0);
+}
+
+void JsonReader::End() {
+  SkipSpace();
+  if (cursor_ != end_ || !first_.empty()) {
+    Fail("trailing data");
+  }
+}
+
+};  // namespace graphics
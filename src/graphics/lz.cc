@@ -0,0 +1,372 @@
+#include "graphics/lz.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace graphics {
+
+const std::size_t kMinMatch{4};
+// the format keeps the last 5 bytes literal and starts no match within 12
+// bytes of the end, which is what lets the decoder copy in wide strides
+const std::size_t kLastLiterals{5};
+const std::size_t kMatchStartLimit{12};
+const std::size_t kMaxOffset{65535};
+const int kHashBits{14};
+
+static std::uint32_t Load32(const unsigned char *p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static std::uint64_t Load64(const unsigned char *p) {
+  std::uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// Hashes the 5 bytes at p, which spreads texel data with a constant channel
+// far better than hashing only the 4 that must match.
+static std::uint32_t Hash(const unsigned char *p) {
+  return static_cast<std::uint32_t>(((Load64(p) << 24) * 889523592379ull) >>
+                                    (64 - kHashBits));
+}
+
+static unsigned char *WriteLength(unsigned char *out, std::size_t length) {
+  for (; length >= 255; length -= 255) {
+    *out++ = 255;
+  }
+  *out++ = static_cast<unsigned char>(length);
+  return out;
+}
+
+static bool ReadLength(const unsigned char *&in, const unsigned char *end,
+                       std::size_t &length) {
+  unsigned byte;
+  do {
+    if (in == end) {
+      return false;
+    }
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// Emits one sequence: the literals from anchor up to match, then a match
+// of match_length bytes at offset, or no match if match_length is 0.
+static unsigned char *WriteSequence(unsigned char *out,
+                                    const unsigned char *anchor,
+                                    std::size_t literal_length,
+                                    std::size_t offset,
+                                    std::size_t match_length) {
+  unsigned char *token{out++};
+  if (literal_length >= 15) {
+    *token = 15 << 4;
+    out = WriteLength(out, literal_length - 15);
+  } else {
+    *token = static_cast<unsigned char>(literal_length << 4);
+  }
+  if (literal_length > 0) {
+    std::memcpy(out, anchor, literal_length);
+    out += literal_length;
+  }
+  if (match_length == 0) {
+    return out;
+  }
+  *out++ = static_cast<unsigned char>(offset);
+  *out++ = static_cast<unsigned char>(offset >> 8);
+  match_length -= kMinMatch;
+  if (match_length >= 15) {
+    *token |= 15;
+    out = WriteLength(out, match_length - 15);
+  } else {
+    *token |= static_cast<unsigned char>(match_length);
+  }
+  return out;
+}
+
+std::size_t LzCompressBound(std::size_t size) {
+  return size + size / 255 + 16;
+}
+
+std::size_t LzCompress(const unsigned char *data, std::size_t size,
+                       unsigned char *out) {
+  unsigned char *op{out};
+  const unsigned char *anchor{data};
+  const unsigned char *end{data + size};
+  if (size > kMatchStartLimit) {
+    std::uint32_t table[1 << kHashBits];
+    std::fill(table, table + (1 << kHashBits), 0);
+    const unsigned char *match_start_limit{end - kMatchStartLimit};
+    const unsigned char *match_end_limit{end - kLastLiterals};
+    const unsigned char *ip{data + 1};
+    while (ip <= match_start_limit) {
+      std::uint32_t sequence{Load32(ip)};
+      std::uint32_t hash{Hash(ip)};
+      const unsigned char *match{data + table[hash]};
+      table[hash] = static_cast<std::uint32_t>(ip - data);
+      if (static_cast<std::size_t>(ip - match) > kMaxOffset ||
+          Load32(match) != sequence) {
+        // step faster through data that keeps failing to match
+        ip += 1 + ((ip - anchor) >> 6);
+        continue;
+      }
+
+      while (ip > anchor && match > data && ip[-1] == match[-1]) {
+        --ip;
+        --match;
+      }
+      std::size_t length{kMinMatch};
+      for (;;) {
+        if (ip + length + 8 > match_end_limit) {
+          while (ip + length < match_end_limit && ip[length] == match[length]) {
+            ++length;
+          }
+          break;
+        }
+        std::uint64_t difference{Load64(ip + length) ^ Load64(match + length)};
+        if (difference != 0) {
+          // the first differing byte, on a little-endian target
+          length += __builtin_ctzll(difference) >> 3;
+          break;
+        }
+        length += 8;
+      }
+
+      op = WriteSequence(op, anchor, ip - anchor, ip - match, length);
+      ip += length;
+      anchor = ip;
+      if (ip <= match_start_limit) {
+        table[Hash(ip - 2)] = static_cast<std::uint32_t>(ip - 2 - data);
+      }
+    }
+  }
+  op = WriteSequence(op, anchor, end - anchor, 0, 0);
+  return op - out;
+}
+
+bool LzDecompress(const unsigned char *data, std::size_t size,
+                  unsigned char *out, std::size_t out_size) {
+  const unsigned char *ip{data};
+  const unsigned char *ip_end{data + size};
+  unsigned char *op{out};
+  unsigned char *op_end{out + out_size};
+  for (;;) {
+    if (ip == ip_end) {
+      return false;
+    }
+    unsigned token{*ip++};
+
+    std::size_t literal_length{token >> 4};
+    std::size_t in_left{static_cast<std::size_t>(ip_end - ip)};
+    std::size_t out_left{static_cast<std::size_t>(op_end - op)};
+    if (literal_length < 15 && in_left >= 18 && out_left >= 32) {
+      // the common short sequence, far from either end: one fixed copy,
+      // and the offset is known to follow
+      std::memcpy(op, ip, 16);
+      ip += literal_length;
+      op += literal_length;
+    } else {
+      if (literal_length == 15 && !ReadLength(ip, ip_end, literal_length)) {
+        return false;
+      }
+      in_left = static_cast<std::size_t>(ip_end - ip);
+      if (literal_length > in_left || literal_length > out_left) {
+        return false;
+      }
+      if (in_left >= literal_length + 16 && out_left >= literal_length + 16) {
+        for (std::size_t i = 0; i < literal_length; i += 16) {
+          std::memcpy(op + i, ip + i, 16);
+        }
+      } else if (literal_length > 0) {
+        std::memcpy(op, ip, literal_length);
+      }
+      ip += literal_length;
+      op += literal_length;
+      if (ip == ip_end) {
+        return op == op_end;
+      }
+      if (ip_end - ip < 2) {
+        return false;
+      }
+    }
+
+    std::size_t offset{static_cast<std::size_t>(ip[0] | (ip[1] << 8))};
+    ip += 2;
+    if (offset == 0 || offset > static_cast<std::size_t>(op - out)) {
+      return false;
+    }
+    std::size_t match_length{token & 15u};
+    out_left = static_cast<std::size_t>(op_end - op);
+    if (match_length < 15 && offset >= 8 && out_left >= 18) {
+      // at most 18 bytes, copied in fixed strides
+      const unsigned char *match{op - offset};
+      std::memcpy(op, match, 8);
+      std::memcpy(op + 8, match + 8, 8);
+      std::memcpy(op + 16, match + 16, 2);
+      op += match_length + kMinMatch;
+      continue;
+    }
+    if (match_length == 15 && !ReadLength(ip, ip_end, match_length)) {
+      return false;
+    }
+    match_length += kMinMatch;
+    if (match_length > out_left) {
+      return false;
+    }
+    const unsigned char *match{op - offset};
+    if (offset >= 8 && out_left >= match_length + 8) {
+      // each stride reads only bytes already written
+      for (std::size_t i = 0; i < match_length; i += 8) {
+        std::memcpy(op + i, match + i, 8);
+      }
+    } else if (offset == 1) {
+      std::memset(op, *match, match_length);
+    } else if (out_left >= match_length + 8) {
+      // a short repeat: lay down enough bytes by hand that a whole number of
+      // periods spans 8, then copy strides from that many periods back
+      std::size_t period{offset * ((8 + offset - 1) / offset)};
+      std::size_t i{0};
+      for (; i < period - offset; ++i) {
+        op[i] = match[i];
+      }
+      for (; i < match_length; i += 8) {
+        std::memcpy(op + i, op + i - period, 8);
+      }
+    } else {
+      for (std::size_t i = 0; i < match_length; ++i) {
+        op[i] = match[i];
+      }
+    }
+    op += match_length;
+  }
+}
+
+std::vector<unsigned char> LzCompressBlocks(const unsigned char *data,
+                                            std::size_t size,
+                                            std::size_t block_size) {
+  std::size_t block_count{(size + block_size - 1) / block_size};
+  LzHeader header;
+  std::memcpy(header.magic, kLzMagic, sizeof(kLzMagic));
+  header.block_size = static_cast<std::uint32_t>(block_size);
+  header.size = size;
+  std::size_t table_offset{sizeof(header)};
+  std::size_t data_offset{table_offset + block_count * sizeof(std::uint32_t)};
+  std::vector<unsigned char> stream(data_offset);
+  std::memcpy(stream.data(), &header, sizeof(header));
+
+  std::vector<unsigned char> block(LzCompressBound(block_size));
+  for (std::size_t b = 0; b < block_count; ++b) {
+    const unsigned char *raw{data + b * block_size};
+    std::size_t raw_size{std::min(block_size, size - b * block_size)};
+    std::size_t compressed_size{LzCompress(raw, raw_size, block.data())};
+    std::uint32_t flag{0};
+    if (compressed_size >= raw_size) {
+      stream.insert(stream.end(), raw, raw + raw_size);
+      flag = kLzStoredBlock;
+    } else {
+      stream.insert(stream.end(), block.data(),
+                    block.data() + compressed_size);
+    }
+    std::size_t block_end{stream.size() - data_offset};
+    if (block_end >= kLzStoredBlock) {
+      throw std::string{"lz stream too large"};
+    }
+    std::uint32_t entry{static_cast<std::uint32_t>(block_end) | flag};
+    std::memcpy(&stream[table_offset + b * sizeof(entry)], &entry,
+                sizeof(entry));
+  }
+  return stream;
+}
+
+bool LzStreamInfo(const unsigned char *stream, std::size_t size,
+                  std::size_t &raw_size, std::size_t &block_count) {
+  LzHeader header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, stream, sizeof(header));
+  if (std::memcmp(header.magic, kLzMagic, sizeof(kLzMagic)) != 0 ||
+      header.block_size == 0) {
+    return false;
+  }
+  raw_size = static_cast<std::size_t>(header.size);
+  block_count = (raw_size + header.block_size - 1) / header.block_size;
+  std::size_t data_offset{sizeof(header) + block_count * sizeof(std::uint32_t)};
+  if (block_count > size / sizeof(std::uint32_t) || data_offset > size) {
+    return false;
+  }
+  std::uint32_t previous_end{0};
+  for (std::size_t b = 0; b < block_count; ++b) {
+    std::uint32_t entry;
+    std::memcpy(&entry, stream + sizeof(header) + b * sizeof(entry),
+                sizeof(entry));
+    std::uint32_t block_end{entry & ~kLzStoredBlock};
+    if (block_end < previous_end || block_end > size - data_offset) {
+      return false;
+    }
+    previous_end = block_end;
+  }
+  return true;
+}
+
+bool LzDecompressBlock(const unsigned char *stream, std::size_t block,
+                       unsigned char *out) {
+  LzHeader header;
+  std::memcpy(&header, stream, sizeof(header));
+  std::size_t block_count{static_cast<std::size_t>(
+      (header.size + header.block_size - 1) / header.block_size)};
+  const unsigned char *table{stream + sizeof(header)};
+  const unsigned char *data{table + block_count * sizeof(std::uint32_t)};
+  std::uint32_t begin{0};
+  std::uint32_t end;
+  if (block > 0) {
+    std::memcpy(&begin, table + (block - 1) * sizeof(begin), sizeof(begin));
+    begin &= ~kLzStoredBlock;
+  }
+  std::memcpy(&end, table + block * sizeof(end), sizeof(end));
+  bool stored{(end & kLzStoredBlock) != 0};
+  end &= ~kLzStoredBlock;
+
+  std::size_t offset{block * header.block_size};
+  std::size_t raw_size{std::min<std::size_t>(header.block_size,
+                                             header.size - offset)};
+  if (stored) {
+    if (end - begin != raw_size) {
+      return false;
+    }
+    std::memcpy(out + offset, data + begin, raw_size);
+    return true;
+  }
+  return LzDecompress(data + begin, end - begin, out + offset, raw_size);
+}
+
+void LzDecompressBlocks(const unsigned char *stream, std::size_t size,
+                        unsigned char *out, ThreadPool *pool) {
+  std::size_t raw_size, block_count;
+  if (!LzStreamInfo(stream, size, raw_size, block_count)) {
+    throw std::string{"malformed lz stream"};
+  }
+  if (!pool || block_count < 2) {
+    for (std::size_t b = 0; b < block_count; ++b) {
+      if (!LzDecompressBlock(stream, b, out)) {
+        throw std::string{"malformed lz block"};
+      }
+    }
+    return;
+  }
+  for (std::size_t b = 0; b < block_count; ++b) {
+    pool->Submit([stream, b, out] {
+      if (!LzDecompressBlock(stream, b, out)) {
+        throw std::string{"malformed lz block"};
+      }
+    });
+  }
+  pool->Wait();
+}
+
+};  // namespace graphics
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -14,11 +17,69 @@
 
 using namespace graphics;
 
-void Graphics();
+void Graphics(const std::string &model_path);
+
+// The grid's metallic rises down its rows and its roughness along its
+// columns in kGridSteps steps, for each of these albedos.
+const glm::vec3 kGridAlbedo[]{
+    glm::vec3{1.0f, 0.766f, 0.336f}, glm::vec3{0.955f, 0.638f, 0.538f},
+    glm::vec3{0.8f, 0.1f, 0.1f},     glm::vec3{0.1f, 0.3f, 0.8f},
+    glm::vec3{0.2f, 0.7f, 0.2f},     glm::vec3{0.9f, 0.9f, 0.9f}};
+const unsigned kGridAlbedoCount{sizeof(kGridAlbedo) / sizeof(glm::vec3)};
+const unsigned kGridSteps{7};
+
+std::vector<InstanceMaterial> BuildGridMaterials() {
+  std::vector<InstanceMaterial> material;
+  for (unsigned a = 0; a < kGridAlbedoCount; ++a) {
+    for (unsigned m = 0; m < kGridSteps; ++m) {
+      for (unsigned r = 0; r < kGridSteps; ++r) {
+        float roughness{static_cast<float>(r) / (kGridSteps - 1)};
+        material.push_back(InstanceMaterial{
+            kGridAlbedo[a], 1.0f, static_cast<float>(m) / (kGridSteps - 1),
+            std::max(roughness, 0.05f)});
+      }
+    }
+  }
+  return material;
+}
+
+// count spheres of GetMesh's radius 2 on a square grid filling the square
+// from -4 to 4 in x and y.
+void BuildGrid(unsigned count, std::vector<Instance> &instance) {
+  unsigned side{static_cast<unsigned>(std::ceil(std::sqrt(count)))};
+  float spacing{8.0f / std::max(side, 1u)};
+  float scale{0.2f * spacing};
+  instance.resize(count);
+  for (unsigned i = 0; i < count; ++i) {
+    unsigned row{i / side}, column{i % side};
+    float x{-4.0f + spacing * (column + 0.5f)};
+    float y{4.0f - spacing * (row + 0.5f)};
+    instance[i].row[0] = glm::vec4{scale, 0.0f, 0.0f, x};
+    instance[i].row[1] = glm::vec4{0.0f, scale, 0.0f, y};
+    instance[i].row[2] = glm::vec4{0.0f, 0.0f, scale, 0.0f};
+    unsigned metallic{row * kGridSteps / side};
+    unsigned roughness{column * kGridSteps / side};
+    instance[i].material =
+        ((row + column) % kGridAlbedoCount * kGridSteps + metallic) *
+            kGridSteps +
+        roughness;
+  }
+}
 
-int main() {
+// The instance's model matrix, for drawing it on its own.
+glm::mat4 InstanceMatrix(const Instance &instance) {
+  glm::mat4 matrix{1.0f};
+  for (int r = 0; r < 3; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      matrix[c][r] = instance.row[r][c];
+    }
+  }
+  return matrix;
+}
+
+int main(int argc, char *argv[]) {
   try {
-    Graphics();
+    Graphics(argc > 1 ? argv[1] : std::string{});
   } catch (const std::string &e) {
     std::cout << "exception: " << e << std::endl;
     return -1;
@@ -26,7 +87,13 @@ int main() {
   return 0;
 }
 
-void Graphics() {
+void Graphics(const std::string &model_path) {
+  // assets
+  // ------
+  // opened first so its read-ahead overlaps window and context creation
+  asset_pack.Open(std::string{root_directory} + "/bin/asset.pack",
+                  root_directory);
+
   // glfw
   // ----
   glfwSetErrorCallback(ErrorCallback);
@@ -68,12 +135,51 @@ void Graphics() {
   glDepthFunc(GL_LEQUAL);
   glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
+  // a cold start compiles every program and fills the cache, a warm one
+  // links them all from it; either way the sources are the ones embedded at
+  // build time, so no shader file is read
+  auto program_start = std::chrono::steady_clock::now();
+  program_cache.Open(std::string{root_directory} + "/bin/program");
   Shader radiance_shader{"cubemap.vs", "cubemap_radiance.fs"};
   Shader irradiance_shader{"cubemap.vs", "cubemap_irradiance.fs"};
   Shader prefilter_shader{"cubemap.vs", "cubemap_prefilter.fs"};
   Shader brdf_shader{"brdf.vs", "brdf.fs"};
-  Shader pbr_shader{"pbr.vs", "pbr.fs"};
+  // pbr.fs's samplers, on the units the render loop binds
+  auto pbr_setup = [](Shader &shader) {
+    shader.SetInt("normal_texture", 0);
+    shader.SetInt("albedo_texture", 1);
+    shader.SetInt("metallic_texture", 2);
+    shader.SetInt("roughness_texture", 3);
+    shader.SetInt("ao_texture", 4);
+    shader.SetInt("irradiance_texture", 5);
+    shader.SetInt("prefilter_texture", 6);
+    shader.SetInt("brdf_texture", 7);
+    shader.SetInt("material_table", kMaterialTableUnit);
+  };
+  ShaderVariants pbr_variants{"pbr.vs", "pbr.fs", pbr_setup};
+  // the first frame's variant is compiled with the other programs; any
+  // other waits until the gui asks for it
+  unsigned pbr_key_drawn{kShaderPunctualLight | kShaderImageBasedLight |
+                         ShaderLightCount(kLightCount)};
+  pbr_variants.Get(pbr_key_drawn);
   Shader background_shader{"background.vs", "background.fs"};
+  {
+    std::chrono::duration<double, std::milli> program_time{
+        std::chrono::steady_clock::now() - program_start};
+    std::cout << "programs ready in " << program_time.count() << " ms ("
+              << (program_cache.hit_ > 0 && program_cache.miss_ == 0 &&
+                          program_cache.rejected_ == 0
+                      ? "warm"
+                      : "cold")
+              << "): " << program_cache.hit_ << " from the cache, "
+              << program_cache.miss_ << " missed, "
+              << program_cache.rejected_ << " rejected" << std::endl;
+  }
+  // the capture programs only run once, below, so only these two are
+  // rebuilt when their files change
+  ShaderReloader shader_reloader;
+  shader_reloader.Watch(pbr_variants);
+  shader_reloader.Watch(background_shader);
 
   glm::mat4 cubemap_projection{
       glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f)};
@@ -106,25 +212,11 @@ void Graphics() {
   unsigned radiance_texture;
   {
     stbi_set_flip_vertically_on_load(true);
-    int x, y, channel;
-    float *hdr_image{stbi_loadf(
-        (std::string{root_directory} + "/resource/texture/hdr/alexs_apt_2k.hdr")
-            .c_str(),
-        &x, &y, &channel, 0)};
-    unsigned int hdr_texture;
-    if (hdr_image) {
-      glGenTextures(1, &hdr_texture);
-      glBindTexture(GL_TEXTURE_2D, hdr_texture);
-      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, x, y, 0, GL_RGB, GL_FLOAT,
-                   hdr_image);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      stbi_image_free(hdr_image);
-    } else {
-      throw std::string{"failed to load hdr image"};
-    }
+    // the cube faces are 512 wide, so 4 * 512 equirect texels already cover
+    // the equator at full resolution; larger sources are filtered down
+    unsigned int hdr_texture{LoadHdrTexture(
+        std::string{root_directory} + "/resource/texture/hdr/alexs_apt_2k.hdr",
+        4 * 512)};
 
     glGenTextures(1, &radiance_texture);
     glBindTexture(GL_TEXTURE_CUBE_MAP, radiance_texture);
@@ -145,9 +237,9 @@ void Graphics() {
     glBindTexture(GL_TEXTURE_2D, hdr_texture);
     radiance_shader.UseProgram();
     radiance_shader.SetInt("equirectangular_texture", 0);
-    radiance_shader.SetMat4("projection", cubemap_projection);
+    radiance_shader.SetMat4(kUniformProjection, cubemap_projection);
     for (unsigned int i = 0; i < 6; ++i) {
-      radiance_shader.SetMat4("view", cubemap_view[i]);
+      radiance_shader.SetMat4(kUniformView, cubemap_view[i]);
       glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                              GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
                              radiance_texture, 0);
@@ -182,9 +274,9 @@ void Graphics() {
     glBindTexture(GL_TEXTURE_CUBE_MAP, radiance_texture);
     irradiance_shader.UseProgram();
     irradiance_shader.SetInt("environment_texture", 0);
-    irradiance_shader.SetMat4("projection", cubemap_projection);
+    irradiance_shader.SetMat4(kUniformProjection, cubemap_projection);
     for (unsigned int i = 0; i < 6; ++i) {
-      irradiance_shader.SetMat4("view", cubemap_view[i]);
+      irradiance_shader.SetMat4(kUniformView, cubemap_view[i]);
       glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                              GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
                              irradiance_texture, 0);
@@ -216,7 +308,7 @@ void Graphics() {
 
     prefilter_shader.UseProgram();
     prefilter_shader.SetInt("environment_texture", 0);
-    prefilter_shader.SetMat4("projection", cubemap_projection);
+    prefilter_shader.SetMat4(kUniformProjection, cubemap_projection);
     unsigned max_mip_level{5};
     for (unsigned mip = 0; mip < max_mip_level; ++mip) {
       unsigned mip_width = 128 * std::pow(0.5, mip);
@@ -229,7 +321,7 @@ void Graphics() {
       float roughness = (float)mip / (float)(max_mip_level - 1);
       prefilter_shader.SetFloat("roughness", roughness);
       for (unsigned i = 0; i < 6; ++i) {
-        prefilter_shader.SetMat4("view", cubemap_view[i]);
+        prefilter_shader.SetMat4(kUniformView, cubemap_view[i]);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                                GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
                                prefilter_texture, mip);
@@ -277,20 +369,11 @@ void Graphics() {
       glm::vec3{300.0f, 300.0f, 300.0f}, glm::vec3{300.0f, 300.0f, 300.0f},
       glm::vec3{300.0f, 300.0f, 300.0f}, glm::vec3{300.0f, 300.0f, 300.0f}};
 
-  pbr_shader.UseProgram();
-  pbr_shader.SetInt("normal_texture", 0);
-  pbr_shader.SetInt("albedo_texture", 1);
-  pbr_shader.SetInt("metallic_texture", 2);
-  pbr_shader.SetInt("roughness_texture", 3);
-  pbr_shader.SetInt("ao_texture", 4);
-  pbr_shader.SetInt("irradiance_texture", 5);
-  pbr_shader.SetInt("prefilter_texture", 6);
-  pbr_shader.SetInt("brdf_texture", 7);
-  for (unsigned i = 0; i < light_position.size(); ++i) {
-    pbr_shader.SetVec3("light_position[" + std::to_string(i) + "]",
-                       light_position[i]);
-    pbr_shader.SetVec3("light_color[" + std::to_string(i) + "]",
-                       light_color[i]);
+  // the camera is filled in every frame
+  FrameBlock frame{};
+  for (unsigned i = 0; i < kLightCount; ++i) {
+    frame.light_position[i] = glm::vec4{light_position[i], 1.0f};
+    frame.light_color[i] = glm::vec4{light_color[i], 1.0f};
   }
 
   background_shader.UseProgram();
@@ -303,15 +386,103 @@ void Graphics() {
   glm::vec3 translation_value{0.0f, 0.0f, 0.0f};
   glm::vec3 clear_color_value{0.5f, 0.7f, 0.7f};
   bool punctual_light_value{true};
+  int light_count_value{static_cast<int>(kLightCount)};
   bool image_based_light_value{true};
   int pbr_material_value{0};
   const char *pbr_material[]{"rusted_iron", "gold",    "loose_tablecloth",
                              "grass",       "plastic", "wall"};
   unsigned pbr_material_count{sizeof(pbr_material) / sizeof(const char *)};
-  std::vector<std::vector<unsigned>> pbr_texture{
+  std::vector<std::vector<Texture>> pbr_texture{
       LoadPbrTexture(pbr_material, pbr_material_count)};
   bool background_value{true};
 
+  // the sphere's levels of detail, switched by how large it is on screen,
+  // in both vertex layouts
+  const Mesh *sphere_lod[2][kSphereLodCount];
+  float sphere_lod_error[kSphereLodCount];
+  for (unsigned i = 0; i < kSphereLodCount; ++i) {
+    for (unsigned packed = 0; packed < 2; ++packed) {
+      sphere_lod[packed][i] =
+          &GetMesh(kIcosphere, kSphereLodCount - 1 - i, packed != 0);
+    }
+    sphere_lod_error[i] = sphere_lod[0][i]->error;
+  }
+  unsigned sphere_lod_value{0};
+  bool packed_vertex_value{true};
+
+  // the same chain simplified from the finest level instead of built level
+  // by level, each a quarter of the one before as the icospheres are
+  const std::vector<Mesh> *simplified_lod[2];
+  for (unsigned packed = 0; packed < 2; ++packed) {
+    simplified_lod[packed] = &GetMeshLevels(
+        kSimplifiedIcosphere, kSphereLodCount - 1, packed != 0);
+  }
+  std::vector<float> simplified_lod_error;
+  for (const Mesh &level : *simplified_lod[0]) {
+    simplified_lod_error.push_back(level.error);
+  }
+  bool simplified_value{false};
+  // the sphere's meshlets left after culling, and the frame's culling cost
+  bool cluster_cull_value{false};
+  std::vector<unsigned> cluster_first;
+  std::vector<unsigned> cluster_count;
+  std::size_t cluster_kept{0};
+  double cluster_cull_time{0.0};
+
+  // the grid, drawn instanced, one draw per sphere or from the mesh pool,
+  // which cycles the grid through several shapes but still submits them
+  // all at once. The benchmark runs each count in the sweep in every mode
+  // for kBenchmarkFrames frames after kWarmupFrames unmeasured ones.
+  const std::vector<InstanceMaterial> grid_material{BuildGridMaterials()};
+  MaterialTable grid_table;
+  grid_table.Set(grid_material);
+  InstanceBatch instance_batch;
+  std::vector<Instance> grid_instance;
+  int grid_count_value{10000};
+  const char *draw_mode_items[]{"instanced", "one draw each", "mesh pool"};
+  const unsigned kDrawModeCount{IM_ARRAYSIZE(draw_mode_items)};
+  int draw_mode_value{0};
+  const PoolMesh *pool_shape[]{
+      &GetPoolMesh(kIcosphere, 0), &GetPoolMesh(kIcosphere, 1),
+      &GetPoolMesh(kIcosphere, 2), &GetPoolMesh(kIcosphere, 3),
+      &GetPoolMesh(kUvSphere, 16), &GetPoolMesh(kUvSphere, 32),
+      &GetPoolMesh(kCube, 0)};
+  const unsigned kPoolShapeCount{IM_ARRAYSIZE(pool_shape)};
+  // with culling on, only the spheres a BVH over the grid finds in the
+  // view frustum are drawn; the BVH is rebuilt when the grid changes
+  bool cull_value{true};
+  Bvh grid_bvh;
+  std::vector<Aabb> grid_bounds;
+  int grid_bvh_count{-1};
+  bool grid_bvh_pool{false};
+  std::vector<unsigned> grid_visible;
+  std::vector<Instance> grid_drawn;
+  double grid_cull_time{0.0};
+  GpuTimer grid_timer;
+  double grid_cpu_time{0.0};
+  double grid_gpu_time{0.0};
+  const int kInstanceSweep[]{1000, 10000, 25000, 50000, 100000};
+  const unsigned kSweepCount{sizeof(kInstanceSweep) / sizeof(int)};
+  const unsigned kWarmupFrames{10};
+  const unsigned kBenchmarkFrames{60};
+  // the step in the sweep, counting the runs in each mode apart;
+  // kBenchmarkSteps when idle
+  const unsigned kBenchmarkSteps{kSweepCount * kDrawModeCount};
+  unsigned benchmark_step{kBenchmarkSteps};
+  unsigned benchmark_frame{0};
+  double benchmark_cpu{0.0};
+  double benchmark_gpu{0.0};
+  unsigned benchmark_gpu_count{0};
+
+  // a glTF scene from the command line, scaled to the sphere's radius of 2
+  Model gltf_model;
+  glm::mat4 gltf_fit{1.0f};
+  if (!model_path.empty()) {
+    gltf_model = LoadModel(model_path, true, true);
+    gltf_fit = glm::scale(gltf_fit, glm::vec3{2.0f / gltf_model.radius});
+    gltf_fit = glm::translate(gltf_fit, -gltf_model.center);
+  }
+
   while (!glfwWindowShouldClose(window)) {
     // timer
     // -----
@@ -323,6 +494,10 @@ void Graphics() {
     // -----
     ProcessInput(window);
 
+    // shaders
+    // -------
+    shader_reloader.Update();
+
     // imgui
     // -----
     ImGui_ImplGlfw_NewFrame();
@@ -337,8 +512,9 @@ void Graphics() {
     ImGui::SetNextWindowSize(ImVec2{300, 300});
     ImGui::Begin("real-time rendering");
     ImGui::LabelText("label", "value");
-    const char *model_items[]{"sphere", "cube", "quad"};
-    ImGui::Combo("model", &model_value, model_items, IM_ARRAYSIZE(model_items));
+    const char *model_items[]{"sphere", "cube", "quad", "grid", "gltf"};
+    ImGui::Combo("model", &model_value, model_items,
+                 IM_ARRAYSIZE(model_items) - (model_path.empty() ? 1 : 0));
     ImGui::SliderFloat("scale", &scale_value, 0.1f, 2.0f, "%.3f");
     ImGui::SliderFloat3("translate",
                         reinterpret_cast<float *>(&translation_value), -1.0f,
@@ -349,8 +525,70 @@ void Graphics() {
                  IM_ARRAYSIZE(pbr_material));
     
     ImGui::Checkbox("punctual light", &punctual_light_value);
+    if (punctual_light_value) {
+      ImGui::SliderInt("lights", &light_count_value, 1,
+                       static_cast<int>(kLightCount));
+    }
     ImGui::Checkbox("image based light", &image_based_light_value);
     ImGui::Checkbox("background", &background_value);
+    ImGui::Checkbox("packed vertices", &packed_vertex_value);
+    if (model_value == 0) {
+      if (ImGui::Checkbox("simplified lods", &simplified_value)) {
+        sphere_lod_value = 0;
+      }
+      ImGui::Checkbox("cluster cull", &cluster_cull_value);
+    }
+    if (model_value == 3) {
+      ImGui::SliderInt("instances", &grid_count_value, 1000, 100000);
+      ImGui::Combo("draw", &draw_mode_value, draw_mode_items,
+                   kDrawModeCount);
+      ImGui::Checkbox("frustum cull", &cull_value);
+      ImGui::Text("grid cpu %.3f ms, gpu %.3f ms", grid_cpu_time,
+                  grid_gpu_time);
+      ImGui::Text("%u visible, %u culled in %.3f ms",
+                  static_cast<unsigned>(grid_visible.size()),
+                  static_cast<unsigned>(grid_instance.size() -
+                                        grid_visible.size()),
+                  grid_cull_time);
+      // counted up to the last frame's SetFrame, which comes later
+      ImGui::Text("%u draw blocks uploaded", uniform_blocks.draw_count_);
+      if (draw_mode_value == 2) {
+        ImGui::Text("%u draw calls for %u meshes (%s)",
+                    mesh_pool.draw_call_count_, mesh_pool.command_count_,
+                    mesh_pool.multi_draw_indirect_ ? "multi-draw indirect"
+                                                   : "fallback loop");
+      }
+      if (benchmark_step < kBenchmarkSteps) {
+        ImGui::Text("benchmark %u / %u", benchmark_step + 1, kBenchmarkSteps);
+      } else if (ImGui::Button("benchmark")) {
+        benchmark_step = 0;
+        benchmark_frame = 0;
+      }
+    }
+    if (model_value == 0) {
+      const Mesh &lod{
+          simplified_value
+              ? (*simplified_lod[packed_vertex_value])[sphere_lod_value]
+              : *sphere_lod[packed_vertex_value][sphere_lod_value]};
+      ImGui::Text("sphere lod %u, %u triangles, %u vertices of %u bytes",
+                  sphere_lod_value, lod.index_count / 3, lod.vertex_count,
+                  static_cast<unsigned>(lod.packed ? sizeof(PackedVertex)
+                                                   : sizeof(Vertex)));
+      if (cluster_cull_value) {
+        ImGui::Text("%u meshlets, %.1f%% of triangles culled in %.3f ms",
+                    static_cast<unsigned>(lod.meshlet.size()),
+                    100.0 * (1.0 - static_cast<double>(cluster_kept) /
+                                       std::max(lod.index_count / 3, 1u)),
+                    cluster_cull_time);
+      }
+    }
+    if (shader_reloader.reload_count_ > 0) {
+      ImGui::Text("%u programs reloaded", shader_reloader.reload_count_);
+    }
+    if (!shader_reloader.error_.empty()) {
+      ImGui::TextColored(ImVec4{1.0f, 0.4f, 0.4f, 1.0f}, "%s",
+                         shader_reloader.error_.c_str());
+    }
     ImGui::End();
 
     // opengl
@@ -368,16 +606,37 @@ void Graphics() {
         static_cast<float>(kWindowWidth) / static_cast<float>(kWindowHeight),
         0.1f, 100.0f)};
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, pbr_texture[pbr_material_value][0]);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, pbr_texture[pbr_material_value][1]);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, pbr_texture[pbr_material_value][2]);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, pbr_texture[pbr_material_value][3]);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, pbr_texture[pbr_material_value][4]);
+    frame.view = view;
+    frame.projection = projection;
+    frame.camera_position = camera.position_;
+    uniform_blocks.SetFrame(frame);
+
+    // the light count only matters with punctual lights, so it is left out
+    // of the key without them rather than make identical variants
+    unsigned pbr_key{0};
+    if (punctual_light_value) {
+      pbr_key |= kShaderPunctualLight | ShaderLightCount(light_count_value);
+    }
+    if (image_based_light_value) {
+      pbr_key |= kShaderImageBasedLight;
+    }
+    try {
+      pbr_variants.Get(pbr_key).UseProgram();
+      pbr_key_drawn = pbr_key;
+    } catch (const std::string &e) {
+      // a variant first asked for after a broken edit; switch the gui back
+      // to the last one drawn rather than retry every frame
+      shader_reloader.error_ = e;
+      punctual_light_value = pbr_key_drawn & kShaderPunctualLight;
+      image_based_light_value = pbr_key_drawn & kShaderImageBasedLight;
+      if (punctual_light_value) {
+        light_count_value = static_cast<int>(
+            (pbr_key_drawn & kShaderLightCountMask) >>
+            kShaderLightCountShift);
+      }
+      pbr_variants.Get(pbr_key_drawn).UseProgram();
+    }
+    BindPbrMaterial(pbr_texture[pbr_material_value]);
     glActiveTexture(GL_TEXTURE5);
     glBindTexture(GL_TEXTURE_CUBE_MAP, irradiance_texture);
     glActiveTexture(GL_TEXTURE6);
@@ -385,28 +644,167 @@ void Graphics() {
     glActiveTexture(GL_TEXTURE7);
     glBindTexture(GL_TEXTURE_2D, brdf_texture);
 
-    pbr_shader.UseProgram();
-    pbr_shader.SetMat4("model", model);
-    pbr_shader.SetMat4("view", view);
-    pbr_shader.SetMat4("projection", projection);
-    pbr_shader.SetVec3("camera_position", camera.position_);
-    pbr_shader.SetBool("punctual_light", punctual_light_value);
-    pbr_shader.SetBool("image_based_light", image_based_light_value);
+    DrawBlock &draw{uniform_blocks.draw_};
+    draw.model = model;
 
     if (model_value == 0) {
-      RenderSphere();
+      float distance{glm::length(camera.position_ - translation_value)};
+      float pixels_per_unit{
+          scale_value * PixelsPerUnit(distance, glm::radians(camera.yfov_),
+                                      static_cast<float>(kWindowHeight))};
+      if (simplified_value) {
+        sphere_lod_value = SelectLod(
+            simplified_lod_error.data(),
+            static_cast<unsigned>(simplified_lod_error.size()),
+            pixels_per_unit, sphere_lod_value);
+      } else {
+        sphere_lod_value =
+            SelectLod(sphere_lod_error, kSphereLodCount, pixels_per_unit,
+                      sphere_lod_value);
+      }
+      const Mesh &lod{
+          simplified_value
+              ? (*simplified_lod[packed_vertex_value])[sphere_lod_value]
+              : *sphere_lod[packed_vertex_value][sphere_lod_value]};
+      SetVertexFormat(&lod);
+      uniform_blocks.PushDraw();
+      if (cluster_cull_value && !lod.meshlet.empty()) {
+        // in the mesh's own space, where the meshlet bounds are
+        auto cull_start = std::chrono::steady_clock::now();
+        glm::vec3 camera_in_model{glm::inverse(model) *
+                                  glm::vec4{camera.position_, 1.0f}};
+        cluster_first.clear();
+        cluster_count.clear();
+        cluster_kept = CullMeshlets(
+            lod.meshlet, ExtractFrustum(projection * view * model),
+            camera_in_model, cluster_first, cluster_count);
+        std::chrono::duration<double, std::milli> cull_time{
+            std::chrono::steady_clock::now() - cull_start};
+        cluster_cull_time = cull_time.count();
+        DrawMeshRanges(lod, cluster_first, cluster_count);
+      } else {
+        DrawMesh(lod);
+      }
     } else if (model_value == 1) {
-      RenderCube();
+      const Mesh &cube{GetMesh(kCube, 0)};
+      SetVertexFormat(&cube);
+      uniform_blocks.PushDraw();
+      DrawMesh(cube);
     } else if (model_value == 2) {
+      SetVertexFormat(nullptr);
+      uniform_blocks.PushDraw();
       RenderQuad();
+    } else if (model_value == 3) {
+      if (benchmark_step < kBenchmarkSteps) {
+        grid_count_value = kInstanceSweep[benchmark_step / kDrawModeCount];
+        draw_mode_value = benchmark_step % kDrawModeCount;
+      }
+      const Mesh &sphere{GetMesh(kIcosphere, 2, packed_vertex_value)};
+      // the CPU side of the draw, including streaming the instances in
+      auto cpu_start = std::chrono::steady_clock::now();
+      grid_timer.Begin();
+      BuildGrid(grid_count_value, grid_instance);
+      auto cull_start = std::chrono::steady_clock::now();
+      grid_visible.clear();
+      if (cull_value) {
+        bool pool{draw_mode_value == 2};
+        if (grid_bvh_count != grid_count_value || grid_bvh_pool != pool) {
+          grid_bounds.resize(grid_instance.size());
+          for (std::size_t i = 0; i < grid_instance.size(); ++i) {
+            const Aabb &bounds{pool ? pool_shape[i % kPoolShapeCount]->bounds
+                                    : sphere.bounds};
+            grid_bounds[i] =
+                TransformAabb(bounds, InstanceMatrix(grid_instance[i]));
+          }
+          grid_bvh.Build(grid_bounds);
+          grid_bvh_count = grid_count_value;
+          grid_bvh_pool = pool;
+        }
+        // planes in the grid's space, so its boxes need no transform
+        grid_bvh.Cull(ExtractFrustum(projection * view * model),
+                      grid_visible);
+      } else {
+        for (std::size_t i = 0; i < grid_instance.size(); ++i) {
+          grid_visible.push_back(static_cast<unsigned>(i));
+        }
+      }
+      std::chrono::duration<double, std::milli> cull_time{
+          std::chrono::steady_clock::now() - cull_start};
+      grid_cull_time = cull_time.count();
+      if (draw_mode_value == 0) {
+        grid_drawn.clear();
+        for (unsigned i : grid_visible) {
+          grid_drawn.push_back(grid_instance[i]);
+        }
+        instance_batch.Upload(grid_drawn);
+        instance_batch.Draw(sphere, grid_table);
+      } else if (draw_mode_value == 2) {
+        for (unsigned i : grid_visible) {
+          mesh_pool.Queue(*pool_shape[i % kPoolShapeCount], grid_instance[i]);
+        }
+        mesh_pool.Draw(grid_table);
+      } else {
+        SetVertexFormat(&sphere);
+        for (unsigned m = 0; m < kPbrMapCount; ++m) {
+          draw.map_constant[m] = true;
+        }
+        draw.map_value[0] = glm::vec4{0.5f, 0.5f, 1.0f, 1.0f};
+        for (unsigned i : grid_visible) {
+          const Instance &instance{grid_instance[i]};
+          const InstanceMaterial &material{grid_material[instance.material]};
+          draw.model = model * InstanceMatrix(instance);
+          draw.map_value[1] = glm::vec4{
+              glm::pow(material.albedo, glm::vec3{1.0f / 2.2f}), 1.0f};
+          draw.map_value[2] = glm::vec4{material.metallic};
+          draw.map_value[3] = glm::vec4{material.roughness};
+          draw.map_value[4] = glm::vec4{material.ao};
+          uniform_blocks.PushDraw();
+          DrawMesh(sphere);
+        }
+      }
+      grid_timer.End();
+      std::chrono::duration<double, std::milli> cpu_time{
+          std::chrono::steady_clock::now() - cpu_start};
+      grid_cpu_time = cpu_time.count();
+      double gpu_time;
+      bool gpu_ready{grid_timer.Poll(gpu_time)};
+      if (gpu_ready) {
+        grid_gpu_time = gpu_time;
+      }
+
+      if (benchmark_step < kBenchmarkSteps) {
+        // a GPU result trails its frame, so warmup results may land in the
+        // measured ones; with this many frames that barely matters
+        if (benchmark_frame >= kWarmupFrames) {
+          benchmark_cpu += grid_cpu_time;
+          if (gpu_ready) {
+            benchmark_gpu += gpu_time;
+            ++benchmark_gpu_count;
+          }
+        }
+        if (++benchmark_frame == kWarmupFrames + kBenchmarkFrames) {
+          std::cout << "grid of " << grid_count_value << " spheres, "
+                    << draw_mode_items[draw_mode_value]
+                    << ": cpu " << benchmark_cpu / kBenchmarkFrames
+                    << " ms, gpu "
+                    << benchmark_gpu / std::max(benchmark_gpu_count, 1u)
+                    << " ms per frame" << std::endl;
+          ++benchmark_step;
+          benchmark_frame = 0;
+          benchmark_cpu = benchmark_gpu = 0.0;
+          benchmark_gpu_count = 0;
+        }
+      }
+    } else if (model_value == 4) {
+      DrawModel(gltf_model, model * gltf_fit, camera.position_,
+                PixelsPerUnit(1.0f, glm::radians(camera.yfov_),
+                              static_cast<float>(kWindowHeight)));
     }
 
     if (background_value) {
       glActiveTexture(GL_TEXTURE0);
       glBindTexture(GL_TEXTURE_CUBE_MAP, radiance_texture);
       background_shader.UseProgram();
-      background_shader.SetMat4("view", view);
-      background_shader.SetMat4("projection", projection);
       RenderCube();
     }
 
@@ -431,4 +829,7 @@ void Graphics() {
   // ----
   glfwDestroyWindow(window);
   glfwTerminate();
+
+  // the next pack build lays entries out in the order this run used them
+  asset_pack.WriteAccessOrder(std::string{root_directory} + "/bin/asset.order");
 }
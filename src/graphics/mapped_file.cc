@@ -0,0 +1,46 @@
+#include "graphics/mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace graphics {
+
+MappedFile::MappedFile() : fd_{-1}, data_{nullptr}, size_{0} {}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  fd_ = open(path.c_str(), O_RDONLY);
+  struct stat status;
+  if (fd_ < 0 || fstat(fd_, &status) != 0 || status.st_size == 0) {
+    Close();
+    return false;
+  }
+  size_ = static_cast<std::size_t>(status.st_size);
+  void *data{mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0)};
+  if (data == MAP_FAILED) {
+    Close();
+    return false;
+  }
+  data_ = static_cast<const unsigned char *>(data);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    munmap(const_cast<unsigned char *>(data_), size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  fd_ = -1;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+};  // namespace graphics
@@ -0,0 +1,507 @@
+#include "graphics/mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace graphics {
+
+unsigned MeshData::GetIndex(std::size_t i) const {
+  if (index_size == 2) {
+    std::uint16_t value;
+    std::memcpy(&value, &index[i * 2], 2);
+    return value;
+  }
+  std::uint32_t value;
+  std::memcpy(&value, &index[i * 4], 4);
+  return value;
+}
+
+void MeshData::SetIndex(std::size_t i, unsigned value) {
+  if (index_size == 2) {
+    std::uint16_t narrow{static_cast<std::uint16_t>(value)};
+    std::memcpy(&index[i * 2], &narrow, 2);
+  } else {
+    std::uint32_t wide{value};
+    std::memcpy(&index[i * 4], &wide, 4);
+  }
+}
+
+MeshBuilder::MeshBuilder(MeshData &mesh)
+    : mesh_(mesh), vertex_count_{0}, index_count_{0} {}
+
+void MeshBuilder::Begin(std::size_t vertex_count, std::size_t index_count) {
+  mesh_.index_size = vertex_count <= 0x10000 ? 2 : 4;
+  mesh_.vertex.resize(vertex_count);
+  mesh_.index.resize(index_count * mesh_.index_size);
+  mesh_.error = 0.0f;
+  vertex_count_ = 0;
+  index_count_ = 0;
+}
+
+void MeshBuilder::AddVertex(const glm::vec3 &position, const glm::vec3 &normal,
+                            const glm::vec2 &texture_coordinate) {
+  if (vertex_count_ == mesh_.vertex.size()) {
+    throw std::string{"mesh builder vertex overflow"};
+  }
+  Vertex &vertex{mesh_.vertex[vertex_count_++]};
+  vertex.position = position;
+  vertex.normal = normal;
+  vertex.texture_coordinate = texture_coordinate;
+  vertex.tangent = glm::vec4{0.0f};
+}
+
+void MeshBuilder::AddTriangle(unsigned a, unsigned b, unsigned c) {
+  if (index_count_ + 3 > mesh_.IndexCount()) {
+    throw std::string{"mesh builder index overflow"};
+  }
+  mesh_.SetIndex(index_count_++, a);
+  mesh_.SetIndex(index_count_++, b);
+  mesh_.SetIndex(index_count_++, c);
+}
+
+void MeshBuilder::End() {
+  mesh_.vertex.resize(vertex_count_);
+  mesh_.index.resize(index_count_ * mesh_.index_size);
+}
+
+// Fills table with (cos, sin) of i * angle / count for i from 0 to count by
+// rotating the previous entry, so a whole ring costs two sin and cos calls
+// instead of one per vertex. The recurrence runs in double, where its drift
+// over a few thousand steps stays far below float precision.
+static void RotationTable(unsigned count, double angle,
+                          std::vector<glm::vec2> &table) {
+  table.resize(count + 1);
+  double step_cos{std::cos(angle / count)};
+  double step_sin{std::sin(angle / count)};
+  double c{1.0}, s{0.0};
+  for (unsigned i = 0; i < count; ++i) {
+    table[i] = glm::vec2{static_cast<float>(c), static_cast<float>(s)};
+    double next_c{c * step_cos - s * step_sin};
+    s = s * step_cos + c * step_sin;
+    c = next_c;
+  }
+  // land exactly on the seam or the pole
+  table[count] = glm::vec2{static_cast<float>(std::cos(angle)),
+                           static_cast<float>(std::sin(angle))};
+}
+
+// The largest gap between mesh and the sphere of radius around the origin
+// it approximates: over every triangle, radius less the distance from the
+// origin to the triangle's plane.
+static float SphereError(const MeshData &mesh, float radius) {
+  float error{0.0f};
+  for (std::size_t i = 0; i + 2 < mesh.IndexCount(); i += 3) {
+    const glm::vec3 &a{mesh.vertex[mesh.GetIndex(i)].position};
+    const glm::vec3 &b{mesh.vertex[mesh.GetIndex(i + 1)].position};
+    const glm::vec3 &c{mesh.vertex[mesh.GetIndex(i + 2)].position};
+    glm::vec3 normal{glm::cross(b - a, c - a)};
+    float length{glm::length(normal)};
+    if (length > 0.0f) {
+      error = std::max(error, radius - std::abs(glm::dot(normal, a)) / length);
+    }
+  }
+  return error;
+}
+
+void BuildUvSphere(MeshData &mesh, unsigned segment_count, float radius) {
+  if (segment_count < 3) {
+    segment_count = 3;
+  }
+  unsigned ring_count{segment_count / 2};
+  if (ring_count < 2) {
+    ring_count = 2;
+  }
+  std::vector<glm::vec2> theta, phi;
+  RotationTable(segment_count, 2.0 * M_PI, theta);
+  RotationTable(ring_count, M_PI, phi);
+
+  // the first and last rows of quads touch a pole and lose one triangle
+  MeshBuilder builder{mesh};
+  builder.Begin((segment_count + 1) * (ring_count + 1),
+                6 * segment_count * (ring_count - 1));
+  for (unsigned y = 0; y <= ring_count; ++y) {
+    for (unsigned x = 0; x <= segment_count; ++x) {
+      glm::vec3 normal{theta[x].x * phi[y].y, phi[y].x, theta[x].y * phi[y].y};
+      builder.AddVertex(normal * radius, normal,
+                        glm::vec2{static_cast<float>(x) / segment_count,
+                                  static_cast<float>(y) / ring_count});
+    }
+  }
+  unsigned row{segment_count + 1};
+  for (unsigned y = 0; y < ring_count; ++y) {
+    for (unsigned x = 0; x < segment_count; ++x) {
+      unsigned i{y * row + x};
+      if (y != 0) {
+        builder.AddTriangle(i, i + 1, i + row);
+      }
+      if (y != ring_count - 1) {
+        builder.AddTriangle(i + 1, i + row + 1, i + row);
+      }
+    }
+  }
+  builder.End();
+  mesh.error = SphereError(mesh, radius);
+}
+
+void BuildCube(MeshData &mesh) {
+  // each face as its normal and the two axes its texture coordinates run
+  // along, ordered so that u x v points out of the cube
+  const glm::vec3 face[6][3]{
+      {{1, 0, 0}, {0, 0, -1}, {0, 1, 0}},  {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+      {{0, 1, 0}, {1, 0, 0}, {0, 0, -1}},  {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+      {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},   {{0, 0, -1}, {-1, 0, 0}, {0, 1, 0}},
+  };
+  MeshBuilder builder{mesh};
+  builder.Begin(24, 36);
+  for (unsigned f = 0; f < 6; ++f) {
+    const glm::vec3 &normal{face[f][0]};
+    const glm::vec3 &u{face[f][1]};
+    const glm::vec3 &v{face[f][2]};
+    builder.AddVertex(normal - u - v, normal, glm::vec2{0.0f, 0.0f});
+    builder.AddVertex(normal + u - v, normal, glm::vec2{1.0f, 0.0f});
+    builder.AddVertex(normal + u + v, normal, glm::vec2{1.0f, 1.0f});
+    builder.AddVertex(normal - u + v, normal, glm::vec2{0.0f, 1.0f});
+    builder.AddTriangle(4 * f, 4 * f + 1, 4 * f + 2);
+    builder.AddTriangle(4 * f, 4 * f + 2, 4 * f + 3);
+  }
+  builder.End();
+}
+
+void BuildIcosphere(MeshData &mesh, unsigned level, float radius) {
+  std::size_t face_count{std::size_t{20} << (2 * level)};
+  std::vector<glm::vec3> position;
+  std::vector<unsigned> triangle;
+  position.reserve(face_count / 2 + 2);
+  triangle.reserve(face_count * 3);
+
+  // a vertex on each pole, then rings of five above and below the equator
+  // a tenth of a turn apart
+  std::vector<glm::vec2> ring;
+  RotationTable(10, 2.0 * M_PI, ring);
+  float height{1.0f / std::sqrt(5.0f)};
+  float ring_radius{2.0f * height};
+  position.push_back(glm::vec3{0.0f, 1.0f, 0.0f});
+  for (unsigned k = 0; k < 10; ++k) {
+    position.push_back(glm::vec3{ring_radius * ring[k].x,
+                                 k % 2 == 0 ? height : -height,
+                                 ring_radius * ring[k].y});
+  }
+  position.push_back(glm::vec3{0.0f, -1.0f, 0.0f});
+  const unsigned kTop{0}, kBottom{11};
+  for (unsigned k = 0; k < 5; ++k) {
+    unsigned upper{1 + 2 * k}, lower{upper + 1};
+    unsigned next_upper{1 + 2 * ((k + 1) % 5)}, next_lower{next_upper + 1};
+    unsigned face[4][3]{{kTop, next_upper, upper},
+                        {upper, next_upper, lower},
+                        {lower, next_upper, next_lower},
+                        {kBottom, lower, next_lower}};
+    for (unsigned f = 0; f < 4; ++f) {
+      triangle.insert(triangle.end(), face[f], face[f] + 3);
+    }
+  }
+
+  // split every edge at its midpoint, pushed out onto the sphere, and every
+  // triangle into four
+  std::unordered_map<std::uint64_t, unsigned> midpoint;
+  for (unsigned l = 0; l < level; ++l) {
+    midpoint.clear();
+    auto split = [&](unsigned a, unsigned b) {
+      std::uint64_t key{static_cast<std::uint64_t>(std::min(a, b)) << 32 |
+                        std::max(a, b)};
+      auto inserted = midpoint.insert(
+          std::make_pair(key, static_cast<unsigned>(position.size())));
+      if (inserted.second) {
+        position.push_back(glm::normalize(position[a] + position[b]));
+      }
+      return inserted.first->second;
+    };
+    std::size_t count{triangle.size()};
+    for (std::size_t i = 0; i < count; i += 3) {
+      unsigned a{triangle[i]}, b{triangle[i + 1]}, c{triangle[i + 2]};
+      unsigned ab{split(a, b)}, bc{split(b, c)}, ca{split(c, a)};
+      triangle[i + 1] = ab;
+      triangle[i + 2] = ca;
+      unsigned rest[9]{ab, b, bc, ca, bc, c, ab, bc, ca};
+      triangle.insert(triangle.end(), rest, rest + 9);
+    }
+  }
+
+  // Texture coordinates as BuildUvSphere lays them out. A triangle
+  // straddling the seam takes copies of its vertices on the u = 0 side
+  // shifted to u + 1, and a triangle touching a pole takes its own copy of
+  // the pole at the middle of its other two vertices' u.
+  std::vector<glm::vec2> texture_coordinate(position.size());
+  for (std::size_t i = 0; i < position.size(); ++i) {
+    const glm::vec3 &p{position[i]};
+    float u{static_cast<float>(std::atan2(p.z, p.x) / (2.0 * M_PI))};
+    texture_coordinate[i] = glm::vec2{
+        u < 0.0f ? u + 1.0f : u,
+        static_cast<float>(std::acos(glm::clamp(p.y, -1.0f, 1.0f)) / M_PI)};
+  }
+  std::vector<unsigned> source(position.size());
+  for (unsigned i = 0; i < source.size(); ++i) {
+    source[i] = i;
+  }
+  std::unordered_map<unsigned, unsigned> seam_copy;
+  for (std::size_t i = 0; i < triangle.size(); i += 3) {
+    unsigned *t{&triangle[i]};
+    float low{1.0f}, high{0.0f};
+    for (unsigned j = 0; j < 3; ++j) {
+      if (t[j] != kTop && t[j] != kBottom) {
+        low = std::min(low, texture_coordinate[t[j]].x);
+        high = std::max(high, texture_coordinate[t[j]].x);
+      }
+    }
+    if (high - low > 0.5f) {
+      for (unsigned j = 0; j < 3; ++j) {
+        if (t[j] != kTop && t[j] != kBottom &&
+            texture_coordinate[t[j]].x < 0.5f) {
+          auto inserted = seam_copy.insert(
+              std::make_pair(t[j], static_cast<unsigned>(source.size())));
+          if (inserted.second) {
+            source.push_back(t[j]);
+            texture_coordinate.push_back(texture_coordinate[t[j]] +
+                                         glm::vec2{1.0f, 0.0f});
+          }
+          t[j] = inserted.first->second;
+        }
+      }
+    }
+    for (unsigned j = 0; j < 3; ++j) {
+      if (t[j] == kTop || t[j] == kBottom) {
+        float u{0.5f * (texture_coordinate[t[(j + 1) % 3]].x +
+                        texture_coordinate[t[(j + 2) % 3]].x)};
+        source.push_back(t[j]);
+        texture_coordinate.push_back(
+            glm::vec2{u, texture_coordinate[t[j]].y});
+        t[j] = static_cast<unsigned>(source.size() - 1);
+      }
+    }
+  }
+
+  // the original poles are no longer referenced; skip them
+  std::vector<unsigned> remap(source.size());
+  unsigned vertex_count{0};
+  for (unsigned i = 0; i < source.size(); ++i) {
+    remap[i] = vertex_count;
+    if (i != kTop && i != kBottom) {
+      ++vertex_count;
+    }
+  }
+  MeshBuilder builder{mesh};
+  builder.Begin(vertex_count, triangle.size());
+  for (unsigned i = 0; i < source.size(); ++i) {
+    if (i != kTop && i != kBottom) {
+      const glm::vec3 &normal{position[source[i]]};
+      builder.AddVertex(normal * radius, normal, texture_coordinate[i]);
+    }
+  }
+  for (std::size_t i = 0; i < triangle.size(); i += 3) {
+    builder.AddTriangle(remap[triangle[i]], remap[triangle[i + 1]],
+                        remap[triangle[i + 2]]);
+  }
+  builder.End();
+  mesh.error = SphereError(mesh, radius);
+}
+
+std::uint16_t FloatToHalf(float value) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  std::uint32_t sign{(bits >> 16) & 0x8000u};
+  std::uint32_t magnitude{bits & 0x7fffffffu};
+  if (magnitude >= 0x7f800000u) {
+    // infinity stays infinity, NaN stays NaN
+    return static_cast<std::uint16_t>(sign | 0x7c00u |
+                                      (magnitude > 0x7f800000u ? 0x200u : 0));
+  }
+  if (magnitude >= 0x477ff000u) {
+    // rounds past 65504
+    return static_cast<std::uint16_t>(sign | 0x7c00u);
+  }
+  if (magnitude < 0x38800000u) {
+    // below 2^-14: a subnormal half, which float arithmetic rounds for us
+    float subnormal;
+    std::memcpy(&subnormal, &magnitude, sizeof(subnormal));
+    float units{std::nearbyint(subnormal * 16777216.0f)};
+    return static_cast<std::uint16_t>(sign | static_cast<std::uint32_t>(units));
+  }
+  // rebias the exponent from 127 to 15 and round the mantissa to nearest
+  // even, letting a carry run on into the exponent
+  std::uint32_t half{(magnitude - 0x38000000u) >> 13};
+  std::uint32_t rest{magnitude & 0x1fffu};
+  if (rest > 0x1000u || (rest == 0x1000u && (half & 1))) {
+    ++half;
+  }
+  return static_cast<std::uint16_t>(sign | half);
+}
+
+void TangentBasis(const glm::vec3 &normal, bool upper, glm::vec3 &x,
+                  glm::vec3 &y) {
+  // Duff et al., Building an Orthonormal Basis, Revisited
+  float sign{upper ? 1.0f : -1.0f};
+  float a{-1.0f / (sign + normal.z)};
+  float b{normal.x * normal.y * a};
+  x = glm::vec3{1.0f + sign * normal.x * normal.x * a, sign * b,
+                -sign * normal.x};
+  y = glm::vec3{b, sign + normal.y * normal.y * a, -normal.y};
+}
+
+void GenerateTangents(MeshData &mesh) {
+  std::size_t vertex_count{mesh.vertex.size()};
+  std::vector<glm::vec3> tangent(vertex_count, glm::vec3{0.0f});
+  std::vector<glm::vec3> bitangent(vertex_count, glm::vec3{0.0f});
+  auto project = [](const glm::vec3 &v, const glm::vec3 &normal) {
+    glm::vec3 p{v - normal * glm::dot(normal, v)};
+    float length{glm::length(p)};
+    return length > 0.0f ? p / length : p;
+  };
+  for (std::size_t i = 0; i + 2 < mesh.IndexCount(); i += 3) {
+    unsigned corner[3]{mesh.GetIndex(i), mesh.GetIndex(i + 1),
+                       mesh.GetIndex(i + 2)};
+    const Vertex &v0{mesh.vertex[corner[0]]};
+    const Vertex &v1{mesh.vertex[corner[1]]};
+    const Vertex &v2{mesh.vertex[corner[2]]};
+    glm::vec3 e1{v1.position - v0.position};
+    glm::vec3 e2{v2.position - v0.position};
+    glm::vec2 d1{v1.texture_coordinate - v0.texture_coordinate};
+    glm::vec2 d2{v2.texture_coordinate - v0.texture_coordinate};
+    float determinant{d1.x * d2.y - d2.x * d1.y};
+    if (determinant == 0.0f) {
+      continue;
+    }
+    glm::vec3 face_tangent{(e1 * d2.y - e2 * d1.y) / determinant};
+    glm::vec3 face_bitangent{(e2 * d1.x - e1 * d2.x) / determinant};
+    for (int k = 0; k < 3; ++k) {
+      const Vertex &v{mesh.vertex[corner[k]]};
+      glm::vec3 a{mesh.vertex[corner[(k + 1) % 3]].position - v.position};
+      glm::vec3 b{mesh.vertex[corner[(k + 2) % 3]].position - v.position};
+      float length{glm::length(a) * glm::length(b)};
+      if (length == 0.0f) {
+        continue;
+      }
+      float angle{std::acos(glm::clamp(glm::dot(a, b) / length, -1.0f, 1.0f))};
+      tangent[corner[k]] += project(face_tangent, v.normal) * angle;
+      bitangent[corner[k]] += project(face_bitangent, v.normal) * angle;
+    }
+  }
+  for (std::size_t i = 0; i < vertex_count; ++i) {
+    Vertex &vertex{mesh.vertex[i]};
+    const glm::vec3 &normal{vertex.normal};
+    glm::vec3 t{tangent[i] - normal * glm::dot(normal, tangent[i])};
+    float length{glm::length(t)};
+    if (length > 1e-6f) {
+      t /= length;
+    } else {
+      glm::vec3 y;
+      TangentBasis(normal, normal.z >= 0.0f, t, y);
+    }
+    float sign{glm::dot(glm::cross(normal, t), bitangent[i]) < 0.0f ? -1.0f
+                                                                   : 1.0f};
+    vertex.tangent = glm::vec4{t, sign};
+  }
+}
+
+std::uint32_t PackNormal(const glm::vec3 &normal, const glm::vec4 &tangent) {
+  // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half
+  // over the upper
+  glm::vec3 n{normal /
+              (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z))};
+  float x{n.x}, y{n.y};
+  if (n.z < 0.0f) {
+    x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+    y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  auto quantize = [](float value) {
+    return static_cast<int>(
+        std::lround(glm::clamp(value, -1.0f, 1.0f) * kOctahedralScale));
+  };
+  int qx{quantize(x)}, qy{quantize(y)};
+
+  // measure the tangent in the basis pbr.vs rebuilds from the decoded
+  // normal, choosing the basis's side from the integer fields as it does
+  glm::vec2 e{qx / kOctahedralScale, qy / kOctahedralScale};
+  glm::vec3 decoded{e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y)};
+  if (decoded.z < 0.0f) {
+    decoded.x = (1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f);
+    decoded.y = (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  decoded = glm::normalize(decoded);
+  glm::vec3 basis_x, basis_y;
+  TangentBasis(decoded, std::abs(qx) + std::abs(qy) <= kOctahedralScale,
+               basis_x, basis_y);
+  glm::vec3 t{tangent};
+  float angle{std::atan2(glm::dot(t, basis_y), glm::dot(t, basis_x))};
+  int qz{static_cast<int>(std::lround(angle / M_PI * kOctahedralScale))};
+  qz = std::max(-511, std::min(511, qz));
+  std::uint32_t w{tangent.w < 0.0f ? 3u : 1u};
+  return (static_cast<std::uint32_t>(qx) & 0x3ffu) |
+         (static_cast<std::uint32_t>(qy) & 0x3ffu) << 10 |
+         (static_cast<std::uint32_t>(qz) & 0x3ffu) << 20 | w << 30;
+}
+
+void PackVertices(const MeshData &mesh, std::vector<PackedVertex> &packed,
+                  glm::vec3 &position_offset, glm::vec3 &position_scale) {
+  glm::vec3 low{0.0f}, high{0.0f};
+  if (!mesh.vertex.empty()) {
+    low = high = mesh.vertex[0].position;
+  }
+  for (const Vertex &vertex : mesh.vertex) {
+    low = glm::min(low, vertex.position);
+    high = glm::max(high, vertex.position);
+  }
+  position_offset = low;
+  position_scale = high - low;
+  glm::vec3 inverse_scale;
+  for (int i = 0; i < 3; ++i) {
+    inverse_scale[i] =
+        position_scale[i] > 0.0f ? 65535.0f / position_scale[i] : 0.0f;
+  }
+
+  packed.resize(mesh.vertex.size());
+  for (std::size_t i = 0; i < mesh.vertex.size(); ++i) {
+    const Vertex &vertex{mesh.vertex[i]};
+    PackedVertex &out{packed[i]};
+    for (int j = 0; j < 3; ++j) {
+      out.position[j] = static_cast<std::uint16_t>(std::lround(
+          glm::clamp((vertex.position[j] - low[j]) * inverse_scale[j], 0.0f,
+                     65535.0f)));
+    }
+    out.position[3] = 0;
+    out.normal = PackNormal(vertex.normal, vertex.tangent);
+    out.texture_coordinate[0] = FloatToHalf(vertex.texture_coordinate.x);
+    out.texture_coordinate[1] = FloatToHalf(vertex.texture_coordinate.y);
+  }
+}
+
+float PixelsPerUnit(float distance, float yfov, float viewport_height) {
+  return viewport_height / (2.0f * distance * std::tan(0.5f * yfov));
+}
+
+unsigned SelectLod(const float *error, unsigned lod_count,
+                   float pixels_per_unit, unsigned current,
+                   float max_pixel_error, float hysteresis) {
+  auto coarsest = [&](float limit) {
+    unsigned lod{0};
+    while (lod + 1 < lod_count && error[lod + 1] * pixels_per_unit <= limit) {
+      ++lod;
+    }
+    return lod;
+  };
+  if (current >= lod_count) {
+    current = lod_count - 1;
+  }
+  float pixel_error{error[current] * pixels_per_unit};
+  if (pixel_error > max_pixel_error * (1.0f + hysteresis)) {
+    return coarsest(max_pixel_error);
+  }
+  return std::max(current, coarsest(max_pixel_error * (1.0f - hysteresis)));
+}
+
+};  // namespace graphics
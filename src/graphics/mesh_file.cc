@@ -0,0 +1,252 @@
+#include "graphics/mesh_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "graphics/cull.h"
+#include "graphics/mesh_optimizer.h"
+
+namespace graphics {
+
+// meshlets are stored as laid out in memory
+static_assert(sizeof(Meshlet) == 14 * 4,
+              "Meshlet changed; update the mesh file and its version");
+
+std::string MeshShapeName(MeshShape shape, unsigned tessellation) {
+  switch (shape) {
+    case kUvSphere:
+      return "uv_sphere_" + std::to_string(tessellation);
+    case kCube:
+      return "cube";
+    case kIcosphere:
+      return "icosphere_" + std::to_string(tessellation);
+    case kSimplifiedIcosphere:
+      return "simplified_icosphere_" + std::to_string(tessellation);
+  }
+  return "";
+}
+
+void BuildShape(MeshShape shape, unsigned tessellation, MeshData &data,
+                std::vector<MeshLod> &lod) {
+  switch (shape) {
+    case kUvSphere:
+      BuildUvSphere(data, tessellation, 2.0f);
+      break;
+    case kCube:
+      BuildCube(data);
+      break;
+    case kIcosphere:
+    case kSimplifiedIcosphere:
+      BuildIcosphere(data, tessellation, 2.0f);
+      break;
+  }
+  GenerateTangents(data);
+  lod.clear();
+  if (shape == kSimplifiedIcosphere) {
+    BuildLodChain(data, lod, 0.25f, 20);
+  } else {
+    lod.resize(1);
+    lod[0].index.resize(data.IndexCount());
+    for (std::size_t i = 0; i < lod[0].index.size(); ++i) {
+      lod[0].index[i] = data.GetIndex(i);
+    }
+    lod[0].error = data.error;
+  }
+}
+
+void BuildShapeAsset(MeshShape shape, unsigned tessellation,
+                     MeshAsset &asset) {
+  MeshData data;
+  std::vector<MeshLod> lod;
+  BuildShape(shape, tessellation, data, lod);
+  BuildMeshAsset(data, lod, asset);
+}
+
+void BuildMeshAsset(const MeshData &mesh, const std::vector<MeshLod> &lod,
+                    MeshAsset &asset) {
+  asset.lod.clear();
+  asset.meshlet.clear();
+  std::vector<unsigned> index;
+  std::vector<unsigned> cluster;
+  std::vector<Meshlet> meshlet;
+  for (const MeshLod &source : lod) {
+    MeshData level{LodMesh(mesh, source)};
+    OptimizeVertexCache(level, cluster);
+    OptimizeOverdraw(level, cluster);
+    BuildMeshlets(level, meshlet);
+    MeshFileLod entry{static_cast<std::uint32_t>(index.size()),
+                      static_cast<std::uint32_t>(level.IndexCount()),
+                      static_cast<std::uint32_t>(asset.meshlet.size()),
+                      static_cast<std::uint32_t>(meshlet.size()),
+                      source.error, 0};
+    asset.lod.push_back(entry);
+    for (Meshlet &m : meshlet) {
+      m.first += entry.index_first;
+      asset.meshlet.push_back(m);
+    }
+    for (std::size_t i = 0; i < level.IndexCount(); ++i) {
+      index.push_back(level.GetIndex(i));
+    }
+  }
+  asset.mesh.vertex = mesh.vertex;
+  asset.mesh.index_size = mesh.index_size;
+  asset.mesh.error = mesh.error;
+  asset.mesh.index.resize(index.size() * asset.mesh.index_size);
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    asset.mesh.SetIndex(i, index[i]);
+  }
+  // renumbering keeps the order of the indices, so the ranges still hold
+  OptimizeVertexFetch(asset.mesh);
+}
+
+static std::uint64_t AlignUp(std::uint64_t offset) {
+  return (offset + kMeshFileAlignment - 1) & ~(kMeshFileAlignment - 1);
+}
+
+void SerializeMeshFile(const MeshAsset &asset,
+                       std::vector<unsigned char> &data) {
+  const MeshData &mesh{asset.mesh};
+  MeshFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMeshFileMagic, sizeof(kMeshFileMagic));
+  header.version = kMeshFileVersion;
+  header.vertex_count = static_cast<std::uint32_t>(mesh.vertex.size());
+  header.index_count = static_cast<std::uint32_t>(mesh.IndexCount());
+  header.index_size = mesh.index_size;
+  header.lod_count = static_cast<std::uint32_t>(asset.lod.size());
+  header.meshlet_count = static_cast<std::uint32_t>(asset.meshlet.size());
+  Aabb bounds{MeshBounds(mesh)};
+  std::memcpy(header.bounds_min, &bounds.min[0], sizeof(float) * 3);
+  std::memcpy(header.bounds_max, &bounds.max[0], sizeof(float) * 3);
+  std::vector<PackedVertex> packed;
+  glm::vec3 position_offset;
+  glm::vec3 position_scale;
+  PackVertices(mesh, packed, position_offset, position_scale);
+  std::memcpy(header.position_offset, &position_offset[0], sizeof(float) * 3);
+  std::memcpy(header.position_scale, &position_scale[0], sizeof(float) * 3);
+
+  std::uint64_t table_offset{sizeof(MeshFileHeader)};
+  std::uint64_t meshlet_offset{table_offset +
+                               asset.lod.size() * sizeof(MeshFileLod)};
+  header.vertex_offset =
+      AlignUp(meshlet_offset + asset.meshlet.size() * sizeof(Meshlet));
+  header.packed_vertex_offset =
+      AlignUp(header.vertex_offset + mesh.vertex.size() * sizeof(Vertex));
+  header.index_offset = AlignUp(header.packed_vertex_offset +
+                                packed.size() * sizeof(PackedVertex));
+  header.size = header.index_offset + mesh.index.size();
+
+  data.assign(header.size, 0);
+  auto put = [&](std::uint64_t offset, const void *source, std::size_t size) {
+    if (size > 0) {
+      std::memcpy(data.data() + offset, source, size);
+    }
+  };
+  put(0, &header, sizeof(header));
+  put(table_offset, asset.lod.data(), asset.lod.size() * sizeof(MeshFileLod));
+  put(meshlet_offset, asset.meshlet.data(),
+      asset.meshlet.size() * sizeof(Meshlet));
+  put(header.vertex_offset, mesh.vertex.data(),
+      mesh.vertex.size() * sizeof(Vertex));
+  put(header.packed_vertex_offset, packed.data(),
+      packed.size() * sizeof(PackedVertex));
+  put(header.index_offset, mesh.index.data(), mesh.index.size());
+}
+
+void WriteMeshFile(const std::string &path, const MeshAsset &asset) {
+  std::vector<unsigned char> data;
+  SerializeMeshFile(asset, data);
+  std::ofstream file{path, std::ios::binary | std::ios::trunc};
+  if (!file.write(reinterpret_cast<const char *>(data.data()),
+                  static_cast<std::streamsize>(data.size()))) {
+    throw std::string{"fail to write "} + path;
+  }
+}
+
+void ParseMeshFile(const unsigned char *data, std::size_t size,
+                   MeshFileView &view) {
+  if (size < sizeof(MeshFileHeader)) {
+    throw std::string{"truncated mesh file"};
+  }
+  const MeshFileHeader &header{
+      *reinterpret_cast<const MeshFileHeader *>(data)};
+  if (std::memcmp(header.magic, kMeshFileMagic, sizeof(kMeshFileMagic)) !=
+      0) {
+    throw std::string{"not a mesh file"};
+  }
+  if (header.version != kMeshFileVersion) {
+    throw "mesh file version " + std::to_string(header.version) +
+        ", expected " + std::to_string(kMeshFileVersion);
+  }
+  std::uint64_t table_end{sizeof(MeshFileHeader) +
+                          std::uint64_t{header.lod_count} *
+                              sizeof(MeshFileLod) +
+                          std::uint64_t{header.meshlet_count} *
+                              sizeof(Meshlet)};
+  std::uint64_t index_bytes{std::uint64_t{header.index_count} *
+                            header.index_size};
+  if (header.size != size || header.lod_count == 0 ||
+      (header.index_size != 2 && header.index_size != 4) ||
+      header.vertex_offset % kMeshFileAlignment != 0 ||
+      header.packed_vertex_offset % kMeshFileAlignment != 0 ||
+      header.index_offset % kMeshFileAlignment != 0 ||
+      header.vertex_offset < table_end ||
+      header.vertex_offset +
+              std::uint64_t{header.vertex_count} * sizeof(Vertex) >
+          header.packed_vertex_offset ||
+      header.packed_vertex_offset +
+              std::uint64_t{header.vertex_count} * sizeof(PackedVertex) >
+          header.index_offset ||
+      header.index_offset + index_bytes != size) {
+    throw std::string{"malformed mesh file"};
+  }
+  view.header = &header;
+  view.lod = reinterpret_cast<const MeshFileLod *>(data +
+                                                   sizeof(MeshFileHeader));
+  view.meshlet = reinterpret_cast<const Meshlet *>(
+      view.lod + header.lod_count);
+  view.vertex = reinterpret_cast<const Vertex *>(data + header.vertex_offset);
+  view.packed_vertex = reinterpret_cast<const PackedVertex *>(
+      data + header.packed_vertex_offset);
+  view.index = data + header.index_offset;
+  // GL does not bounds check, so every range must lie inside the file
+  for (std::uint32_t l = 0; l < header.lod_count; ++l) {
+    const MeshFileLod &lod{view.lod[l]};
+    if (std::uint64_t{lod.index_first} + lod.index_count >
+            header.index_count ||
+        std::uint64_t{lod.meshlet_first} + lod.meshlet_count >
+            header.meshlet_count) {
+      throw std::string{"malformed mesh file"};
+    }
+  }
+  for (std::uint32_t m = 0; m < header.meshlet_count; ++m) {
+    if (std::uint64_t{view.meshlet[m].first} + view.meshlet[m].count >
+        header.index_count) {
+      throw std::string{"malformed mesh file"};
+    }
+  }
+  unsigned max_index{0};
+  for (std::uint32_t i = 0; i < header.index_count; ++i) {
+    unsigned index;
+    if (header.index_size == 2) {
+      std::uint16_t short_index;
+      std::memcpy(&short_index, view.index + 2 * i, 2);
+      index = short_index;
+    } else {
+      std::uint32_t long_index;
+      std::memcpy(&long_index, view.index + 4 * i, 4);
+      index = long_index;
+    }
+    max_index = std::max(max_index, index);
+  }
+  if (header.index_count > 0 && max_index >= header.vertex_count) {
+    throw std::string{"mesh file index out of range"};
+  }
+}
+
+};  // namespace graphics
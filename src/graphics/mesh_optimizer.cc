@@ -0,0 +1,386 @@
+#include "graphics/mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace graphics {
+
+static std::vector<unsigned> GetIndices(const MeshData &mesh) {
+  std::vector<unsigned> index(mesh.IndexCount());
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    index[i] = mesh.GetIndex(i);
+  }
+  return index;
+}
+
+static void SetIndices(MeshData &mesh, const std::vector<unsigned> &index) {
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    mesh.SetIndex(i, index[i]);
+  }
+}
+
+// A FIFO post-transform cache. A vertex stays cached until size more
+// misses have happened after its own.
+class VertexCache {
+ public:
+  VertexCache(std::size_t vertex_count, unsigned size)
+      : size_{size}, time_{size + 1}, stamp_(vertex_count, 0) {}
+  // Returns whether vertex missed, loading it if so.
+  bool Load(unsigned vertex) {
+    if (time_ - stamp_[vertex] <= size_) {
+      return false;
+    }
+    stamp_[vertex] = time_++;
+    return true;
+  }
+  void Flush() { time_ += size_; }
+
+ private:
+  unsigned size_;
+  unsigned time_;
+  std::vector<unsigned> stamp_;
+};
+
+static unsigned CacheMisses(const std::vector<unsigned> &index,
+                            std::size_t vertex_count, unsigned cache_size) {
+  VertexCache cache{vertex_count, cache_size};
+  unsigned misses{0};
+  for (unsigned vertex : index) {
+    misses += cache.Load(vertex);
+  }
+  return misses;
+}
+
+// Rasterizes the mesh looking down each axis both ways into a kGridSize
+// square, depth tested in index order, counting fragments that pass against
+// pixels covered once all are drawn.
+static float Overdraw(const MeshData &mesh,
+                      const std::vector<unsigned> &index) {
+  const int kGridSize{256};
+  if (index.empty()) {
+    return 0.0f;
+  }
+  glm::vec3 low{std::numeric_limits<float>::max()};
+  glm::vec3 high{-std::numeric_limits<float>::max()};
+  for (unsigned i : index) {
+    low = glm::min(low, mesh.vertex[i].position);
+    high = glm::max(high, mesh.vertex[i].position);
+  }
+  glm::vec3 extent{high - low};
+  float scale{(kGridSize - 1) /
+              std::max(std::max(extent.x, extent.y),
+                       std::max(extent.z, std::numeric_limits<float>::min()))};
+
+  std::vector<float> depth(kGridSize * kGridSize);
+  double shaded{0.0}, covered{0.0};
+  for (int axis = 0; axis < 3; ++axis) {
+    int u_axis{(axis + 1) % 3}, v_axis{(axis + 2) % 3};
+    for (float direction : {-1.0f, 1.0f}) {
+      std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+      for (std::size_t t = 0; t + 2 < index.size(); t += 3) {
+        glm::vec3 p[3];
+        for (int j = 0; j < 3; ++j) {
+          p[j] = (mesh.vertex[index[t + j]].position - low) * scale;
+        }
+        // the view looks along direction on axis; cull triangles facing away
+        glm::vec3 normal{glm::cross(p[1] - p[0], p[2] - p[0])};
+        if (normal[axis] * direction >= 0.0f) {
+          continue;
+        }
+        float x[3], y[3], z[3];
+        for (int j = 0; j < 3; ++j) {
+          x[j] = p[j][u_axis];
+          y[j] = p[j][v_axis];
+          z[j] = p[j][axis] * direction;
+        }
+        float area{(x[1] - x[0]) * (y[2] - y[0]) -
+                   (y[1] - y[0]) * (x[2] - x[0])};
+        if (area == 0.0f) {
+          continue;
+        }
+        if (area < 0.0f) {
+          std::swap(x[1], x[2]);
+          std::swap(y[1], y[2]);
+          std::swap(z[1], z[2]);
+          area = -area;
+        }
+        int x_low{std::max(0, static_cast<int>(std::floor(
+                                  std::min({x[0], x[1], x[2]}))))};
+        int x_high{std::min(kGridSize - 1, static_cast<int>(std::ceil(
+                                               std::max({x[0], x[1], x[2]}))))};
+        int y_low{std::max(0, static_cast<int>(std::floor(
+                                  std::min({y[0], y[1], y[2]}))))};
+        int y_high{std::min(kGridSize - 1, static_cast<int>(std::ceil(
+                                               std::max({y[0], y[1], y[2]}))))};
+        for (int py = y_low; py <= y_high; ++py) {
+          for (int px = x_low; px <= x_high; ++px) {
+            float sx{px + 0.5f}, sy{py + 0.5f};
+            float w[3];
+            bool inside{true};
+            for (int e = 0; e < 3 && inside; ++e) {
+              int a{(e + 1) % 3}, b{(e + 2) % 3};
+              float dx{x[b] - x[a]}, dy{y[b] - y[a]};
+              w[e] = dx * (sy - y[a]) - dy * (sx - x[a]);
+              // an edge shared by two triangles runs opposite ways in each,
+              // so exactly one of them owns samples on it
+              inside = w[e] > 0.0f ||
+                       (w[e] == 0.0f && (dy > 0.0f || (dy == 0.0f && dx < 0)));
+            }
+            if (!inside) {
+              continue;
+            }
+            float sample_depth{(w[0] * z[0] + w[1] * z[1] + w[2] * z[2]) /
+                               area};
+            float &stored{depth[py * kGridSize + px]};
+            if (sample_depth < stored) {
+              if (stored == std::numeric_limits<float>::max()) {
+                ++covered;
+              }
+              stored = sample_depth;
+              ++shaded;
+            }
+          }
+        }
+      }
+    }
+  }
+  return covered > 0.0 ? static_cast<float>(shaded / covered) : 0.0f;
+}
+
+MeshStatistics AnalyzeMesh(const MeshData &mesh, unsigned cache_size) {
+  MeshStatistics statistics{0.0f, 0.0f, 0.0f};
+  std::vector<unsigned> index{GetIndices(mesh)};
+  if (index.empty()) {
+    return statistics;
+  }
+  std::vector<bool> used(mesh.vertex.size(), false);
+  std::size_t used_count{0};
+  for (unsigned i : index) {
+    if (!used[i]) {
+      used[i] = true;
+      ++used_count;
+    }
+  }
+  float misses{
+      static_cast<float>(CacheMisses(index, mesh.vertex.size(), cache_size))};
+  statistics.acmr = misses / (index.size() / 3);
+  statistics.atvr = misses / used_count;
+  statistics.overdraw = Overdraw(mesh, index);
+  return statistics;
+}
+
+void OptimizeVertexCache(MeshData &mesh, std::vector<unsigned> &cluster,
+                         unsigned cache_size, float threshold) {
+  std::vector<unsigned> index{GetIndices(mesh)};
+  std::size_t vertex_count{mesh.vertex.size()};
+  std::size_t triangle_count{index.size() / 3};
+  cluster.clear();
+  if (triangle_count == 0) {
+    return;
+  }
+
+  // triangles around each vertex, and how many of them are left to emit
+  std::vector<unsigned> live(vertex_count, 0);
+  for (unsigned i : index) {
+    ++live[i];
+  }
+  std::vector<unsigned> offset(vertex_count + 1, 0);
+  for (std::size_t v = 0; v < vertex_count; ++v) {
+    offset[v + 1] = offset[v] + live[v];
+  }
+  std::vector<unsigned> adjacency(index.size());
+  std::vector<unsigned> fill(offset.begin(), offset.end() - 1);
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    adjacency[fill[index[i]]++] = static_cast<unsigned>(i / 3);
+  }
+
+  // Tipsify: fan out around the current vertex, then move to whichever of
+  // its neighbours will still be cached after their remaining triangles
+  // are emitted and has been cached longest; failing that, back up to the
+  // most recent vertex with triangles left, then to the next in input order.
+  std::vector<unsigned> stamp(vertex_count, 0);
+  unsigned time{cache_size + 1};
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<unsigned> dead_end;
+  std::vector<unsigned> candidate;
+  std::vector<unsigned> hard_boundary;
+  std::vector<unsigned> output;
+  output.reserve(index.size());
+  dead_end.reserve(index.size());
+  std::size_t cursor{0};
+  long current{0};
+  while (live[current] == 0) {
+    ++current;
+  }
+  while (current >= 0) {
+    candidate.clear();
+    for (unsigned a = offset[current]; a < offset[current + 1]; ++a) {
+      unsigned t{adjacency[a]};
+      if (emitted[t]) {
+        continue;
+      }
+      emitted[t] = true;
+      for (unsigned j = 0; j < 3; ++j) {
+        unsigned v{index[3 * t + j]};
+        output.push_back(v);
+        dead_end.push_back(v);
+        candidate.push_back(v);
+        --live[v];
+        if (time - stamp[v] > cache_size) {
+          stamp[v] = time++;
+        }
+      }
+    }
+    long next{-1};
+    long best_priority{-1};
+    for (unsigned v : candidate) {
+      if (live[v] == 0) {
+        continue;
+      }
+      long priority{0};
+      if (time - stamp[v] + 2 * live[v] <= cache_size) {
+        priority = time - stamp[v];
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        next = v;
+      }
+    }
+    if (next < 0) {
+      while (!dead_end.empty() && next < 0) {
+        unsigned v{dead_end.back()};
+        dead_end.pop_back();
+        if (live[v] > 0) {
+          next = v;
+        }
+      }
+      while (next < 0 && cursor < vertex_count) {
+        if (live[cursor] > 0) {
+          next = static_cast<long>(cursor);
+        }
+        ++cursor;
+      }
+      hard_boundary.push_back(static_cast<unsigned>(output.size() / 3));
+    }
+    current = next;
+  }
+  SetIndices(mesh, output);
+
+  // Soft boundaries: within each run, start a new cluster as soon as the
+  // current one's ACMR, counted from an empty cache, is close enough to the
+  // mesh's that drawing it anywhere else costs little.
+  float acmr{static_cast<float>(CacheMisses(output, vertex_count, cache_size)) /
+             triangle_count};
+  VertexCache cache{vertex_count, cache_size};
+  std::size_t boundary{0};
+  unsigned misses{0}, triangles{0};
+  for (std::size_t t = 0; t < triangle_count; ++t) {
+    if (triangles == 0 ||
+        (boundary < hard_boundary.size() && hard_boundary[boundary] == t)) {
+      cluster.push_back(static_cast<unsigned>(t));
+      cache.Flush();
+      misses = 0;
+      triangles = 0;
+      while (boundary < hard_boundary.size() && hard_boundary[boundary] <= t) {
+        ++boundary;
+      }
+    }
+    for (unsigned j = 0; j < 3; ++j) {
+      misses += cache.Load(output[3 * t + j]);
+    }
+    ++triangles;
+    if (misses <= acmr * threshold * triangles) {
+      triangles = 0;
+    }
+  }
+}
+
+void OptimizeOverdraw(MeshData &mesh, const std::vector<unsigned> &cluster) {
+  std::vector<unsigned> index{GetIndices(mesh)};
+  std::size_t triangle_count{index.size() / 3};
+  if (cluster.size() < 2) {
+    return;
+  }
+
+  // Sander, Nehab and Barczak's linear-speed sort: a cluster whose
+  // area-weighted centroid lies far out along its own average normal, as
+  // seen from the mesh's centroid, is more likely to occlude than be
+  // occluded.
+  std::vector<glm::vec3> centroid(cluster.size(), glm::vec3{0.0f});
+  std::vector<glm::vec3> normal(cluster.size(), glm::vec3{0.0f});
+  std::vector<float> area(cluster.size(), 0.0f);
+  glm::vec3 mesh_centroid{0.0f};
+  float mesh_area{0.0f};
+  for (std::size_t c = 0; c < cluster.size(); ++c) {
+    std::size_t end{c + 1 < cluster.size() ? cluster[c + 1] : triangle_count};
+    for (std::size_t t = cluster[c]; t < end; ++t) {
+      const glm::vec3 &a{mesh.vertex[index[3 * t]].position};
+      const glm::vec3 &b{mesh.vertex[index[3 * t + 1]].position};
+      const glm::vec3 &d{mesh.vertex[index[3 * t + 2]].position};
+      glm::vec3 n{glm::cross(b - a, d - a)};
+      float w{glm::length(n)};
+      centroid[c] += (a + b + d) * (w / 3.0f);
+      normal[c] += n;
+      area[c] += w;
+    }
+    mesh_centroid += centroid[c];
+    mesh_area += area[c];
+  }
+  if (mesh_area > 0.0f) {
+    mesh_centroid /= mesh_area;
+  }
+  std::vector<float> key(cluster.size());
+  std::vector<unsigned> order(cluster.size());
+  for (std::size_t c = 0; c < cluster.size(); ++c) {
+    glm::vec3 c_centroid{area[c] > 0.0f ? centroid[c] / area[c]
+                                         : mesh_centroid};
+    float length{glm::length(normal[c])};
+    key[c] = length > 0.0f
+                 ? glm::dot(c_centroid - mesh_centroid, normal[c]) / length
+                 : 0.0f;
+    order[c] = static_cast<unsigned>(c);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](unsigned a, unsigned b) { return key[a] > key[b]; });
+
+  std::vector<unsigned> output;
+  output.reserve(index.size());
+  for (unsigned c : order) {
+    std::size_t end{c + 1 < cluster.size() ? cluster[c + 1] : triangle_count};
+    output.insert(output.end(), index.begin() + 3 * cluster[c],
+                  index.begin() + 3 * end);
+  }
+  SetIndices(mesh, output);
+}
+
+void OptimizeVertexFetch(MeshData &mesh) {
+  const unsigned kUnused{std::numeric_limits<unsigned>::max()};
+  std::vector<unsigned> index{GetIndices(mesh)};
+  std::vector<unsigned> remap(mesh.vertex.size(), kUnused);
+  std::vector<Vertex> vertex;
+  vertex.reserve(mesh.vertex.size());
+  for (unsigned &i : index) {
+    if (remap[i] == kUnused) {
+      remap[i] = static_cast<unsigned>(vertex.size());
+      vertex.push_back(mesh.vertex[i]);
+    }
+    i = remap[i];
+  }
+  // vertices no triangle uses are dropped
+  mesh.vertex.swap(vertex);
+  SetIndices(mesh, index);
+}
+
+void OptimizeMesh(MeshData &mesh) {
+  std::vector<unsigned> cluster;
+  OptimizeVertexCache(mesh, cluster);
+  OptimizeOverdraw(mesh, cluster);
+  OptimizeVertexFetch(mesh);
+}
+
+};  // namespace graphics
@@ -0,0 +1,238 @@
+#include "graphics/meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "graphics/mesh_optimizer.h"
+
+namespace graphics {
+
+// Fills the bounds of meshlet from its triangles, index[meshlet.first] on.
+static void MeshletBounds(const MeshData &mesh,
+                          const std::vector<unsigned> &index,
+                          Meshlet &meshlet) {
+  glm::vec3 low{std::numeric_limits<float>::max()};
+  glm::vec3 high{-std::numeric_limits<float>::max()};
+  for (unsigned i = meshlet.first; i < meshlet.first + meshlet.count; ++i) {
+    low = glm::min(low, mesh.vertex[index[i]].position);
+    high = glm::max(high, mesh.vertex[index[i]].position);
+  }
+  meshlet.center = 0.5f * (low + high);
+  meshlet.radius = 0.0f;
+  for (unsigned i = meshlet.first; i < meshlet.first + meshlet.count; ++i) {
+    meshlet.radius =
+        std::max(meshlet.radius, glm::length(mesh.vertex[index[i]].position -
+                                             meshlet.center));
+  }
+
+  // the cone around the mean face normal holding every face normal
+  std::vector<glm::vec3> normal;
+  std::vector<glm::vec3> corner;
+  glm::vec3 sum{0.0f};
+  for (unsigned i = meshlet.first; i < meshlet.first + meshlet.count;
+       i += 3) {
+    const glm::vec3 &p0{mesh.vertex[index[i]].position};
+    glm::vec3 n{glm::cross(mesh.vertex[index[i + 1]].position - p0,
+                           mesh.vertex[index[i + 2]].position - p0)};
+    float length{glm::length(n)};
+    if (length > 0.0f) {
+      normal.push_back(n / length);
+      corner.push_back(p0);
+      sum += n / length;
+    }
+  }
+  meshlet.cone_apex = meshlet.center;
+  meshlet.cone_axis = glm::vec3{0.0f, 0.0f, 1.0f};
+  meshlet.cone_cutoff = 2.0f;
+  float sum_length{glm::length(sum)};
+  if (sum_length <= 0.0f) {
+    return;
+  }
+  glm::vec3 axis{sum / sum_length};
+  float min_dot{1.0f};
+  for (const glm::vec3 &n : normal) {
+    min_dot = std::min(min_dot, glm::dot(n, axis));
+  }
+  // a spread of 90 degrees or more has some face toward every camera
+  if (min_dot <= 0.0f) {
+    return;
+  }
+  // back off from the center along the axis until behind every face's
+  // plane, so the test from the apex holds for the whole meshlet
+  float back{0.0f};
+  for (std::size_t t = 0; t < normal.size(); ++t) {
+    back = std::max(back, glm::dot(meshlet.center - corner[t], normal[t]) /
+                              glm::dot(axis, normal[t]));
+  }
+  meshlet.cone_apex = meshlet.center - back * axis;
+  meshlet.cone_axis = axis;
+  meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+void BuildMeshlets(MeshData &mesh, std::vector<Meshlet> &meshlet,
+                   unsigned max_vertices, unsigned max_triangles) {
+  meshlet.clear();
+  std::size_t triangle_count{mesh.IndexCount() / 3};
+  std::vector<unsigned> index(triangle_count * 3);
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    index[i] = mesh.GetIndex(i);
+  }
+
+  // the triangles around each vertex
+  std::vector<unsigned> offset(mesh.vertex.size() + 1, 0);
+  for (unsigned v : index) {
+    ++offset[v + 1];
+  }
+  for (std::size_t v = 0; v < mesh.vertex.size(); ++v) {
+    offset[v + 1] += offset[v];
+  }
+  std::vector<unsigned> around(index.size());
+  {
+    std::vector<unsigned> fill(offset.begin(), offset.end() - 1);
+    for (std::size_t i = 0; i < index.size(); ++i) {
+      around[fill[index[i]]++] = static_cast<unsigned>(i / 3);
+    }
+  }
+
+  std::vector<bool> used(triangle_count, false);
+  // the meshlet each vertex was last added to
+  std::vector<unsigned> owner(mesh.vertex.size(),
+                              std::numeric_limits<unsigned>::max());
+  std::vector<unsigned> vertex;
+  std::vector<unsigned> order;
+  order.reserve(index.size());
+  std::size_t seed{0};
+  Meshlet current{0, 0, 0, glm::vec3{0.0f}, 0.0f,
+                  glm::vec3{0.0f}, glm::vec3{0.0f}, 0.0f};
+  unsigned id{0};
+  auto new_vertices = [&](std::size_t t) {
+    unsigned count{0};
+    for (int k = 0; k < 3; ++k) {
+      count += owner[index[3 * t + k]] != id;
+    }
+    return count;
+  };
+  auto finish = [&]() {
+    current.vertex_count = static_cast<unsigned>(vertex.size());
+    MeshletBounds(mesh, order, current);
+    meshlet.push_back(current);
+    current.first = static_cast<unsigned>(order.size());
+    current.count = 0;
+    vertex.clear();
+    ++id;
+  };
+  for (std::size_t emitted = 0; emitted < triangle_count;) {
+    // the unused neighbour adding the fewest vertices, or failing any the
+    // earliest unused triangle
+    std::size_t best{triangle_count};
+    unsigned best_new{4};
+    for (std::size_t i = 0; i < vertex.size() && best_new > 0; ++i) {
+      for (unsigned a = offset[vertex[i]]; a < offset[vertex[i] + 1]; ++a) {
+        unsigned t{around[a]};
+        if (used[t]) {
+          continue;
+        }
+        unsigned added{new_vertices(t)};
+        if (added < best_new) {
+          best = t;
+          best_new = added;
+        }
+      }
+    }
+    if (best == triangle_count) {
+      while (used[seed]) {
+        ++seed;
+      }
+      best = seed;
+      best_new = new_vertices(seed);
+    }
+    if (current.count / 3 == max_triangles ||
+        vertex.size() + best_new > max_vertices) {
+      finish();
+      continue;
+    }
+    used[best] = true;
+    for (int k = 0; k < 3; ++k) {
+      unsigned v{index[3 * best + k]};
+      if (owner[v] != id) {
+        owner[v] = id;
+        vertex.push_back(v);
+      }
+      order.push_back(v);
+    }
+    current.count += 3;
+    ++emitted;
+  }
+  if (current.count > 0) {
+    finish();
+  }
+
+  // growing for few vertices leaves an order poor for a 16 entry cache, so
+  // each meshlet gets its own pass of Tipsify over local vertex numbers
+  MeshData local;
+  local.index_size = 4;
+  local.error = 0.0f;
+  std::vector<unsigned> local_index(mesh.vertex.size());
+  std::vector<unsigned> global;
+  std::vector<unsigned> cluster;
+  for (const Meshlet &m : meshlet) {
+    global.clear();
+    local.index.resize(m.count * 4);
+    for (unsigned i = 0; i < m.count; ++i) {
+      unsigned v{order[m.first + i]};
+      if (owner[v] != id) {
+        owner[v] = id;
+        local_index[v] = static_cast<unsigned>(global.size());
+        global.push_back(v);
+      }
+      local.SetIndex(i, local_index[v]);
+    }
+    ++id;
+    local.vertex.resize(global.size());
+    OptimizeVertexCache(local, cluster);
+    for (unsigned i = 0; i < m.count; ++i) {
+      order[m.first + i] = global[local.GetIndex(i)];
+    }
+  }
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    mesh.SetIndex(i, order[i]);
+  }
+}
+
+std::size_t CullMeshlets(const std::vector<Meshlet> &meshlet,
+                         const Frustum &frustum,
+                         const glm::vec3 &camera_position,
+                         std::vector<unsigned> &first,
+                         std::vector<unsigned> &count) {
+  std::size_t kept{0};
+  for (const Meshlet &m : meshlet) {
+    glm::vec3 to_apex{m.cone_apex - camera_position};
+    if (glm::dot(to_apex, m.cone_axis) >
+        m.cone_cutoff * glm::length(to_apex)) {
+      continue;
+    }
+    bool outside{false};
+    for (int p = 0; p < 6 && !outside; ++p) {
+      outside = glm::dot(glm::vec3{frustum.plane[p]}, m.center) +
+                    frustum.plane[p].w <
+                -m.radius;
+    }
+    if (outside) {
+      continue;
+    }
+    if (!count.empty() && first.back() + count.back() == m.first) {
+      count.back() += m.count;
+    } else {
+      first.push_back(m.first);
+      count.push_back(m.count);
+    }
+    kept += m.count / 3;
+  }
+  return kept;
+}
+
+};  // namespace graphics
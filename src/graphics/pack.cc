@@ -0,0 +1,297 @@
+#include "graphics/pack.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "graphics/hash.h"
+#include "graphics/lz.h"
+
+namespace graphics {
+
+Pack::Pack()
+    : fd_{-1},
+      data_{nullptr},
+      size_{0},
+      header_{nullptr},
+      entry_{nullptr},
+      bucket_{nullptr},
+      name_{nullptr} {}
+
+Pack::~Pack() { Close(); }
+
+bool Pack::Open(const std::string &path, const std::string &root) {
+  Close();
+  fd_ = open(path.c_str(), O_RDONLY);
+  struct stat status;
+  if (fd_ < 0 || fstat(fd_, &status) != 0 ||
+      static_cast<std::size_t>(status.st_size) < sizeof(PackHeader)) {
+    Close();
+    return false;
+  }
+  size_ = static_cast<std::size_t>(status.st_size);
+  void *data{mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0)};
+  if (data == MAP_FAILED) {
+    Close();
+    return false;
+  }
+  data_ = static_cast<const unsigned char *>(data);
+
+  header_ = reinterpret_cast<const PackHeader *>(data_);
+  std::size_t index_size{sizeof(PackHeader) +
+                         header_->entry_count * sizeof(PackEntry) +
+                         header_->bucket_count * sizeof(std::uint32_t) +
+                         header_->name_size};
+  if (std::memcmp(header_->magic, kPackMagic, sizeof(kPackMagic)) != 0 ||
+      header_->version != kPackVersion || index_size > size_ ||
+      header_->bucket_count == 0 ||
+      (header_->bucket_count & (header_->bucket_count - 1)) != 0) {
+    Close();
+    return false;
+  }
+  entry_ = reinterpret_cast<const PackEntry *>(header_ + 1);
+  bucket_ = reinterpret_cast<const std::uint32_t *>(entry_ +
+                                                    header_->entry_count);
+  name_ = reinterpret_cast<const char *>(bucket_ + header_->bucket_count);
+  // the file is untrusted, so Find must not compare outside the name table
+  for (std::uint32_t i = 0; i < header_->entry_count; ++i) {
+    if (std::uint64_t{entry_[i].name_offset} + entry_[i].name_size >
+        header_->name_size) {
+      Close();
+      return false;
+    }
+  }
+
+  root_ = root.empty() || root.back() == '/' ? root : root + "/";
+  accessed_.assign(header_->entry_count, false);
+  access_order_.clear();
+  Prefetch();
+  return true;
+}
+
+void Pack::Close() {
+  if (data_) {
+    munmap(const_cast<unsigned char *>(data_), size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  fd_ = -1;
+  data_ = nullptr;
+  size_ = 0;
+  header_ = nullptr;
+  entry_ = nullptr;
+  bucket_ = nullptr;
+  name_ = nullptr;
+}
+
+const PackEntry *Pack::Find(const std::string &path) {
+  if (!data_) {
+    return nullptr;
+  }
+  const char *name{path.c_str()};
+  std::size_t name_size{path.size()};
+  if (!root_.empty() && path.compare(0, root_.size(), root_) == 0) {
+    name += root_.size();
+    name_size -= root_.size();
+  }
+
+  std::uint64_t hash{HashBytes(name, name_size)};
+  std::uint32_t mask{header_->bucket_count - 1};
+  // a corrupt table may have no empty bucket to stop at
+  std::uint32_t b{static_cast<std::uint32_t>(hash) & mask};
+  for (std::uint32_t probe = 0; probe < header_->bucket_count;
+       ++probe, b = (b + 1) & mask) {
+    std::uint32_t index{bucket_[b]};
+    if (index == 0 || index > header_->entry_count) {
+      return nullptr;
+    }
+    const PackEntry &entry{entry_[index - 1]};
+    if (entry.hash == hash && entry.name_size == name_size &&
+        std::memcmp(name_ + entry.name_offset, name, name_size) == 0) {
+      if (entry.offset > size_ || entry.size > size_ - entry.offset) {
+        return nullptr;
+      }
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (!accessed_[index - 1]) {
+        accessed_[index - 1] = true;
+        access_order_.push_back(index - 1);
+      }
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void Pack::Read(const PackEntry &entry,
+                std::vector<unsigned char> &data) const {
+  data.resize(static_cast<std::size_t>(entry.raw_size));
+  if (entry.flags & kPackCompressed) {
+    std::size_t size{static_cast<std::size_t>(entry.size)};
+    std::size_t raw_size, block_count;
+    if (!LzStreamInfo(Data(entry), size, raw_size, block_count) ||
+        raw_size != data.size()) {
+      throw std::string{"malformed pack entry"};
+    }
+    LzDecompressBlocks(Data(entry), size, data.data());
+  } else {
+    if (entry.size != entry.raw_size) {
+      throw std::string{"malformed pack entry"};
+    }
+    std::copy(Data(entry), Data(entry) + entry.size, data.begin());
+  }
+}
+
+void Pack::WriteAccessOrder(const std::string &path) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (!data_) {
+    return;
+  }
+  std::ofstream file{path};
+  for (std::uint32_t index : access_order_) {
+    file.write(name_ + entry_[index].name_offset, entry_[index].name_size);
+    file << '\n';
+  }
+}
+
+// Asks the kernel to read the ordered entries in, in the order the last run
+// used them, while the caller goes on with setup. Both hints are
+// asynchronous, so nothing here waits on I/O.
+void Pack::Prefetch() {
+  for (std::uint32_t i = 0; i < header_->ordered_count; ++i) {
+    const PackEntry &entry{entry_[i]};
+    if (entry.offset + entry.size > size_) {
+      break;
+    }
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(fd_, static_cast<off_t>(entry.offset),
+                  static_cast<off_t>(entry.size), POSIX_FADV_WILLNEED);
+#endif
+    // entry offsets are page aligned, as madvise requires
+    madvise(const_cast<unsigned char *>(data_ + entry.offset), entry.size,
+            MADV_WILLNEED);
+  }
+}
+
+void WritePack(const std::string &output, const std::string &root,
+               std::vector<std::string> names,
+               const std::vector<std::string> &order,
+               const std::vector<std::string> &compress) {
+  std::unordered_set<std::string> compressed{compress.begin(),
+                                             compress.end()};
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+  std::vector<std::string> layout;
+  std::unordered_set<std::string> placed;
+  for (const std::string &name : order) {
+    if (std::binary_search(names.begin(), names.end(), name) &&
+        placed.insert(name).second) {
+      layout.push_back(name);
+    }
+  }
+  std::uint32_t ordered_count{static_cast<std::uint32_t>(layout.size())};
+  for (const std::string &name : names) {
+    if (!placed.count(name)) {
+      layout.push_back(name);
+    }
+  }
+
+  PackHeader header;
+  std::memcpy(header.magic, kPackMagic, sizeof(kPackMagic));
+  header.version = kPackVersion;
+  header.entry_count = static_cast<std::uint32_t>(layout.size());
+  header.ordered_count = ordered_count;
+  header.bucket_count = 1;
+  // keep the table at most half full
+  while (header.bucket_count < 2 * header.entry_count) {
+    header.bucket_count <<= 1;
+  }
+  header.name_size = 0;
+
+  std::vector<PackEntry> entry(layout.size());
+  std::vector<std::uint32_t> bucket(header.bucket_count, 0);
+  std::string name_table;
+  std::vector<std::string> path(layout.size());
+  std::vector<std::vector<unsigned char>> content(layout.size());
+  for (std::uint32_t i = 0; i < layout.size(); ++i) {
+    path[i] = root + "/" + layout[i];
+    std::ifstream input{path[i], std::ios::binary | std::ios::ate};
+    if (!input) {
+      throw std::string{"fail to read "} + path[i];
+    }
+    content[i].resize(static_cast<std::size_t>(input.tellg()));
+    input.seekg(0);
+    input.read(reinterpret_cast<char *>(content[i].data()),
+               content[i].size());
+    if (!input) {
+      throw std::string{"fail to read "} + path[i];
+    }
+    entry[i].hash = HashBytes(layout[i].data(), layout[i].size());
+    entry[i].raw_size = content[i].size();
+    entry[i].flags = 0;
+    entry[i].reserved = 0;
+    if (compressed.count(layout[i])) {
+      std::vector<unsigned char> packed{
+          LzCompressBlocks(content[i].data(), content[i].size())};
+      if (packed.size() <= content[i].size() - content[i].size() / 8) {
+        content[i].swap(packed);
+        entry[i].flags = kPackCompressed;
+      }
+    }
+    entry[i].size = content[i].size();
+    entry[i].name_offset = static_cast<std::uint32_t>(name_table.size());
+    entry[i].name_size = static_cast<std::uint32_t>(layout[i].size());
+    name_table += layout[i];
+    std::uint32_t mask{header.bucket_count - 1};
+    std::uint32_t b{static_cast<std::uint32_t>(entry[i].hash) & mask};
+    while (bucket[b] != 0) {
+      b = (b + 1) & mask;
+    }
+    bucket[b] = i + 1;
+  }
+  header.name_size = static_cast<std::uint32_t>(name_table.size());
+
+  auto align = [](std::uint64_t offset) {
+    return (offset + kPackAlignment - 1) & ~(kPackAlignment - 1);
+  };
+  std::uint64_t offset{
+      align(sizeof(header) + entry.size() * sizeof(PackEntry) +
+            bucket.size() * sizeof(std::uint32_t) + name_table.size())};
+  for (PackEntry &e : entry) {
+    e.offset = offset;
+    offset = align(offset + e.size);
+  }
+
+  std::ofstream file{output, std::ios::binary | std::ios::trunc};
+  if (!file) {
+    throw std::string{"fail to write "} + output;
+  }
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(entry.data()),
+             entry.size() * sizeof(PackEntry));
+  file.write(reinterpret_cast<const char *>(bucket.data()),
+             bucket.size() * sizeof(std::uint32_t));
+  file.write(name_table.data(), name_table.size());
+  for (std::uint32_t i = 0; i < layout.size(); ++i) {
+    std::vector<char> padding(
+        entry[i].offset - static_cast<std::uint64_t>(file.tellp()), 0);
+    file.write(padding.data(), padding.size());
+    file.write(reinterpret_cast<const char *>(content[i].data()),
+               content[i].size());
+  }
+  if (!file) {
+    throw std::string{"fail to write "} + output;
+  }
+}
+
+};  // namespace graphics
@@ -5,6 +5,8 @@ out vec4 fragment_color;
 in vec3 world_position;
 in vec3 world_normal;
 in vec2 texture_coord;
+in vec4 world_tangent;
+flat in int material_index;
 
 uniform sampler2D normal_texture;
 uniform sampler2D albedo_texture;
@@ -12,31 +14,92 @@ uniform sampler2D metallic_texture;
 uniform sampler2D roughness_texture;
 uniform sampler2D ao_texture;
 
+// Instanced draws take constant materials from a table of two texels each:
+// linear albedo and ao, then metallic and roughness.
+uniform samplerBuffer material_table;
+
+// Which lighting is compiled in comes from ShaderDefines: PUNCTUAL_LIGHT
+// with the first LIGHT_COUNT lights, and IMAGE_BASED_LIGHT.
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 4
+#endif
+
+#ifdef IMAGE_BASED_LIGHT
 uniform samplerCube irradiance_texture;
 uniform samplerCube prefilter_texture;
 uniform sampler2D brdf_texture;
-
-uniform vec3 light_position[4];
-uniform vec3 light_color[4];
-
-uniform vec3 camera_position;
-
-uniform bool punctual_light;
-uniform bool image_based_light;
+#endif
+
+// std140 blocks FrameBlock and DrawBlock in graphics.h mirror; pbr.vs,
+// pbr.fs and background.vs declare them alike.
+layout (std140) uniform Frame {
+  mat4 view;
+  mat4 projection;
+  vec3 camera_position;
+  vec4 light_position[4];
+  vec4 light_color[4];
+};
+
+layout (std140) uniform Draw {
+  mat4 model;
+  // Packed vertices carry positions normalized over the mesh's bounds and
+  // octahedral normals; float ones pass through with offset 0 and scale 1.
+  vec3 position_offset;
+  bool packed_vertex;
+  vec3 position_scale;
+  // Without vertex tangents pbr.fs falls back to screen-space derivatives.
+  bool vertex_tangent;
+  vec4 normal_value;
+  vec4 albedo_value;
+  vec4 metallic_value;
+  vec4 roughness_value;
+  vec4 ao_value;
+  bool normal_constant;
+  bool albedo_constant;
+  bool metallic_constant;
+  bool roughness_constant;
+  bool ao_constant;
+  bool normal_y_up;
+  // Instanced draws take constant materials from material_table.
+  bool instanced;
+  // glTF puts v = 0 at the top of the image, which is decoded bottom row
+  // first.
+  bool flip_texture_coord;
+};
 
 const float kPi = 3.14159265359;
 
-vec3 GetNormalFromMap() {
-  vec3 tangent_normal = texture(normal_texture, texture_coord).rgb * 2.0 - 1.0;
-
-  vec3 p1 = dFdx(world_position);
-  vec3 p2 = dFdy(world_position);
-  vec2 c1 = dFdx(texture_coord);
-  vec2 c2 = dFdy(texture_coord);
+vec4 SampleMap(sampler2D map, bool constant, vec4 value) {
+  if (constant) {
+    return value;
+  }
+  return texture(map, texture_coord);
+}
 
-  vec3 normal = normalize(world_normal);
-  vec3 tangent = normalize(p1 * c2.t - p2 * c1.t);
-  vec3 bitangent = -normalize(cross(normal, tangent));
+vec3 GetNormalFromMap() {
+  vec3 tangent_normal = SampleMap(normal_texture, normal_constant, normal_value).rgb * 2.0 - 1.0;
+
+  // MikkTSpace's per-pixel reconstruction: the interpolated frame is used
+  // as is, unnormalized, with the bitangent rebuilt from the sign in w
+  vec3 normal = world_normal;
+  vec3 tangent;
+  vec3 bitangent;
+  if (vertex_tangent) {
+    tangent = world_tangent.xyz;
+    bitangent = world_tangent.w * cross(normal, tangent);
+  } else {
+    vec3 p1 = dFdx(world_position);
+    vec3 p2 = dFdy(world_position);
+    vec2 c1 = dFdx(texture_coord);
+    vec2 c2 = dFdy(texture_coord);
+
+    normal = normalize(normal);
+    tangent = normalize(p1 * c2.t - p2 * c1.t);
+    bitangent = normalize(cross(normal, tangent));
+  }
+  if (!normal_y_up) {
+    bitangent = -bitangent;
+  }
   mat3 tbn = mat3(tangent, bitangent, normal);
 
   return normalize(tbn * tangent_normal);
@@ -81,26 +144,41 @@ vec3 FresnelSchlickRoughness(float cos_theta, vec3 f0, float roughness) {
 }
 
 void main() {
-  vec3 n = GetNormalFromMap();
-  vec3 albedo = pow(texture(albedo_texture, texture_coord).rgb, vec3(2.2));
-  float metallic = texture(metallic_texture, texture_coord).r;
-  float roughness = texture(roughness_texture, texture_coord).r;
-  float ao = texture(ao_texture, texture_coord).r;
+  vec3 n;
+  vec3 albedo;
+  float metallic;
+  float roughness;
+  float ao;
+  if (instanced) {
+    vec4 albedo_ao = texelFetch(material_table, 2 * material_index);
+    vec4 metallic_roughness = texelFetch(material_table, 2 * material_index + 1);
+    n = normalize(world_normal);
+    albedo = albedo_ao.rgb;
+    ao = albedo_ao.a;
+    metallic = metallic_roughness.r;
+    roughness = metallic_roughness.g;
+  } else {
+    n = GetNormalFromMap();
+    albedo = pow(SampleMap(albedo_texture, albedo_constant, albedo_value).rgb, vec3(2.2));
+    metallic = SampleMap(metallic_texture, metallic_constant, metallic_value).r;
+    roughness = SampleMap(roughness_texture, roughness_constant, roughness_value).r;
+    ao = SampleMap(ao_texture, ao_constant, ao_value).r;
+  }
 
   vec3 v = normalize(camera_position - world_position);
-  vec3 r = reflect(-v, n);
 
   vec3 f0 = mix(vec3(0.04), albedo, metallic);
 
   vec3 lo = vec3(0.0);
 
-  if (punctual_light) {
-    for(int i = 0; i < 4; ++i) {
-      vec3 l = normalize(light_position[i] - world_position);
+#ifdef PUNCTUAL_LIGHT
+  {
+    for (int i = 0; i < LIGHT_COUNT; ++i) {
+      vec3 l = normalize(light_position[i].xyz - world_position);
       vec3 h = normalize(v + l);
-      float distance = length(light_position[i] - world_position);
+      float distance = length(light_position[i].xyz - world_position);
       float attenuation = 1.0 / (distance * distance);
-      vec3 radiance = light_color[i] * attenuation;
+      vec3 radiance = light_color[i].rgb * attenuation;
 
       float d = DistributionGGX(n, h, roughness);
       float g = GeometrySmith(n, v, l, roughness);
@@ -118,9 +196,12 @@ void main() {
       lo += (kd * albedo / kPi + specular) * radiance * ndotl;
     }
   }
+#endif
 
   vec3 ambient = vec3(0.0);
-  if (image_based_light) {
+#ifdef IMAGE_BASED_LIGHT
+  {
+    vec3 r = reflect(-v, n);
     vec3 f = FresnelSchlickRoughness(max(dot(n, v), 0.0), f0, roughness);
     vec3 ks = f;
     vec3 kd = vec3(1.0) - ks;
@@ -136,6 +217,7 @@ void main() {
 
     ambient = (kd * diffuse + specular) * ao;
   }
+#endif
   
   vec3 color = ambient + lo;
   
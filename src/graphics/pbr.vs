@@ -1,21 +1,110 @@
 #version 330 core
 
 layout (location = 0) in vec3 object_position;
-layout (location = 1) in vec3 object_normal;
+layout (location = 1) in vec4 object_normal;
 layout (location = 2) in vec2 object_texture_coord;
+layout (location = 3) in vec4 object_tangent;
+// per instance: the top three rows of the object's model matrix and its row
+// of the material table
+layout (location = 4) in vec4 instance_row[3];
+layout (location = 7) in uint instance_material;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// std140 blocks FrameBlock and DrawBlock in graphics.h mirror; pbr.vs,
+// pbr.fs and background.vs declare them alike.
+layout (std140) uniform Frame {
+  mat4 view;
+  mat4 projection;
+  vec3 camera_position;
+  vec4 light_position[4];
+  vec4 light_color[4];
+};
+
+layout (std140) uniform Draw {
+  mat4 model;
+  // Packed vertices carry positions normalized over the mesh's bounds and
+  // octahedral normals; float ones pass through with offset 0 and scale 1.
+  vec3 position_offset;
+  bool packed_vertex;
+  vec3 position_scale;
+  // Without vertex tangents pbr.fs falls back to screen-space derivatives.
+  bool vertex_tangent;
+  vec4 normal_value;
+  vec4 albedo_value;
+  vec4 metallic_value;
+  vec4 roughness_value;
+  vec4 ao_value;
+  bool normal_constant;
+  bool albedo_constant;
+  bool metallic_constant;
+  bool roughness_constant;
+  bool ao_constant;
+  bool normal_y_up;
+  // Instanced draws take constant materials from material_table.
+  bool instanced;
+  // glTF puts v = 0 at the top of the image, which is decoded bottom row
+  // first.
+  bool flip_texture_coord;
+};
 
 out vec3 world_position;
 out vec3 world_normal;
 out vec2 texture_coord;
+out vec4 world_tangent;
+flat out int material_index;
+
+const float kOctahedralScale = 511.0;
+const float kPi = 3.14159265359;
+
+vec3 DecodeOctahedral(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if (n.z < 0.0) {
+    n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0,
+                                    e.y >= 0.0 ? 1.0 : -1.0);
+  }
+  return normalize(n);
+}
+
+// The tangent packed beside an octahedral normal as an angle in the basis
+// TangentBasis in mesh.cc builds, which side of it taken from the integer
+// fields exactly as there.
+vec4 DecodeTangent(vec3 n, vec4 packed) {
+  float s = abs(packed.x) + abs(packed.y) <= kOctahedralScale ? 1.0 : -1.0;
+  float a = -1.0 / (s + n.z);
+  float b = n.x * n.y * a;
+  vec3 x = vec3(1.0 + s * n.x * n.x * a, s * b, -s * n.x);
+  vec3 y = vec3(b, s + n.y * n.y * a, -n.y);
+  float angle = packed.z / kOctahedralScale * kPi;
+  return vec4(cos(angle) * x + sin(angle) * y, packed.w < 0.0 ? -1.0 : 1.0);
+}
 
 void main() {
-  world_position = vec3(model * vec4(object_position, 1.0));
-  world_normal = transpose(inverse(mat3(model))) * object_normal;
+  vec3 position = position_offset + position_scale * object_position;
+  vec3 normal = object_normal.xyz;
+  vec4 tangent = object_tangent;
+  if (packed_vertex) {
+    normal = DecodeOctahedral(object_normal.xy / kOctahedralScale);
+    tangent = DecodeTangent(normal, object_normal);
+  }
+  mat4 object_to_world = model;
+  material_index = 0;
+  if (instanced) {
+    object_to_world = model * transpose(mat4(instance_row[0], instance_row[1],
+                                             instance_row[2],
+                                             vec4(0.0, 0.0, 0.0, 1.0)));
+    material_index = int(instance_material);
+  }
+  world_position = vec3(object_to_world * vec4(position, 1.0));
+  world_normal =
+      normalize(transpose(inverse(mat3(object_to_world))) * normal);
+  world_tangent = vec4(0.0);
+  if (vertex_tangent) {
+    world_tangent =
+        vec4(normalize(mat3(object_to_world) * tangent.xyz), tangent.w);
+  }
   texture_coord = object_texture_coord;
+  if (flip_texture_coord) {
+    texture_coord.y = 1.0 - texture_coord.y;
+  }
 
   gl_Position = projection * view * vec4(world_position, 1.0);
 }
\ No newline at end of file
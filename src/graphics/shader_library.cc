@@ -0,0 +1,34 @@
+#include "graphics/shader_library.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace graphics {
+
+// kEmbeddedShader, sorted by name, written by shader_embed into the build
+// directory
+#include "graphics/shader_library_data.h"
+
+const std::size_t kEmbeddedShaderCount{sizeof(kEmbeddedShader) /
+                                       sizeof(kEmbeddedShader[0])};
+
+const EmbeddedShader *FindEmbeddedShader(const std::string &name) {
+  const EmbeddedShader *end{kEmbeddedShader + kEmbeddedShaderCount};
+  const EmbeddedShader *found{std::lower_bound(
+      kEmbeddedShader, end, name,
+      [](const EmbeddedShader &shader, const std::string &name) {
+        return std::strcmp(shader.name, name.c_str()) < 0;
+      })};
+  if (found == end || name != found->name) {
+    return nullptr;
+  }
+  return found;
+}
+
+const EmbeddedShader *EmbeddedShaders(std::size_t &count) {
+  count = kEmbeddedShaderCount;
+  return kEmbeddedShader;
+}
+
+};  // namespace graphics
@@ -0,0 +1,100 @@
+#include "graphics/shader_preprocess.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace graphics {
+
+static std::string ReadFile(const std::string &path) {
+  std::ifstream file{path};
+  std::stringstream sstream;
+  if (!file || !(sstream << file.rdbuf())) {
+    throw std::string{"fail to read "} + path;
+  }
+  return sstream.str();
+}
+
+// text's line from begin to end without comments, indentation or runs of
+// spaces; comment carries a /* comment still open from line to line
+static std::string StripLine(const std::string &text, std::size_t begin,
+                             std::size_t end, bool &comment) {
+  std::string line;
+  bool space{false};
+  for (std::size_t i = begin; i < end; ++i) {
+    char c{text[i]};
+    char next{i + 1 < end ? text[i + 1] : '\0'};
+    if (comment) {
+      if (c == '*' && next == '/') {
+        comment = false;
+        space = true;
+        ++i;
+      }
+    } else if (c == '/' && next == '/') {
+      break;
+    } else if (c == '/' && next == '*') {
+      comment = true;
+      ++i;
+    } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' ||
+               c == '\v') {
+      space = true;
+    } else {
+      // a comment between two tokens still parts them
+      if (space && !line.empty()) {
+        line += ' ';
+      }
+      space = false;
+      line += c;
+    }
+  }
+  return line;
+}
+
+// Appends path, stripped and with its includes in place, to output. file
+// holds the files read so far, in order, so a file's index is its source
+// string number.
+static void Preprocess(const std::string &path,
+                       std::vector<std::string> &file, std::string &output) {
+  std::size_t number{file.size()};
+  file.push_back(path);
+  std::string text{ReadFile(path)};
+  std::string directory{path.substr(0, path.rfind('/') + 1)};
+  bool comment{false};
+  unsigned line_number{0};
+  for (std::size_t begin = 0; begin < text.size();) {
+    std::size_t end{std::min(text.find('\n', begin), text.size())};
+    std::string line{StripLine(text, begin, end, comment)};
+    begin = end + 1;
+    ++line_number;
+    if (line.compare(0, 8, "#include") != 0) {
+      output += line;
+      output += '\n';
+      continue;
+    }
+    std::size_t open{line.find('"')};
+    std::size_t close{line.rfind('"')};
+    if (open == std::string::npos || close == open) {
+      throw path + ":" + std::to_string(line_number) + ": malformed #include";
+    }
+    std::string include{directory + line.substr(open + 1, close - open - 1)};
+    if (std::find(file.begin(), file.end(), include) != file.end()) {
+      output += '\n';
+      continue;
+    }
+    output += "#line 1 " + std::to_string(file.size()) + "\n";
+    Preprocess(include, file, output);
+    output += "#line " + std::to_string(line_number + 1) + " " +
+              std::to_string(number) + "\n";
+  }
+}
+
+std::string PreprocessShader(const std::string &path) {
+  std::vector<std::string> file;
+  std::string output;
+  Preprocess(path, file, output);
+  return output;
+}
+
+};  // namespace graphics
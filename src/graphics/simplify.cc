@@ -0,0 +1,507 @@
+#include "graphics/simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace graphics {
+
+// The sum of squared distances to a set of weighted planes, as the
+// symmetric matrix a, vector b and constant c of p.a.p + 2 b.p + c, and
+// the sum w of the weights. Doubles, since the terms cancel.
+struct Quadric {
+  double a00, a11, a22, a01, a02, a12;
+  double b0, b1, b2;
+  double c;
+  double w;
+};
+
+static void AddPlane(Quadric &q, const glm::vec3 &normal, float distance,
+                     float weight) {
+  double x{normal.x}, y{normal.y}, z{normal.z}, d{distance}, w{weight};
+  q.a00 += w * x * x;
+  q.a11 += w * y * y;
+  q.a22 += w * z * z;
+  q.a01 += w * x * y;
+  q.a02 += w * x * z;
+  q.a12 += w * y * z;
+  q.b0 += w * x * d;
+  q.b1 += w * y * d;
+  q.b2 += w * z * d;
+  q.c += w * d * d;
+  q.w += w;
+}
+
+static void AddQuadric(Quadric &q, const Quadric &other) {
+  q.a00 += other.a00;
+  q.a11 += other.a11;
+  q.a22 += other.a22;
+  q.a01 += other.a01;
+  q.a02 += other.a02;
+  q.a12 += other.a12;
+  q.b0 += other.b0;
+  q.b1 += other.b1;
+  q.b2 += other.b2;
+  q.c += other.c;
+  q.w += other.w;
+}
+
+// The weighted mean squared distance from p to q's planes.
+static float QuadricError(const Quadric &q, const glm::vec3 &p) {
+  double x{p.x}, y{p.y}, z{p.z};
+  double r{q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+           2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+           2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c};
+  return q.w > 0.0 ? static_cast<float>(std::abs(r) / q.w) : 0.0f;
+}
+
+// How a position may move. Manifold ones may collapse onto any neighbour,
+// border and seam ones only onto the next position along their border or
+// seam, and locked ones not at all.
+enum VertexKind { kManifold, kBorder, kSeam, kLocked };
+
+const bool kCanCollapse[4][4]{
+    {true, true, true, true},
+    {false, true, false, false},
+    {false, false, true, false},
+    {false, false, false, false},
+};
+
+// Whether an edge between the two kinds also appears reversed in another
+// triangle, so picking it from one side is enough.
+const bool kHasOpposite[4][4]{
+    {true, true, true, false},
+    {true, false, true, false},
+    {true, true, true, false},
+    {false, false, false, false},
+};
+
+const unsigned kNone{std::numeric_limits<unsigned>::max()};
+
+// Directed edges out of each vertex, as offsets into one target array.
+struct Adjacency {
+  std::vector<unsigned> offset;
+  std::vector<unsigned> target;
+  std::vector<unsigned> opposite;
+};
+
+// Edges out of each vertex of index after mapping through remap, each
+// with the third vertex of its triangle in opposite.
+static void BuildAdjacency(const std::vector<unsigned> &index,
+                           const std::vector<unsigned> &remap,
+                           std::size_t vertex_count, Adjacency &adjacency) {
+  adjacency.offset.assign(vertex_count + 1, 0);
+  for (unsigned i : index) {
+    ++adjacency.offset[remap[i] + 1];
+  }
+  for (std::size_t v = 0; v < vertex_count; ++v) {
+    adjacency.offset[v + 1] += adjacency.offset[v];
+  }
+  adjacency.target.resize(index.size());
+  adjacency.opposite.resize(index.size());
+  std::vector<unsigned> cursor(adjacency.offset.begin(),
+                               adjacency.offset.end() - 1);
+  for (std::size_t t = 0; t < index.size(); t += 3) {
+    for (int e = 0; e < 3; ++e) {
+      unsigned from{remap[index[t + e]]};
+      unsigned at{cursor[from]++};
+      adjacency.target[at] = remap[index[t + (e + 1) % 3]];
+      adjacency.opposite[at] = remap[index[t + (e + 2) % 3]];
+    }
+  }
+}
+
+static bool HasEdge(const Adjacency &adjacency, unsigned from, unsigned to) {
+  for (unsigned e = adjacency.offset[from]; e < adjacency.offset[from + 1];
+       ++e) {
+    if (adjacency.target[e] == to) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether triangle a b c faces away from where it did once c moves to d.
+static bool Flips(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c,
+                  const glm::vec3 &d) {
+  glm::vec3 ab{b - a};
+  return glm::dot(glm::cross(ab, c - a), glm::cross(ab, d - a)) <= 0.0f;
+}
+
+// Whether collapsing position r0 onto r1 would pinch the surface: r0 and
+// r1 sharing a neighbour other than the third corners of the triangles
+// between them. Positions are mapped through position_remap first.
+static bool Pinches(const Adjacency &adjacency,
+                    const std::vector<unsigned> &position_remap, unsigned r0,
+                    unsigned r1) {
+  auto has = [&](unsigned from, unsigned a, unsigned b) {
+    for (unsigned e = adjacency.offset[from]; e < adjacency.offset[from + 1];
+         ++e) {
+      unsigned t{position_remap[adjacency.target[e]]};
+      unsigned o{position_remap[adjacency.opposite[e]]};
+      if ((t == a || o == a) && (b == a || t == b || o == b)) {
+        return true;
+      }
+    }
+    return false;
+  };
+  for (unsigned e = adjacency.offset[r0]; e < adjacency.offset[r0 + 1]; ++e) {
+    for (unsigned n : {adjacency.target[e], adjacency.opposite[e]}) {
+      n = position_remap[n];
+      if (n != r0 && n != r1 && !has(r0, n, r1) && has(r1, n, n)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Points loop past the vertices collapse_remap moved, reading the loop as
+// it was before, since the vertex after a moved one may have moved too.
+static void RemapLoop(std::vector<unsigned> &loop,
+                      const std::vector<unsigned> &collapse_remap,
+                      std::vector<unsigned> &scratch) {
+  scratch = loop;
+  for (unsigned v = 0; v < loop.size(); ++v) {
+    unsigned next{scratch[v]};
+    if (next == kNone) {
+      continue;
+    }
+    unsigned moved{collapse_remap[next]};
+    // a seam collapsed against the loop's direction moves next onto v
+    if (moved == v && scratch[next] != kNone) {
+      moved = collapse_remap[scratch[next]];
+    }
+    loop[v] = moved;
+  }
+}
+
+struct Collapse {
+  unsigned from;
+  unsigned to;
+  bool either_way;
+  float error;
+};
+
+MeshLod SimplifyMesh(const MeshData &mesh, std::size_t target_index_count,
+                     float target_error) {
+  MeshLod lod;
+  lod.index.resize(mesh.IndexCount());
+  for (std::size_t i = 0; i < lod.index.size(); ++i) {
+    lod.index[i] = mesh.GetIndex(i);
+  }
+  lod.error = mesh.error;
+  std::size_t vertex_count{mesh.vertex.size()};
+  if (lod.index.size() <= target_index_count || vertex_count == 0) {
+    return lod;
+  }
+  auto position = [&](unsigned v) -> const glm::vec3 & {
+    return mesh.vertex[v].position;
+  };
+
+  // remap takes each vertex to the first with its position, and wedge
+  // cycles through the vertices sharing one
+  std::vector<unsigned> remap(vertex_count);
+  std::vector<unsigned> wedge(vertex_count);
+  {
+    std::vector<unsigned> order(vertex_count);
+    for (unsigned v = 0; v < vertex_count; ++v) {
+      order[v] = v;
+    }
+    auto less = [&](unsigned a, unsigned b) {
+      const glm::vec3 &p{position(a)};
+      const glm::vec3 &q{position(b)};
+      if (p.x != q.x) {
+        return p.x < q.x;
+      }
+      if (p.y != q.y) {
+        return p.y < q.y;
+      }
+      if (p.z != q.z) {
+        return p.z < q.z;
+      }
+      return a < b;
+    };
+    std::sort(order.begin(), order.end(), less);
+    std::size_t end{0};
+    for (std::size_t begin = 0; begin < vertex_count; begin = end) {
+      end = begin + 1;
+      while (end < vertex_count &&
+             position(order[end]) == position(order[begin])) {
+        ++end;
+      }
+      for (std::size_t i = begin; i < end; ++i) {
+        remap[order[i]] = order[begin];
+        wedge[order[i]] = order[i + 1 < end ? i + 1 : begin];
+      }
+    }
+  }
+
+  // open edges have no twin running the other way between the same
+  // vertices; loop is a vertex's one open edge out and loop_back its one
+  // open edge in, kNone if there is none and the vertex itself if there
+  // are several
+  std::vector<unsigned> identity(vertex_count);
+  for (unsigned v = 0; v < vertex_count; ++v) {
+    identity[v] = v;
+  }
+  Adjacency adjacency;
+  BuildAdjacency(lod.index, identity, vertex_count, adjacency);
+  std::vector<unsigned> loop(vertex_count, kNone);
+  std::vector<unsigned> loop_back(vertex_count, kNone);
+  for (unsigned v = 0; v < vertex_count; ++v) {
+    for (unsigned e = adjacency.offset[v]; e < adjacency.offset[v + 1]; ++e) {
+      unsigned t{adjacency.target[e]};
+      if (!HasEdge(adjacency, t, v)) {
+        loop[v] = loop[v] == kNone ? t : v;
+        loop_back[t] = loop_back[t] == kNone ? v : t;
+      }
+    }
+  }
+
+  // a position with one vertex is manifold without open edges and border
+  // with one each way; a position with two is a seam if each has one open
+  // edge each way and they run between the same two other positions
+  std::vector<VertexKind> kind(vertex_count, kLocked);
+  for (unsigned v = 0; v < vertex_count; ++v) {
+    if (remap[v] != v) {
+      continue;
+    }
+    unsigned w{wedge[v]};
+    if (w == v) {
+      if (loop[v] == kNone && loop_back[v] == kNone) {
+        kind[v] = kManifold;
+      } else if (loop[v] != kNone && loop[v] != v && loop_back[v] != kNone &&
+                 loop_back[v] != v) {
+        kind[v] = kBorder;
+      }
+    } else if (wedge[w] == v && loop[v] != kNone && loop[v] != v &&
+               loop_back[v] != kNone && loop_back[v] != v &&
+               loop[w] != kNone && loop[w] != w && loop_back[w] != kNone &&
+               loop_back[w] != w && remap[loop[v]] == remap[loop_back[w]] &&
+               remap[loop_back[v]] == remap[loop[w]] &&
+               remap[loop[v]] != remap[loop_back[v]]) {
+      kind[v] = kSeam;
+    }
+  }
+  for (unsigned v = 0; v < vertex_count; ++v) {
+    kind[v] = kind[remap[v]];
+  }
+
+  // each position's quadric: the planes of its triangles weighted by the
+  // root of their area, and planes through its border and seam edges at
+  // right angles to their triangles, weighted by length, borders more
+  std::vector<Quadric> quadric(vertex_count, Quadric{});
+  for (std::size_t t = 0; t < lod.index.size(); t += 3) {
+    unsigned corner[3]{lod.index[t], lod.index[t + 1], lod.index[t + 2]};
+    const glm::vec3 &p0{position(corner[0])};
+    glm::vec3 normal{glm::cross(position(corner[1]) - p0,
+                                position(corner[2]) - p0)};
+    float area{glm::length(normal)};
+    if (area > 0.0f) {
+      normal = normal * (1.0f / area);
+      for (unsigned c : corner) {
+        AddPlane(quadric[remap[c]], normal, -glm::dot(normal, p0),
+                 std::sqrt(area));
+      }
+    }
+    for (int e = 0; e < 3; ++e) {
+      unsigned i0{corner[e]};
+      unsigned i1{corner[(e + 1) % 3]};
+      VertexKind k{kind[i0]};
+      if ((k != kBorder && k != kSeam) || kind[i1] != k || loop[i0] != i1) {
+        continue;
+      }
+      const glm::vec3 &a{position(i0)};
+      glm::vec3 edge{position(i1) - a};
+      float length{glm::length(edge)};
+      if (length == 0.0f) {
+        continue;
+      }
+      edge = edge * (1.0f / length);
+      glm::vec3 side{position(corner[(e + 2) % 3]) - a};
+      side = side - edge * glm::dot(side, edge);
+      float side_length{glm::length(side)};
+      if (side_length == 0.0f) {
+        continue;
+      }
+      side = side * (1.0f / side_length);
+      float weight{(k == kBorder ? 10.0f : 1.0f) * length};
+      AddPlane(quadric[remap[i0]], side, -glm::dot(side, a), weight);
+      AddPlane(quadric[remap[i1]], side, -glm::dot(side, a), weight);
+    }
+  }
+
+  double error_limit{static_cast<double>(target_error) * target_error};
+  float max_error{0.0f};
+  std::vector<Collapse> collapse;
+  std::vector<unsigned> order;
+  std::vector<unsigned> collapse_remap(vertex_count);
+  std::vector<unsigned> position_remap(vertex_count);
+  std::vector<bool> collapse_locked(vertex_count);
+  std::vector<unsigned> scratch;
+  Adjacency position_adjacency;
+  // each pass collapses the cheapest edges that do not touch one another
+  while (lod.index.size() > target_index_count) {
+    collapse.clear();
+    for (std::size_t t = 0; t < lod.index.size(); t += 3) {
+      for (int e = 0; e < 3; ++e) {
+        unsigned i0{lod.index[t + e]};
+        unsigned i1{lod.index[t + (e + 1) % 3]};
+        VertexKind k0{kind[i0]};
+        VertexKind k1{kind[i1]};
+        bool forward{kCanCollapse[k0][k1]};
+        bool backward{kCanCollapse[k1][k0]};
+        if (!forward && !backward) {
+          continue;
+        }
+        if (kHasOpposite[k0][k1] && remap[i1] > remap[i0]) {
+          continue;
+        }
+        // both on a border or seam but not along it
+        if (k0 == k1 && (k0 == kBorder || k0 == kSeam) && loop[i0] != i1) {
+          continue;
+        }
+        if (forward && backward) {
+          collapse.push_back(Collapse{i0, i1, true, 0.0f});
+        } else if (forward) {
+          collapse.push_back(Collapse{i0, i1, false, 0.0f});
+        } else {
+          collapse.push_back(Collapse{i1, i0, false, 0.0f});
+        }
+      }
+    }
+    if (collapse.empty()) {
+      break;
+    }
+    for (Collapse &c : collapse) {
+      float error{QuadricError(quadric[remap[c.from]], position(c.to))};
+      if (c.either_way) {
+        float back{QuadricError(quadric[remap[c.to]], position(c.from))};
+        if (back < error) {
+          std::swap(c.from, c.to);
+          error = back;
+        }
+      }
+      c.error = error;
+    }
+    order.resize(collapse.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      order[i] = static_cast<unsigned>(i);
+    }
+    std::sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+      return collapse[a].error < collapse[b].error;
+    });
+
+    // a collapse removes about two triangles, so aim for half of the
+    // collapses needed, leaving later passes to refine
+    std::size_t goal{
+        std::max<std::size_t>((lod.index.size() - target_index_count) / 6, 1)};
+    BuildAdjacency(lod.index, remap, vertex_count, position_adjacency);
+    for (unsigned v = 0; v < vertex_count; ++v) {
+      collapse_remap[v] = v;
+      position_remap[v] = v;
+      collapse_locked[v] = false;
+    }
+    std::size_t collapse_count{0};
+    for (unsigned o : order) {
+      const Collapse &c{collapse[o]};
+      if (collapse_count >= goal || c.error > error_limit) {
+        break;
+      }
+      unsigned r0{remap[c.from]};
+      unsigned r1{remap[c.to]};
+      if (collapse_locked[r0] || collapse_locked[r1]) {
+        continue;
+      }
+      bool flips{false};
+      for (unsigned e = position_adjacency.offset[r0];
+           e < position_adjacency.offset[r0 + 1] && !flips; ++e) {
+        unsigned a{position_remap[position_adjacency.target[e]]};
+        unsigned b{position_remap[position_adjacency.opposite[e]]};
+        // triangles the collapse removes cannot flip
+        if (a == r1 || b == r1 || a == b) {
+          continue;
+        }
+        flips = Flips(position(a), position(b), position(r0), position(r1));
+      }
+      if (flips || Pinches(position_adjacency, position_remap, r0, r1)) {
+        // this collapse should not count against the goal
+        ++goal;
+        continue;
+      }
+      AddQuadric(quadric[r1], quadric[r0]);
+      collapse_remap[c.from] = c.to;
+      if (kind[c.from] == kSeam) {
+        // the other side of the seam follows along its own edge
+        unsigned s0{wedge[c.from]};
+        unsigned s1{loop[c.from] == c.to ? loop_back[s0] : loop[s0]};
+        collapse_remap[s0] = s1;
+      }
+      position_remap[r0] = r1;
+      collapse_locked[r0] = true;
+      collapse_locked[r1] = true;
+      max_error = std::max(max_error, c.error);
+      ++collapse_count;
+    }
+    if (collapse_count == 0) {
+      break;
+    }
+
+    RemapLoop(loop, collapse_remap, scratch);
+    RemapLoop(loop_back, collapse_remap, scratch);
+    std::size_t kept{0};
+    for (std::size_t t = 0; t < lod.index.size(); t += 3) {
+      unsigned a{collapse_remap[lod.index[t]]};
+      unsigned b{collapse_remap[lod.index[t + 1]]};
+      unsigned c{collapse_remap[lod.index[t + 2]]};
+      if (remap[a] != remap[b] && remap[b] != remap[c] &&
+          remap[c] != remap[a]) {
+        lod.index[kept++] = a;
+        lod.index[kept++] = b;
+        lod.index[kept++] = c;
+      }
+    }
+    lod.index.resize(kept);
+  }
+  lod.error = mesh.error + std::sqrt(max_error);
+  return lod;
+}
+
+void BuildLodChain(const MeshData &mesh, std::vector<MeshLod> &lod,
+                   float ratio, std::size_t min_triangle_count,
+                   float max_error) {
+  lod.clear();
+  lod.push_back(SimplifyMesh(mesh, mesh.IndexCount(), 0.0f));
+  for (;;) {
+    std::size_t previous{lod.back().index.size()};
+    std::size_t target{static_cast<std::size_t>(previous / 3 * ratio) * 3};
+    if (target < min_triangle_count * 3) {
+      break;
+    }
+    MeshLod next{SimplifyMesh(mesh, target, max_error)};
+    if (next.index.size() < min_triangle_count * 3 ||
+        next.index.size() * 10 > previous * 9) {
+      break;
+    }
+    lod.push_back(std::move(next));
+  }
+}
+
+MeshData LodMesh(const MeshData &mesh, const MeshLod &lod) {
+  MeshData result;
+  result.vertex = mesh.vertex;
+  result.index_size = mesh.index_size;
+  result.error = lod.error;
+  result.index.resize(lod.index.size() * result.index_size);
+  for (std::size_t i = 0; i < lod.index.size(); ++i) {
+    result.SetIndex(i, lod.index[i]);
+  }
+  return result;
+}
+
+};  // namespace graphics
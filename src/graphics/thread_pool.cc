@@ -0,0 +1,77 @@
+#include "graphics/thread_pool.h"
+
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+namespace graphics {
+
+ThreadPool::ThreadPool(unsigned thread_count)
+    : thread_count_{thread_count > 0 ? thread_count : 1},
+      busy_count_{0},
+      stop_{false},
+      error_{nullptr} {
+  for (unsigned i = 0; i < thread_count_; ++i) {
+    threads_.emplace_back(&ThreadPool::Work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+  task_ready_.notify_all();
+  for (std::thread &thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    tasks_.push_back(std::move(task));
+  }
+  task_ready_.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  all_done_.wait(lock, [this] { return tasks_.empty() && busy_count_ == 0; });
+  if (error_) {
+    std::exception_ptr error{error_};
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::Work() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  for (;;) {
+    task_ready_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+    if (tasks_.empty()) {
+      return;
+    }
+    std::function<void()> task{std::move(tasks_.front())};
+    tasks_.pop_front();
+    ++busy_count_;
+    lock.unlock();
+    std::exception_ptr error{nullptr};
+    try {
+      task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    if (error && !error_) {
+      error_ = error;
+    }
+    --busy_count_;
+    if (tasks_.empty() && busy_count_ == 0) {
+      all_done_.notify_all();
+    }
+  }
+}
+
+};  // namespace graphics
@@ -0,0 +1,132 @@
+// Times frustum culling as the object count grows:
+//   cull_bench [max_count]
+// Scatters boxes through a city-sized cube, up to max_count of them (1M by
+// default), and culls them against cameras flying through it: one box at a
+// time, kCullWidth at a time over the flat array, and through the BVH.
+// Every method should find the same boxes; a warning is printed if they
+// do not.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "graphics/cull.h"
+
+using namespace graphics;
+
+static double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Runs cull on every frustum, returning the milliseconds per frustum, best
+// of a few runs, and leaving the last run's results in visible.
+template <typename Cull>
+static double TimeCull(const std::vector<Frustum> &frustum,
+                       std::vector<std::vector<unsigned>> &visible,
+                       Cull cull) {
+  double best{1e30};
+  for (int run = 0; run < 3; ++run) {
+    double start{Now()};
+    for (std::size_t f = 0; f < frustum.size(); ++f) {
+      visible[f].clear();
+      cull(frustum[f], visible[f]);
+    }
+    best = std::min(best, Now() - start);
+  }
+  for (std::vector<unsigned> &v : visible) {
+    std::sort(v.begin(), v.end());
+  }
+  return best * 1e3 / frustum.size();
+}
+
+int main(int argc, char *argv[]) {
+  std::size_t max_count{argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                 : 1000000};
+  try {
+    const float kSide{1000.0f};
+    std::mt19937 random{1};
+    std::uniform_real_distribution<float> position{-0.5f * kSide,
+                                                   0.5f * kSide};
+    std::uniform_real_distribution<float> size{0.5f, 4.0f};
+    std::uniform_real_distribution<float> angle{0.0f, 6.2831853f};
+
+    std::vector<Frustum> frustum;
+    glm::mat4 projection{
+        glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f)};
+    for (int f = 0; f < 32; ++f) {
+      glm::vec3 eye{position(random), position(random), position(random)};
+      float yaw{angle(random)};
+      glm::vec3 forward{std::cos(yaw), 0.0f, std::sin(yaw)};
+      frustum.push_back(ExtractFrustum(
+          projection *
+          glm::lookAt(eye, eye + forward, glm::vec3{0.0f, 1.0f, 0.0f})));
+    }
+
+    std::printf("kCullWidth %u\n", kCullWidth);
+    std::printf("%9s %8s | %10s %10s %10s | %9s\n", "objects", "visible",
+                "scalar ms", "wide ms", "bvh ms", "build ms");
+    for (std::size_t count = 1000; count <= max_count; count *= 10) {
+      std::vector<Aabb> box(count);
+      BoxSet set;
+      for (Aabb &b : box) {
+        glm::vec3 center{position(random), position(random),
+                         position(random)};
+        glm::vec3 extent{size(random), size(random), size(random)};
+        b = Aabb{center - extent, center + extent};
+        set.Add(b);
+      }
+      double start{Now()};
+      Bvh bvh;
+      bvh.Build(box);
+      double build_time{Now() - start};
+
+      std::vector<std::vector<unsigned>> scalar(frustum.size());
+      std::vector<std::vector<unsigned>> wide(frustum.size());
+      std::vector<std::vector<unsigned>> tree(frustum.size());
+      double scalar_time{TimeCull(
+          frustum, scalar,
+          [&](const Frustum &f, std::vector<unsigned> &visible) {
+            for (std::size_t i = 0; i < box.size(); ++i) {
+              if (Intersects(f, box[i])) {
+                visible.push_back(static_cast<unsigned>(i));
+              }
+            }
+          })};
+      double wide_time{TimeCull(
+          frustum, wide,
+          [&](const Frustum &f, std::vector<unsigned> &visible) {
+            CullBoxes(f, set, visible);
+          })};
+      double tree_time{TimeCull(
+          frustum, tree,
+          [&](const Frustum &f, std::vector<unsigned> &visible) {
+            bvh.Cull(f, visible);
+          })};
+      if (wide != scalar || tree != scalar) {
+        std::cerr << "culling methods disagree on " << count << " objects"
+                  << std::endl;
+      }
+      std::size_t visible{0};
+      for (const std::vector<unsigned> &v : scalar) {
+        visible += v.size();
+      }
+      std::printf("%9zu %8zu | %10.3f %10.3f %10.3f | %9.1f\n", count,
+                  visible / frustum.size(), scalar_time, wide_time,
+                  tree_time, build_time * 1e3);
+    }
+  } catch (const std::string &e) {
+    std::cerr << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,163 @@
+// Compares loading assets raw through mmap with loading them lz compressed:
+//   lz_bench <file>...
+// Each file is written out raw and compressed, then read back through mmap
+// with a cold and a warm page cache, the compressed copy decompressed on one
+// thread and on all of them. Compression pays off when storage delivers
+// less than the printed break-even bandwidth.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "graphics/lz.h"
+#include "graphics/thread_pool.h"
+
+using namespace graphics;
+
+static double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static void WriteFile(const std::string &path,
+                      const std::vector<unsigned char> &data) {
+  std::ofstream file{path, std::ios::binary | std::ios::trunc};
+  file.write(reinterpret_cast<const char *>(data.data()), data.size());
+  if (!file) {
+    throw std::string{"fail to write "} + path;
+  }
+}
+
+// Drops path from the page cache where the platform allows it.
+static void DropCache(const std::string &path) {
+  int fd{open(path.c_str(), O_RDONLY)};
+  if (fd < 0) {
+    return;
+  }
+  fsync(fd);
+#ifdef POSIX_FADV_DONTNEED
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+  close(fd);
+}
+
+// Maps path and hands its bytes to consume; returns the seconds taken, best
+// of a few runs.
+template <typename Consume>
+static double TimeMapped(const std::string &path, bool cold,
+                         Consume consume) {
+  double best{1e30};
+  for (int run = 0; run < 5; ++run) {
+    if (cold) {
+      DropCache(path);
+    }
+    double start{Now()};
+    int fd{open(path.c_str(), O_RDONLY)};
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+      throw std::string{"fail to read "} + path;
+    }
+    std::size_t size{static_cast<std::size_t>(status.st_size)};
+    void *data{mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+    if (data == MAP_FAILED) {
+      throw std::string{"fail to map "} + path;
+    }
+    consume(static_cast<const unsigned char *>(data), size);
+    munmap(data, size);
+    close(fd);
+    best = std::min(best, Now() - start);
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <file>..." << std::endl;
+    return 1;
+  }
+  try {
+    ThreadPool pool;
+    const std::string raw_path{"lz_bench.raw"};
+    const std::string lz_path{"lz_bench.lz"};
+    std::printf("%-24s %9s %6s %9s | %-23s | %-23s | %-23s | %s\n", "file",
+                "MiB", "ratio", "comp", "raw mmap cold/warm ms",
+                "lz 1 thread cold/warm", "lz pool cold/warm",
+                "worth it below");
+    for (int a = 1; a < argc; ++a) {
+      std::ifstream input{argv[a], std::ios::binary | std::ios::ate};
+      if (!input) {
+        throw std::string{"fail to read "} + argv[a];
+      }
+      std::vector<unsigned char> raw(static_cast<std::size_t>(input.tellg()));
+      input.seekg(0);
+      input.read(reinterpret_cast<char *>(raw.data()), raw.size());
+
+      double start{Now()};
+      std::vector<unsigned char> compressed{
+          LzCompressBlocks(raw.data(), raw.size())};
+      double compress_time{Now() - start};
+      WriteFile(raw_path, raw);
+      WriteFile(lz_path, compressed);
+
+      std::vector<unsigned char> out(raw.size());
+      auto copy = [&](const unsigned char *data, std::size_t size) {
+        std::memcpy(out.data(), data, size);
+      };
+      auto decompress = [&](const unsigned char *data, std::size_t size) {
+        LzDecompressBlocks(data, size, out.data());
+      };
+      auto decompress_pool = [&](const unsigned char *data, std::size_t size) {
+        LzDecompressBlocks(data, size, out.data(), &pool);
+      };
+      double raw_cold{TimeMapped(raw_path, true, copy)};
+      double raw_warm{TimeMapped(raw_path, false, copy)};
+      double lz_cold{TimeMapped(lz_path, true, decompress)};
+      double lz_warm{TimeMapped(lz_path, false, decompress)};
+      double pool_cold{TimeMapped(lz_path, true, decompress_pool)};
+      double pool_warm{TimeMapped(lz_path, false, decompress_pool)};
+      if (out != raw) {
+        throw std::string{"round trip mismatch on "} + argv[a];
+      }
+
+      // Reading R raw bytes at bandwidth B takes R / B; reading C compressed
+      // bytes and decompressing at D takes C / B + R / D. The second wins
+      // while B < (R - C) * D / R.
+      double mib{1024.0 * 1024.0};
+      double r{static_cast<double>(raw.size())};
+      double c{static_cast<double>(compressed.size())};
+      double d{r / std::min(lz_warm, pool_warm)};
+      std::string name{argv[a]};
+      name = name.substr(name.find_last_of('/') + 1);
+      char break_even[32];
+      if (c < r) {
+        std::snprintf(break_even, sizeof(break_even), "%.0f MiB/s",
+                      (r - c) * d / r / mib);
+      } else {
+        std::snprintf(break_even, sizeof(break_even), "never");
+      }
+      std::printf(
+          "%-24s %9.2f %6.3f %5.0fMiB/s | %10.2f %10.2f | %10.2f %10.2f | "
+          "%10.2f %10.2f | %s\n",
+          name.c_str(), r / mib, c / r, r / mib / compress_time,
+          raw_cold * 1e3, raw_warm * 1e3, lz_cold * 1e3, lz_warm * 1e3,
+          pool_cold * 1e3, pool_warm * 1e3, break_even);
+    }
+    std::remove(raw_path.c_str());
+    std::remove(lz_path.c_str());
+  } catch (const std::string &e) {
+    std::cerr << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
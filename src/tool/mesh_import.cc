@@ -0,0 +1,99 @@
+// Writes the mesh files GetMeshLevels loads at startup:
+//   mesh_import <output_directory>
+// Builds each shape the demo draws from a file, with its levels of detail
+// and meshlets, writes it to <output_directory>/<name>.mesh and maps it
+// back. The table gives the finest level's ACMR, ATVR and overdraw before
+// and after BuildMeshAsset reorders it, and compares building a shape with
+// mapping and checking its file, which is all that is left to do before
+// glBufferData.
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "graphics/mapped_file.h"
+#include "graphics/mesh_file.h"
+#include "graphics/mesh_optimizer.h"
+
+using namespace graphics;
+
+static double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// the shapes main.cc asks GetMeshLevels for; the mesh pool's are built at
+// startup either way
+struct Shape {
+  MeshShape shape;
+  unsigned tessellation;
+};
+
+const Shape kShape[]{{kIcosphere, 0},          {kIcosphere, 1},
+                     {kIcosphere, 2},          {kIcosphere, 3},
+                     {kIcosphere, 4},          {kIcosphere, 5},
+                     {kSimplifiedIcosphere, 5}, {kUvSphere, 64},
+                     {kCube, 0}};
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <output_directory>" << std::endl;
+    return 1;
+  }
+  try {
+    std::string directory{argv[1]};
+    std::printf("%-24s %8s %9s %6s %8s %13s %13s %13s %8s | %9s %8s\n",
+                "mesh", "vertices", "triangles", "levels", "meshlets",
+                "acmr", "atvr", "overdraw", "KiB", "build ms", "load ms");
+    for (const Shape &shape : kShape) {
+      std::string name{MeshShapeName(shape.shape, shape.tessellation)};
+      double start{Now()};
+      MeshData data;
+      std::vector<MeshLod> lod;
+      BuildShape(shape.shape, shape.tessellation, data, lod);
+      double build_time{Now() - start};
+      MeshStatistics before{AnalyzeMesh(LodMesh(data, lod[0]))};
+      start = Now();
+      MeshAsset asset;
+      BuildMeshAsset(data, lod, asset);
+      build_time += Now() - start;
+      std::string path{directory + "/" + name + ".mesh"};
+      WriteMeshFile(path, asset);
+
+      start = Now();
+      MappedFile file;
+      if (!file.Open(path)) {
+        throw "fail to map " + path;
+      }
+      MeshFileView view;
+      ParseMeshFile(file.Data(), file.Size(), view);
+      double load_time{Now() - start};
+
+      // the finest level's statistics
+      MeshData finest;
+      finest.vertex = asset.mesh.vertex;
+      finest.index_size = asset.mesh.index_size;
+      finest.error = 0.0f;
+      finest.index.assign(
+          asset.mesh.index.begin(),
+          asset.mesh.index.begin() +
+              asset.lod[0].index_count * asset.mesh.index_size);
+      MeshStatistics after{AnalyzeMesh(finest)};
+      std::printf(
+          "%-24s %8u %9u %6u %8u %6.3f>%6.3f %6.3f>%6.3f %6.3f>%6.3f %8zu "
+          "| %9.2f %8.3f\n",
+          name.c_str(), view.header->vertex_count,
+          view.lod[0].index_count / 3, view.header->lod_count,
+          view.header->meshlet_count, before.acmr, after.acmr, before.atvr,
+          after.atvr, before.overdraw, after.overdraw, file.Size() / 1024,
+          build_time * 1e3, load_time * 1e3);
+    }
+  } catch (const std::string &e) {
+    std::cerr << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
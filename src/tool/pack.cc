@@ -0,0 +1,96 @@
+// Builds an asset pack:
+//   pack <output> <root> [--order <file>] <path>... [--compress <path>...]
+// Every path, relative to root, is a file or a directory packed
+// recursively. An order file written by Pack::WriteAccessOrder lays those
+// entries out first, in the order they were used; a missing one is ignored.
+// The paths after --compress are stored lz compressed where that pays off;
+// those before it are stored raw, for a loader to map and use in place,
+// even where a path after it takes them in too.
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "graphics/pack.h"
+
+static void Collect(const std::string &root, const std::string &name,
+                    std::vector<std::string> &names) {
+  std::string path{root + "/" + name};
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0) {
+    throw std::string{"fail to read "} + path;
+  }
+  if (!S_ISDIR(status.st_mode)) {
+    names.push_back(name);
+    return;
+  }
+  DIR *directory{opendir(path.c_str())};
+  if (!directory) {
+    throw std::string{"fail to read "} + path;
+  }
+  for (dirent *child = readdir(directory); child;
+       child = readdir(directory)) {
+    std::string child_name{child->d_name};
+    if (child_name[0] != '.') {
+      Collect(root, name + "/" + child_name, names);
+    }
+  }
+  closedir(directory);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    std::cerr << "usage: " << argv[0]
+              << " <output> <root> [--order <file>] <path>..."
+                 " [--compress <path>...]"
+              << std::endl;
+    return 1;
+  }
+  try {
+    std::string output{argv[1]};
+    std::string root{argv[2]};
+    std::vector<std::string> names;
+    std::vector<std::string> order;
+    std::vector<std::string> raw;
+    std::vector<std::string> compressed;
+    bool compress{false};
+    for (int i = 3; i < argc; ++i) {
+      std::string argument{argv[i]};
+      if (argument == "--compress") {
+        compress = true;
+      } else if (argument == "--order" && i + 1 < argc) {
+        std::ifstream order_file{argv[++i]};
+        for (std::string line; std::getline(order_file, line);) {
+          if (!line.empty()) {
+            order.push_back(line);
+          }
+        }
+      } else {
+        std::size_t first{names.size()};
+        Collect(root, argument, names);
+        std::vector<std::string> &kind{compress ? compressed : raw};
+        kind.insert(kind.end(), names.begin() + first, names.end());
+      }
+    }
+    std::sort(raw.begin(), raw.end());
+    compressed.erase(
+        std::remove_if(compressed.begin(), compressed.end(),
+                       [&](const std::string &name) {
+                         return std::binary_search(raw.begin(), raw.end(),
+                                                   name);
+                       }),
+        compressed.end());
+    graphics::WritePack(output, root, names, order, compressed);
+    std::cout << "packed " << names.size() << " files into " << output
+              << std::endl;
+  } catch (const std::string &e) {
+    std::cerr << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
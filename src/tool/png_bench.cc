@@ -0,0 +1,158 @@
+// Times PNG decoding from memory and its two halves:
+//   png_bench <png>...
+// inflate is the zlib stream of the IDAT chunks alone; a decode is the
+// whole stbi_load_from_memory, once with rows unfiltered by the scalar code
+// and once by the SIMD path. The MiB/s columns are unfiltering throughput,
+// taking a decode's time beyond inflate as unfiltering. Each time is the
+// best of kRunCount runs, and both decodes must agree.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "stb/stb_image.h"
+
+const int kRunCount{8};
+
+static double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static std::vector<unsigned char> ReadFile(const std::string &path) {
+  std::ifstream file{path, std::ios::binary | std::ios::ate};
+  if (!file) {
+    throw std::string{"fail to read "} + path;
+  }
+  std::vector<unsigned char> data(static_cast<std::size_t>(file.tellg()));
+  file.seekg(0);
+  if (!file.read(reinterpret_cast<char *>(data.data()), data.size())) {
+    throw std::string{"fail to read "} + path;
+  }
+  return data;
+}
+
+static std::uint32_t BigEndian(const unsigned char *p) {
+  return std::uint32_t{p[0]} << 24 | std::uint32_t{p[1]} << 16 |
+         std::uint32_t{p[2]} << 8 | p[3];
+}
+
+// the zlib stream split over png's IDAT chunks
+static std::vector<unsigned char> ImageData(
+    const std::vector<unsigned char> &png) {
+  const unsigned char kSignature[8]{137, 'P', 'N', 'G', 13, 10, 26, 10};
+  if (png.size() < 8 || std::memcmp(png.data(), kSignature, 8) != 0) {
+    throw std::string{"not a png"};
+  }
+  std::vector<unsigned char> data;
+  for (std::size_t p = 8; p + 12 <= png.size();) {
+    std::size_t size{BigEndian(&png[p])};
+    if (size > png.size() - p - 12) {
+      throw std::string{"truncated png"};
+    }
+    if (std::memcmp(&png[p + 4], "IDAT", 4) == 0) {
+      data.insert(data.end(), png.begin() + p + 8, png.begin() + p + 8 + size);
+    }
+    p += size + 12;
+  }
+  return data;
+}
+
+// The first run finds raw_size, which the rest start their buffer at, as
+// the png decoder does from the header, so none of them grows it.
+static double BestInflate(const std::vector<unsigned char> &data,
+                          int &raw_size) {
+  double best{1e30};
+  raw_size = 0;
+  for (int r = 0; r <= kRunCount; ++r) {
+    double start{Now()};
+    char *raw{stbi_zlib_decode_malloc_guesssize(
+        reinterpret_cast<const char *>(data.data()),
+        static_cast<int>(data.size()), std::max(raw_size, 16384),
+        &raw_size)};
+    if (r > 0) {
+      best = std::min(best, Now() - start);
+    }
+    if (!raw) {
+      throw std::string{"inflate failed: "} + stbi_failure_reason();
+    }
+    std::free(raw);
+  }
+  return best;
+}
+
+static double BestDecode(const std::vector<unsigned char> &png, bool simd,
+                         std::vector<unsigned char> &pixel) {
+  stbi_set_png_simd_unfilter(simd);
+  double best{1e30};
+  for (int r = 0; r < kRunCount; ++r) {
+    int width, height, component_count;
+    double start{Now()};
+    stbi_uc *data{stbi_load_from_memory(png.data(),
+                                        static_cast<int>(png.size()), &width,
+                                        &height, &component_count, 0)};
+    best = std::min(best, Now() - start);
+    if (!data) {
+      throw std::string{"decode failed: "} + stbi_failure_reason();
+    }
+    pixel.assign(data, data + width * height * component_count);
+    stbi_image_free(data);
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <png>..." << std::endl;
+    return 1;
+  }
+  // MiB/s are of the filtered rows inflate puts out
+  std::printf("%-32s %8s %11s | %10s %10s | %11s %11s\n", "png", "raw MiB",
+              "inflate ms", "scalar ms", "simd ms", "scalar MiB/s",
+              "simd MiB/s");
+  double total_inflate{0}, total_scalar{0}, total_simd{0};
+  double total_raw{0};
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string path{argv[i]};
+      std::vector<unsigned char> png{ReadFile(path)};
+      int raw_size;
+      double inflate{BestInflate(ImageData(png), raw_size)};
+      std::vector<unsigned char> scalar_pixel, simd_pixel;
+      double scalar{BestDecode(png, false, scalar_pixel)};
+      double simd{BestDecode(png, true, simd_pixel)};
+      if (scalar_pixel != simd_pixel) {
+        throw path + ": scalar and simd unfiltering disagree";
+      }
+      double raw{raw_size / 1048576.0};
+      // timing noise can leave a tiny image's unfiltering at nothing
+      double scalar_unfilter{std::max(scalar - inflate, 1e-6)};
+      double simd_unfilter{std::max(simd - inflate, 1e-6)};
+      std::printf("%-32s %8.2f %11.2f | %10.2f %10.2f | %11.0f %11.0f\n",
+                  path.substr(path.size() > 32 ? path.size() - 32 : 0)
+                      .c_str(),
+                  raw, inflate * 1e3, scalar * 1e3, simd * 1e3,
+                  raw / scalar_unfilter, raw / simd_unfilter);
+      total_inflate += inflate;
+      total_scalar += scalar;
+      total_simd += simd;
+      total_raw += raw;
+    }
+  } catch (const std::string &e) {
+    std::cerr << e << std::endl;
+    return 1;
+  }
+  std::printf("total: %.2f MiB, inflate %.2f ms, decode %.2f ms scalar, "
+              "%.2f ms simd (%.2fx)\n",
+              total_raw, total_inflate * 1e3, total_scalar * 1e3,
+              total_simd * 1e3, total_scalar / total_simd);
+  return 0;
+}
@@ -0,0 +1,105 @@
+// Writes the shader library the binary is built with:
+//   shader_embed <output> <shader>...
+// Each shader goes through PreprocessShader, as a reload would read it,
+// and into <output> as an EmbeddedShader with its hash, for
+// src/graphics/shader_library.cc to include, so startup reads no shader
+// files and keys the program cache without hashing any text. The table
+// compares each file with what is left of it to compile.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "graphics/hash.h"
+#include "graphics/shader_preprocess.h"
+
+using namespace graphics;
+
+// text as the lines of a C++ string literal, continued line by line
+static std::string Literal(const std::string &text) {
+  std::string literal{"\""};
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    unsigned char c{static_cast<unsigned char>(text[i])};
+    if (c == '\n') {
+      literal += i + 1 < text.size() ? "\\n\"\n    \"" : "\\n";
+    } else if (c == '"' || c == '\\' || c == '?') {
+      // '?' so that no trigraph forms
+      literal += '\\';
+      literal += static_cast<char>(c);
+    } else if (c < ' ' || c > '~') {
+      char octal[8];
+      std::snprintf(octal, sizeof(octal), "\\%03o", c);
+      literal += octal;
+    } else {
+      literal += static_cast<char>(c);
+    }
+  }
+  return literal + "\"";
+}
+
+static std::size_t FileSize(const std::string &path) {
+  std::ifstream file{path, std::ios::binary | std::ios::ate};
+  return file ? static_cast<std::size_t>(file.tellg()) : 0;
+}
+
+struct ShaderFile {
+  std::string name;
+  std::string path;
+  std::string source;
+  std::uint64_t hash;
+};
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <output> <shader>..." << std::endl;
+    return 1;
+  }
+  try {
+    std::vector<ShaderFile> shader;
+    for (int i = 2; i < argc; ++i) {
+      std::string path{argv[i]};
+      std::string source{PreprocessShader(path)};
+      shader.push_back({path.substr(path.rfind('/') + 1), path, source,
+                        HashBytes(source.data(), source.size())});
+    }
+    // FindEmbeddedShader searches by name
+    std::sort(shader.begin(), shader.end(),
+              [](const ShaderFile &a, const ShaderFile &b) {
+                return a.name < b.name;
+              });
+    std::string output{
+        "// Written by shader_embed from the shader files; do not edit.\n\n"
+        "constexpr EmbeddedShader kEmbeddedShader[]{\n"};
+    std::printf("%-28s %8s %9s  %s\n", "shader", "file B", "embedded",
+                "hash");
+    for (std::size_t i = 0; i < shader.size(); ++i) {
+      const ShaderFile &s{shader[i]};
+      if (i > 0 && s.name == shader[i - 1].name) {
+        throw "two shaders named " + s.name;
+      }
+      char hash[32];
+      std::snprintf(hash, sizeof(hash), "0x%016llxull",
+                    static_cast<unsigned long long>(s.hash));
+      output += "    {\"" + s.name + "\",\n    " + Literal(s.source) +
+                ",\n    " + std::to_string(s.source.size()) + ", " + hash +
+                "},\n";
+      std::printf("%-28s %8zu %9zu  %016llx\n", s.name.c_str(),
+                  FileSize(s.path), s.source.size(),
+                  static_cast<unsigned long long>(s.hash));
+    }
+    output += "};\n";
+    std::ofstream file{argv[1], std::ios::binary | std::ios::trunc};
+    if (!file.write(output.data(),
+                    static_cast<std::streamsize>(output.size()))) {
+      throw std::string{"fail to write "} + argv[1];
+    }
+  } catch (const std::string &e) {
+    std::cerr << e << std::endl;
+    return 1;
+  }
+  return 0;
+}